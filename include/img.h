@@ -6,14 +6,33 @@
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
+#include <map>
 #include <sstream>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <algorithm>
 #include <string>
 #include <random>
 #include <chrono>
 #include <filesystem>
+#include <cstdint>
+#include <numeric>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <array>
+#include <functional>
+#include <thread>
+#include <optional>
+#include <deque>
+#include <condition_variable>
+#include <list>
+#include <limits>
+#include <type_traits>
+#include <future>
+#include <exception>
+#include <bitset>
 
 // Third-party dependencies.
 #include <glm/glm.hpp>
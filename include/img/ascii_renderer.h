@@ -0,0 +1,64 @@
+
+#ifndef IMG_ASCII_RENDERER_H
+#define IMG_ASCII_RENDERER_H
+
+#include "img.h"
+#include "img/image.h"
+#include "img/luma.h"
+
+namespace img {
+
+    // Renders images as ascii characters, one character per 'resolution' by 'resolution' block of pixels. Characters
+    // are twice as tall as they are wide, so every other row of blocks is skipped.
+    // Block luma is sampled directly from the pixel data in one pass (no intermediate images are created), and output
+    // is written row by row into a caller-provided buffer, stream, or callback.
+    class ascii_renderer {
+        public:
+            // Characters used by default, from darkest to brightest.
+            static const char* const default_ramp;
+
+            // Invoked once per output row, 'row' includes the trailing newline.
+            using row_callback = std::function<void(const char* row, std::size_t length)>;
+
+            //   resolution - pixels per letter
+            //   ramp       - characters from darkest to brightest
+            explicit ascii_renderer(int resolution = 20, const std::string& ramp = default_ramp, luma_weights weights = luma_weights::bt601);
+            ~ascii_renderer();
+
+            // Maps each of the 256 luma values to a character of the ramp.
+            void set_ramp(const std::string& ramp);
+
+            // Maps luma values to characters by their cumulative share of 'distribution' instead, so that every
+            // character covers about as many pixels (blocks) of an image with that luma histogram.
+            void set_ramp(const std::string& ramp, const histogram_counts& distribution);
+
+            [[nodiscard]] char get_character(unsigned char luma) const;
+
+            [[nodiscard]] int get_rows(int height) const;
+            [[nodiscard]] int get_columns(int width) const;
+
+            // Number of bytes render() writes for an image of the given size, including newlines.
+            [[nodiscard]] std::size_t get_buffer_size(int width, int height) const;
+
+            // Renders into 'buffer', which must hold at least get_buffer_size() bytes. Returns the number of bytes
+            // written. Rows are rendered in parallel for large images.
+            std::size_t render(const image& im, char* buffer) const;
+
+            // Renders one row at a time into a reused row buffer.
+            void render(const image& im, std::ostream& stream) const;
+            void render(const image& im, const row_callback& callback) const;
+
+            [[nodiscard]] std::string render(const image& im) const;
+
+        private:
+            // Renders output rows [first, last) into 'output', (columns + 1) bytes per row.
+            void render_rows(const image& im, int first, int last, char* output) const;
+
+            int resolution;
+            luma_weights weights;
+            std::array<char, 256> characters; // Character per luma value.
+    };
+
+}
+
+#endif //IMG_ASCII_RENDERER_H
@@ -0,0 +1,73 @@
+
+#ifndef IMG_BATCH_RUNNER_H
+#define IMG_BATCH_RUNNER_H
+
+#include "img.h"
+#include "img/image.h"
+#include "img/processor.h"
+
+namespace img {
+
+    struct batch_options {
+        // Working set allowed in memory across all stages at once. Every image is charged twice its decoded size (from
+        // its header) until it is processed, for the decoded pixels and the processor's working copy (or the result of
+        // the current operation), and the size of its result afterwards. An image larger than the limit still runs,
+        // on its own. Operations that enlarge images exceed their estimate while they run.
+        std::size_t memory_limit = std::size_t(512) << 20; // 512 MiB.
+
+        // Images waiting between two stages.
+        int queue_capacity = 2;
+
+        // Threads decoding and encoding images, 0 for the default of 1. Processing runs on a single stage thread and
+        // parallelizes each image over the shared thread pool.
+        int decode_threads = 0;
+        int encode_threads = 0;
+
+        // Directory all results are saved to, empty for the processor default (a directory per image).
+        std::string output_directory;
+    };
+
+    struct batch_result {
+        std::string input;
+        std::string output; // Path the result was saved to.
+        bool success;
+        std::string error;  // Reason of failure.
+    };
+
+    // Runs the same chain of operations on many images, pipelining decode -> process -> save: while one image is
+    // processed, the next ones are decoded and the previous ones are encoded.
+    class batch_runner {
+        public:
+            // 'operations' is run on a deferred processor for every image, its result is saved.
+            explicit batch_runner(std::function<void(processor&)> operations, batch_options options = batch_options());
+            ~batch_runner();
+
+            // Processes 'inputs' and returns one result per input, in the same order.
+            [[nodiscard]] std::vector<batch_result> run(const std::vector<std::string>& inputs) const;
+
+        private:
+            // Limits the bytes in flight.
+            class memory_budget {
+                public:
+                    explicit memory_budget(std::size_t limit);
+
+                    void acquire(std::size_t bytes);
+                    void release(std::size_t bytes);
+
+                    // Changes a reservation of 'from' bytes to 'to' bytes, without waiting.
+                    void resize(std::size_t from, std::size_t to);
+
+                private:
+                    std::size_t limit;
+                    std::size_t used;
+                    std::mutex lock;
+                    std::condition_variable available;
+            };
+
+            std::function<void(processor&)> operations;
+            batch_options options;
+    };
+
+}
+
+#endif //IMG_BATCH_RUNNER_H
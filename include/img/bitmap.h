@@ -0,0 +1,70 @@
+
+#ifndef IMG_BITMAP_H
+#define IMG_BITMAP_H
+
+#include "img.h"
+#include "img/file_data.h"
+#include "img/encode_options.h"
+
+namespace img {
+
+    // Forward declaration.
+    class image;
+
+    // Black and white image with one bit per pixel. Rows are padded to whole bytes, with the leftmost pixel in the most
+    // significant bit and set bits being white, the layout of 1-bit PNG (PBM inverts the bits).
+    // Dithered results stored as bitmaps take 24 (RGB) to 32 (RGBA) times less memory than as images.
+    class bitmap {
+        public:
+            // All pixels start out black.
+            bitmap(const std::string& filepath, int width, int height);
+            ~bitmap();
+
+            [[nodiscard]] bool get(int x, int y) const;
+            void set(int x, int y, bool white);
+
+            // Sets row 'y' from 'width' pixels of 'channels' interleaved channels, pixels are white when their first
+            // channel is at least 128.
+            void pack_row(int y, const unsigned char* pixels, int channels);
+
+            // Writes row 'y' as 'width' pixels of 'channels' interleaved channels, with every channel set to 0 or 255.
+            void unpack_row(int y, unsigned char* pixels, int channels) const;
+
+            // Expands the bitmap into an image with the same filepath, for display or further processing.
+            [[nodiscard]] image to_image(int channels = 1) const;
+
+            // Encodes the bitmap as 1-bit PNG or PBM, see image::encode().
+            [[nodiscard]] std::vector<unsigned char> encode(image_format format, const encode_options& options = encode_options()) const;
+            bool encode(image_format format, const encode_writer& writer, const encode_options& options = encode_options()) const;
+
+            // Writes the bitmap to its filepath, as PNG or PBM depending on its extension. Returns false if the bitmap
+            // could not be written.
+            bool save(const encode_options& options = encode_options()) const;
+
+            // Writes the bitmap to 'filepath' instead, as PNG or PBM depending on its extension.
+            bool save(const std::string& filepath, const encode_options& options = encode_options()) const;
+
+            // Packed rows of get_stride() bytes.
+            [[nodiscard]] const unsigned char* get_data() const;
+            [[nodiscard]] unsigned char* get_data();
+
+            [[nodiscard]] int get_width() const;
+            [[nodiscard]] int get_height() const;
+            [[nodiscard]] int get_stride() const;
+            [[nodiscard]] const file_data& get_file() const;
+
+        private:
+            // Writes the bitmap to 'target', creating its directory if needed.
+            [[nodiscard]] bool write(const file_data& target, const encode_options& options) const;
+
+            file_data file;
+            int width;
+            int height;
+            int stride; // Bytes per row.
+
+            std::vector<unsigned char> bits;
+    };
+
+}
+
+#endif //IMG_BITMAP_H
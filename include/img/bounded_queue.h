@@ -0,0 +1,81 @@
+
+#ifndef IMG_BOUNDED_QUEUE_H
+#define IMG_BOUNDED_QUEUE_H
+
+#include "img.h"
+
+namespace img {
+
+    // Blocking first-in, first-out queue holding at most 'capacity' elements, for handing work between threads.
+    // Producers wait while the queue is full, consumers wait while it is empty. Once closed, pushing fails and
+    // consumers receive the remaining elements before pop() returns nothing.
+    template <typename T>
+    class bounded_queue {
+        public:
+            explicit bounded_queue(std::size_t capacity) : capacity(std::max<std::size_t>(capacity, 1)),
+                                                           elements(),
+                                                           closed(false)
+                                                           {
+            }
+
+            ~bounded_queue() = default;
+
+            // Returns false if the queue was closed.
+            bool push(T value) {
+                std::unique_lock<std::mutex> guard(lock);
+                not_full.wait(guard, [this]() {
+                    return closed || elements.size() < capacity;
+                });
+
+                if (closed) {
+                    return false;
+                }
+
+                elements.emplace_back(std::move(value));
+                guard.unlock();
+
+                not_empty.notify_one();
+                return true;
+            }
+
+            [[nodiscard]] std::optional<T> pop() {
+                std::unique_lock<std::mutex> guard(lock);
+                not_empty.wait(guard, [this]() {
+                    return closed || !elements.empty();
+                });
+
+                if (elements.empty()) {
+                    return std::nullopt;
+                }
+
+                T value = std::move(elements.front());
+                elements.pop_front();
+                guard.unlock();
+
+                not_full.notify_one();
+                return value;
+            }
+
+            void close() {
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    closed = true;
+                }
+
+                not_full.notify_all();
+                not_empty.notify_all();
+            }
+
+        private:
+            std::size_t capacity;
+            std::deque<T> elements;
+            bool closed;
+
+            std::mutex lock;
+            std::condition_variable not_full;
+            std::condition_variable not_empty;
+    };
+
+}
+
+#endif //IMG_BOUNDED_QUEUE_H
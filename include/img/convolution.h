@@ -0,0 +1,82 @@
+
+#ifndef IMG_CONVOLUTION_H
+#define IMG_CONVOLUTION_H
+
+#include "img.h"
+
+namespace img {
+
+    // Values of pixels outside the image, where kernels reach past its edges.
+    //   clamp  - nearest edge pixel (aa|abcd|dd)
+    //   mirror - reflected about the edge pixel (cb|abcd|cb)
+    //   wrap   - pixels of the opposite side (cd|abcd|ab)
+    //   zero   - zero in every channel
+    enum class border_mode {
+        clamp,
+        mirror,
+        wrap,
+        zero
+    };
+
+    // Convolves images with a kernel of odd dimensions, centered on each pixel. Separable kernels run as a horizontal
+    // pass followed by a vertical pass, general kernels as one pass over all of their rows.
+    // Integer kernels are evaluated exactly in 32-bit integer arithmetic and divided by 'divisor' at the end, float
+    // kernels in single precision. Both passes multiply and add one tap at a time over whole rows, with SSE4.1 or
+    // AVX2 kernels where available (see get_instruction_set()). Rows are split into tiles on the shared thread pool,
+    // every tile only keeps the (horizontally filtered) rows it reads.
+    class convolver {
+        public:
+            convolver(std::vector<float> horizontal, std::vector<float> vertical, border_mode border = border_mode::clamp);
+            convolver(std::vector<int> horizontal, std::vector<int> vertical, int divisor, border_mode border = border_mode::clamp);
+
+            // General kernels, 'width' by 'height' weights in row-major order.
+            convolver(std::vector<float> weights, int width, int height, border_mode border = border_mode::clamp);
+            convolver(std::vector<int> weights, int width, int height, int divisor, border_mode border = border_mode::clamp);
+
+            ~convolver();
+
+            // Convolves tightly packed 'source' into 'destination', both 'width' by 'height' pixels of 'channels'
+            // interleaved channels. Results are rounded and clamped to [0, 255].
+            void convolve(const unsigned char* source, unsigned char* destination, int width, int height, int channels) const;
+
+            // Results are neither rounded nor clamped, for kernels with negative weights (gradients).
+            void convolve(const unsigned char* source, float* destination, int width, int height, int channels) const;
+
+            // Hands every row of unclamped results to row(y, results) instead, from the shared thread pool. Saves
+            // storing whole images of results when they are combined right away.
+            using row_function = std::function<void(int y, const float* results)>;
+            void convolve(const unsigned char* source, int width, int height, int channels, const row_function& row) const;
+
+            [[nodiscard]] bool is_integer() const;
+            [[nodiscard]] bool is_separable() const;
+
+            // Identifies the kernel: its dimensions, weights (hashed), divisor and border mode, see result_cache.
+            [[nodiscard]] std::string get_key() const;
+
+        private:
+            // Runs the convolution, handing every finished row of sums to store(y, sums).
+            template <typename T, typename Store>
+            void run(const std::vector<T>& weights, const unsigned char* source, int width, int height, int channels, const Store& store) const;
+
+            int kernel_width;
+            int kernel_height;
+            bool separable;
+            border_mode border;
+
+            // Separable kernels hold kernel_width horizontal weights followed by kernel_height vertical weights.
+            bool integer;
+            int divisor;
+            std::vector<int> integer_weights;
+            std::vector<float> float_weights;
+    };
+
+    // Mean of the (2 * radius + 1) by (2 * radius + 1) pixels around every pixel, from running sums along rows and
+    // columns. Takes constant time per pixel regardless of the radius.
+    void box_blur(const unsigned char* source, unsigned char* destination, int width, int height, int channels, int radius, border_mode border = border_mode::clamp);
+
+    // Normalized Gaussian weights of standard deviation 'sigma', covering 3 sigma on either side.
+    [[nodiscard]] std::vector<float> get_gaussian_kernel(float sigma);
+
+}
+
+#endif //IMG_CONVOLUTION_H
@@ -0,0 +1,41 @@
+
+#ifndef IMG_CPU_H
+#define IMG_CPU_H
+
+#include "img.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define IMG_X86
+#endif
+
+// Allows for individual functions to be compiled for instruction sets the rest of the project is not compiled for.
+// Such functions must only be called after checking get_instruction_set().
+#if defined(IMG_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define IMG_TARGET_SSE4 __attribute__((target("sse4.1")))
+    #define IMG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define IMG_TARGET_SSE4
+    #define IMG_TARGET_AVX2
+#endif
+
+namespace img {
+
+    // Instruction sets with dedicated kernels, in increasing order of width.
+    //   sse4 - SSE4.1 (and everything below it)
+    //   avx2 - AVX2 (and everything below it)
+    enum class instruction_set {
+        scalar,
+        sse4,
+        avx2
+    };
+
+    // Returns the widest instruction set supported by the host CPU, or the one set with set_instruction_set().
+    [[nodiscard]] instruction_set get_instruction_set();
+
+    // Limits kernels to the given instruction set (useful for benchmarking and verifying the narrower kernels).
+    // Instruction sets wider than what the host CPU supports are ignored.
+    void set_instruction_set(instruction_set set);
+
+}
+
+#endif //IMG_CPU_H
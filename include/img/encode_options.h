@@ -0,0 +1,22 @@
+
+#ifndef IMG_ENCODE_OPTIONS_H
+#define IMG_ENCODE_OPTIONS_H
+
+#include "img.h"
+
+namespace img {
+
+    // Settings for writing images.
+    //   jpg_quality     - 1 (smallest) to 100 (best)
+    //   png_compression - 0 (stored, fastest) to 9 (smallest)
+    struct encode_options {
+        int jpg_quality = 100;
+        int png_compression = 6;
+    };
+
+    // Receives encoded data, possibly in several consecutive pieces.
+    using encode_writer = std::function<void(const unsigned char* data, std::size_t size)>;
+
+}
+
+#endif //IMG_ENCODE_OPTIONS_H
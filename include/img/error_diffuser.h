@@ -0,0 +1,68 @@
+
+#ifndef IMG_ERROR_DIFFUSER_H
+#define IMG_ERROR_DIFFUSER_H
+
+#include "img.h"
+
+namespace img {
+
+    // Error diffusion dithering matrices.
+    //   basic - whole error carried to the next pixel of the same row
+    enum class diffusion_matrix {
+        basic,
+        floyd_steinberg,
+        false_floyd_steinberg,
+        jarvis_judice_ninke,
+        stucki,
+        atkinson,
+        burkes,
+        sierra,
+        two_row_sierra,
+        sierra_lite
+    };
+
+    // Name of the matrix, as used in output filenames ("floyd_steinberg", ...). basic is "error_diffusion".
+    [[nodiscard]] std::string to_string(diffusion_matrix matrix);
+
+    // Dithers an image one row at a time, top to bottom. Only the error still to be applied to the next rows is kept,
+    // so memory use is independent of the image height.
+    // Pixels too close to the image border for the matrix to fit are set to black, as are the last rows.
+    class error_diffuser {
+        public:
+            error_diffuser(diffusion_matrix matrix, int width, int height);
+            ~error_diffuser();
+
+            // Dithers row 'y' of 'width' RGBA pixels in place. Rows must be passed in order, starting from 0.
+            // Colors are set to black or white, alpha to opaque.
+            void dither_row(int y, unsigned char* pixels);
+
+        private:
+            // Fraction of the error of a pixel diffused to the pixel at offset (x, y).
+            struct weight {
+                int x;
+                int y;
+                float value;
+            };
+
+            // Pixels outside of [left, width - right) and rows from height - bottom onwards are not dithered.
+            struct margins {
+                int left;
+                int right;
+                int bottom;
+            };
+
+            // Error rows are padded on both sides, so writes past the border need no bounds checks.
+            static constexpr int padding = 2;
+
+            std::vector<weight> weights;
+            margins margin;
+            int width;
+            int height;
+
+            std::vector<glm::vec4> errors; // Ring buffer with one row of error per row of the matrix.
+            int num_rows;
+    };
+
+}
+
+#endif //IMG_ERROR_DIFFUSER_H
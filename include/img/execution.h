@@ -0,0 +1,18 @@
+
+#ifndef IMG_EXECUTION_H
+#define IMG_EXECUTION_H
+
+namespace img {
+
+    // How a processor runs chained operations.
+    //   eager    - every operation runs as soon as it is called
+    //   deferred - operations are recorded and only run when the result is needed (get(), save(), ...), which
+    //              allows consecutive point-wise operations to be fused into a single pass over the image
+    enum class execution {
+        eager,
+        deferred
+    };
+
+}
+
+#endif //IMG_EXECUTION_H
@@ -3,6 +3,7 @@
 #define IMG_FILE_DATA_H
 
 #include "img.h"
+#include "img/probe.h"
 
 namespace img {
 
@@ -10,12 +11,21 @@ namespace img {
         explicit file_data(const std::string& filepath);
         ~file_data();
 
+        file_data(const file_data& other) = default;
+        file_data& operator=(const file_data& other) = default;
+
+        file_data(file_data&& other) noexcept = default;
+        file_data& operator=(file_data&& other) noexcept = default;
+
         std::string path;
 
         // Filepath broken up into separate pieces.
         std::string directory;
         std::string name;
         std::string extension;
+
+        // Format selected by the extension, used when saving.
+        image_format format;
     };
 
 }
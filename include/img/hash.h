@@ -0,0 +1,21 @@
+
+#ifndef IMG_HASH_H
+#define IMG_HASH_H
+
+#include "img.h"
+
+namespace img {
+
+    // XXH64 (xxHash, 64-bit variant) of 'size' bytes.
+    [[nodiscard]] std::uint64_t xxhash64(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+    // Hash of large buffers: 1 MiB blocks are hashed with XXH64 concurrently on the shared thread pool, then the block
+    // hashes are hashed together. Not compatible with xxhash64() of the same data.
+    [[nodiscard]] std::uint64_t hash_blocks(const void* data, std::size_t size);
+
+    // Formats a hash as 16 lowercase hexadecimal digits.
+    [[nodiscard]] std::string to_hex(std::uint64_t hash);
+
+}
+
+#endif //IMG_HASH_H
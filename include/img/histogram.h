@@ -0,0 +1,49 @@
+
+#ifndef IMG_HISTOGRAM_H
+#define IMG_HISTOGRAM_H
+
+#include "img.h"
+
+namespace img {
+
+    // Forward declaration.
+    class image;
+
+    // Number of pixels with each of the 256 values.
+    using histogram_counts = std::array<std::uint64_t, 256>;
+
+    // Per-channel and luma (BT.601) histograms of an image, counted in a single parallel pass. Every thread counts into
+    // its own tables, which are merged at the end.
+    class histogram {
+        public:
+            explicit histogram(const image& im);
+            ~histogram();
+
+            // Counts of channel 'channel', 0 to get_channels() - 1.
+            [[nodiscard]] const histogram_counts& get_channel(int channel) const;
+            [[nodiscard]] const histogram_counts& get_luma() const;
+
+            [[nodiscard]] int get_channels() const;
+            [[nodiscard]] std::uint64_t get_total() const; // Number of pixels.
+
+        private:
+            int channels;
+            std::uint64_t total;
+
+            std::vector<histogram_counts> counts; // One per channel.
+            histogram_counts luma;
+    };
+
+    // Smallest value with at least 'fraction' (0 to 1) of all counts at or below it.
+    [[nodiscard]] int get_percentile(const histogram_counts& counts, double fraction);
+
+    // Lookup table spreading values over [0, 255] by their cumulative distribution (histogram equalization). The lowest
+    // value present maps to 0.
+    [[nodiscard]] std::array<unsigned char, 256> get_equalization_table(const histogram_counts& counts);
+
+    // Lookup table stretching [low, high] to [0, 255], values outside of it are clamped.
+    [[nodiscard]] std::array<unsigned char, 256> get_levels_table(int low, int high);
+
+}
+
+#endif //IMG_HISTOGRAM_H
@@ -5,6 +5,12 @@
 #include "img.h"
 #include "img/pixel.h"
 #include "img/file_data.h"
+#include "img/summed_area_table.h"
+#include "img/histogram.h"
+#include "img/execution.h"
+#include "img/memory_mapped_file.h"
+#include "img/encode_options.h"
+#include "img/probe.h"
 
 namespace img {
 
@@ -15,26 +21,104 @@ namespace img {
         public:
             explicit image(const std::string& filepath);
             image(const std::string& filename, int width, int height, int channels);
+
+            // Decodes an encoded image (any format supported by stb_image) without going through the file system.
+            // 'filename' is only used for naming output, like the filepath of other images. Throws
+            // std::runtime_error if the data cannot be decoded.
+            image(const std::string& filename, const unsigned char* buffer, std::size_t size);
+
+            // Decodes straight from the mapped pages of 'mapping'.
+            explicit image(const memory_mapped_file& mapping);
+
+            // Decodes data pulled through 'callbacks', which receive 'user' as their first argument.
+            image(const std::string& filename, const stbi_io_callbacks& callbacks, void* user);
             ~image();
 
             image(const image& other);
             image& operator=(const image& other);
 
+            image(image&& other) noexcept;
+            image& operator=(image&& other) noexcept;
+
             [[nodiscard]] pixel get_pixel(int x, int y) const;
             void set_pixel(int x, int y, const pixel& value);
             void set_pixel(int x, int y, const glm::vec4& value);
 
-            void save() const;
+            // Returns the average color of the pixels in a w by h area, starting at (x, y), in constant time.
+            [[nodiscard]] glm::vec4 mean(int x, int y, int w, int h) const;
+
+            // Summed-area table of the image, built on first use. The table is shared with copies of this image until
+            // either one is modified.
+            [[nodiscard]] std::shared_ptr<const summed_area_table> get_summed_area_table() const;
+
+            // Image pyramid (mipmaps). Level 0 is the image itself, every following level is half the size of the
+            // previous one (rounded up), with each pixel being the average of the 2x2 pixels it covers. Levels are
+            // built on first use, each in a single pass over the level before it, and are shared like the
+            // summed-area table. The level 0 pointer does not own this image.
+            [[nodiscard]] std::shared_ptr<const image> get_pyramid_level(int level) const;
+            [[nodiscard]] int get_pyramid_level_count() const;
+
+            // Per-channel and luma histograms of the image, counted on first use and shared like the summed-area table.
+            [[nodiscard]] std::shared_ptr<const histogram> get_histogram() const;
+
+            // Raw pixel data, row-major with interleaved channels.
+            // Non-const access assumes the data is about to be modified.
+            [[nodiscard]] const unsigned char* get_data() const;
+            [[nodiscard]] unsigned char* get_data();
+
+            // Encodes the image in memory, returns no data if it could not be encoded.
+            [[nodiscard]] std::vector<unsigned char> encode_png(const encode_options& options = encode_options()) const;
+            [[nodiscard]] std::vector<unsigned char> encode_jpg(const encode_options& options = encode_options()) const;
+            [[nodiscard]] std::vector<unsigned char> encode(image_format format, const encode_options& options = encode_options()) const;
+
+            // Encodes the image as 'format' (png, jpg, bmp, tga, qoi, pnm, pbm or pam) and passes the data to 'writer' as it is produced,
+            // e.g. straight into a socket. Returns false if the format cannot be written.
+            bool encode(image_format format, const encode_writer& writer, const encode_options& options = encode_options()) const;
 
-            [[nodiscard]] processor process() const;
+            // Writes the image to its filepath, in the format of its extension. Returns false if the image could not be
+            // written.
+            bool save(const encode_options& options = encode_options()) const;
+
+            // Writes the image to 'filepath' instead, in the format of its extension.
+            bool save(const std::string& filepath, const encode_options& options = encode_options()) const;
+
+            // Writes a copy of the image in the background, the returned future holds the result of save().
+            [[nodiscard]] std::future<bool> save_async(const encode_options& options = encode_options()) const;
+
+            [[nodiscard]] processor process(execution mode = execution::eager) const;
 
             [[nodiscard]] int get_height() const;
             [[nodiscard]] int get_width() const;
             [[nodiscard]] int get_channels() const;
+            [[nodiscard]] const file_data& get_file() const;
 
         private:
             friend class processor;
 
+            // Data computed from the pixels on demand.
+            struct derived_data {
+                std::mutex lock;
+                std::atomic<bool> populated = false;
+                std::shared_ptr<const summed_area_table> table;
+                std::shared_ptr<const histogram> histograms;
+                std::vector<std::shared_ptr<const image>> levels; // Pyramid, starting at level 1.
+            };
+
+            // Writes the image to 'target', creating its directory if needed.
+            [[nodiscard]] bool write(const file_data& target, const encode_options& options) const;
+
+            // Decodes QOI and binary Netpbm data natively, anything else through stb_image.
+            void decode(const unsigned char* buffer, std::size_t size, const std::string& source);
+
+            // Takes ownership of decoded 'pixels' (freed as stb_allocated says), reporting 'source' if decoding failed.
+            void load(unsigned char* pixels, const std::string& source);
+
+            // Returns the next pyramid level of this image.
+            [[nodiscard]] image downsample() const;
+
+            // Gives this image its own (empty) derived data before its pixels are modified.
+            void detach();
+
             file_data file;
             int width;
             int height;
@@ -43,6 +127,8 @@ namespace img {
             unsigned char* data;
 
             bool stb_allocated;
+
+            std::shared_ptr<derived_data> derived;
     };
 
 }
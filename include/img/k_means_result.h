@@ -0,0 +1,31 @@
+
+#ifndef IMG_K_MEANS_RESULT_H
+#define IMG_K_MEANS_RESULT_H
+
+#include "img.h"
+
+namespace img {
+
+    // Statistics of a k-means clustering run, see processor::get_k_means_result().
+    //   iterations           - assignment passes over the image, the last one reassigns no pixels
+    //   reassignments        - pixels that changed cluster, per assignment pass
+    //   distance_evaluations - pixel to centroid distances computed over all passes
+    //   inertia              - sum of squared (RGB) distances of pixels to their final centroid
+    struct k_means_result {
+        int k = 0;
+        int iterations = 0;
+        std::vector<std::uint64_t> reassignments;
+        std::uint64_t distance_evaluations = 0;
+        double inertia = 0.0;
+        std::vector<glm::vec3> centroids;
+
+        // Time per phase, in milliseconds.
+        double unique_colors_time = 0.0;
+        double assignment_time = 0.0;
+        double update_time = 0.0;
+        double write_time = 0.0;
+    };
+
+}
+
+#endif //IMG_K_MEANS_RESULT_H
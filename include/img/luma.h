@@ -0,0 +1,35 @@
+
+#ifndef IMG_LUMA_H
+#define IMG_LUMA_H
+
+#include "img.h"
+
+namespace img {
+
+    // Luma coefficients.
+    //   bt601 - 0.299 R + 0.587 G + 0.114 B
+    //   bt709 - 0.2126 R + 0.7152 G + 0.0722 B
+    enum class luma_weights {
+        bt601,
+        bt709
+    };
+
+    // Converts 'count' pixels of 'channels' interleaved channels (1 to 4, gray is passed through and alpha is ignored)
+    // to one luma byte per pixel. Weights are applied in 8-bit fixed point (for example 77 / 150 / 29 for BT.601),
+    // using the widest kernel supported by the CPU.
+    void convert_to_luma(const unsigned char* source, int channels, unsigned char* destination, std::size_t count, luma_weights weights = luma_weights::bt601);
+
+    // Same as convert_to_luma(), but colors are weighted in linear light: sRGB values are decoded before weighting and
+    // the result is encoded again, both through lookup tables.
+    void convert_to_linear_luma(const unsigned char* source, int channels, unsigned char* destination, std::size_t count, luma_weights weights = luma_weights::bt601);
+
+    // Luma of a single color, matching convert_to_luma().
+    [[nodiscard]] unsigned char get_luma(unsigned char r, unsigned char g, unsigned char b, luma_weights weights = luma_weights::bt601);
+
+    // Scales the red, green and blue values at 'color', whose luma is 'luma', by 'target' / 'luma' (clamped to 255).
+    // Moves their luma to 'target' while keeping the hue, gray stays gray. Black becomes gray of luma 'target'.
+    void scale_luma(unsigned char* color, unsigned char luma, unsigned char target);
+
+}
+
+#endif //IMG_LUMA_H
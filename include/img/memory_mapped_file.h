@@ -0,0 +1,41 @@
+
+#ifndef IMG_MEMORY_MAPPED_FILE_H
+#define IMG_MEMORY_MAPPED_FILE_H
+
+#include "img.h"
+
+namespace img {
+
+    // Read-only view of a file mapped into memory. Pages are loaded from the page cache on first access, without being
+    // copied into a separate buffer.
+    class memory_mapped_file {
+        public:
+            // Throws std::runtime_error if the file cannot be opened or mapped.
+            explicit memory_mapped_file(const std::string& filepath);
+            ~memory_mapped_file();
+
+            memory_mapped_file(const memory_mapped_file& other) = delete;
+            memory_mapped_file& operator=(const memory_mapped_file& other) = delete;
+
+            memory_mapped_file(memory_mapped_file&& other) noexcept;
+            memory_mapped_file& operator=(memory_mapped_file&& other) noexcept;
+
+            [[nodiscard]] const unsigned char* get_data() const;
+            [[nodiscard]] std::size_t get_size() const;
+            [[nodiscard]] const std::string& get_path() const;
+
+        private:
+            void unmap();
+
+            std::string path;
+            const unsigned char* data;
+            std::size_t size;
+
+#ifdef _WIN32
+            void* mapping; // Handle of the file mapping object.
+#endif
+    };
+
+}
+
+#endif //IMG_MEMORY_MAPPED_FILE_H
@@ -0,0 +1,46 @@
+
+#ifndef IMG_NETPBM_H
+#define IMG_NETPBM_H
+
+#include "img.h"
+#include "img/encode_options.h"
+
+namespace img {
+
+    // Binary Netpbm images with 8-bit samples: PGM (P5, gray), PPM (P6, RGB) and PAM (P7, 1 to 4 channels). The pixels
+    // follow a short text header uncompressed, so reading and writing them is little more than a copy and files can be
+    // used straight from a memory mapping. PBM (P4) bitmaps are read as gray images of black (0) and white (255).
+    struct netpbm_header {
+        int width;
+        int height;
+        int channels;
+        std::size_t offset;  // Start of the pixel data.
+        bool packed = false; // PBM, rows of (width + 7) / 8 bytes.
+    };
+
+    // Parses the header of P4 data, or P5, P6 or P7 data with a maximum sample value of 255. Returns nothing for
+    // anything else.
+    // Dimensions are not limited to what fits in memory, see tiled_image.
+    [[nodiscard]] std::optional<netpbm_header> read_netpbm_header(const unsigned char* buffer, std::size_t size);
+
+    // Header text preceding the pixels. Gray and RGB images are written as PGM or PPM unless 'pam' is set, images with
+    // alpha are always written as PAM.
+    [[nodiscard]] std::string get_netpbm_header(int width, int height, int channels, bool pam);
+
+    // Writes a header followed by the pixels to 'writer'.
+    void encode_netpbm(const unsigned char* pixels, int width, int height, int channels, bool pam, const encode_writer& writer);
+
+    // Expands a row of PBM data into 'width' gray pixels.
+    void unpack_pbm_row(const unsigned char* bits, int width, unsigned char* pixels);
+
+    // Writes a PBM (P4) image from rows of (width + 7) / 8 bytes, most significant bit first, 1 being white (PBM itself
+    // stores 1 as black).
+    void encode_pbm(const unsigned char* bits, int width, int height, const encode_writer& writer);
+
+    // Copies the pixels into a new[] allocated buffer. Returns nullptr if the data is not supported, truncated, or too
+    // large for an image.
+    [[nodiscard]] unsigned char* decode_netpbm(const unsigned char* buffer, std::size_t size, int* width, int* height, int* channels);
+
+}
+
+#endif //IMG_NETPBM_H
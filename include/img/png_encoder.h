@@ -0,0 +1,20 @@
+
+#ifndef IMG_PNG_ENCODER_H
+#define IMG_PNG_ENCODER_H
+
+#include "img.h"
+
+namespace img {
+
+    // Encodes 8-bit pixels with 1 (gray), 2 (gray, alpha), 3 (RGB) or 4 (RGBA) interleaved channels as PNG.
+    // Rows are split into bands that are filtered and deflated concurrently on the shared thread pool. Every band is
+    // compressed independently and ends with a sync flush, so the bands concatenate into a single valid zlib stream.
+    // 'level' ranges from 0 (stored, no compression) to 9 (longest match search).
+    [[nodiscard]] std::vector<unsigned char> encode_png(const unsigned char* pixels, int width, int height, int channels, int level);
+
+    // Encodes a 1-bit grayscale PNG from rows of (width + 7) / 8 bytes, most significant bit first, 1 being white.
+    [[nodiscard]] std::vector<unsigned char> encode_png_1bpp(const unsigned char* bits, int width, int height, int level);
+
+}
+
+#endif //IMG_PNG_ENCODER_H
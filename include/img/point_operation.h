@@ -0,0 +1,52 @@
+
+#ifndef IMG_POINT_OPERATION_H
+#define IMG_POINT_OPERATION_H
+
+#include "img.h"
+#include "luma.h"
+
+namespace img {
+
+    // Point-wise operation, transforms 'count' RGBA pixels of row 'y' in place. The first pixel is at column 'x'.
+    using point_function = std::function<void(unsigned char* pixels, int count, int x, int y)>;
+
+    // Operation whose result for each pixel only depends on that pixel (and its position). These can be fused and run
+    // on any part of an image independently, see processor and tiled_processor.
+    struct point_operation {
+        // Largest number of pixels passed to 'function' at once.
+        static constexpr int max_count = 1024;
+
+        point_function function;
+        int channels;       // Channel count of the resulting image, 0 to keep the current one.
+        std::string suffix; // Appended to the image name.
+        std::string key;    // Identifies the operation and all of its parameters, see result_cache.
+    };
+
+    // Writes luma to every color channel, alpha is set to opaque. See processor::to_grayscale().
+    [[nodiscard]] point_operation grayscale_operation(luma_weights weights, bool linear_light, bool single_channel);
+
+    // Sets pixels with a luma of at least 'level' to white, others to black. Alpha is not modified.
+    [[nodiscard]] point_operation threshold_operation(unsigned char level, luma_weights weights);
+
+    // Replaces every color channel value with its entry in 'table'. Alpha is not modified.
+    [[nodiscard]] point_operation lut_operation(const std::array<unsigned char, 256>& table);
+
+    // Replaces red, green and blue values with their entry in the table of their channel. Alpha is not modified.
+    [[nodiscard]] point_operation lut_operation(const std::array<std::array<unsigned char, 256>, 3>& tables);
+
+    // Replaces the luma of every pixel with its entry in 'table', scaling red, green and blue alike (see scale_luma())
+    // so that hue is kept. Gray pixels map the same as with lut_operation(). Alpha is not modified.
+    [[nodiscard]] point_operation luma_lut_operation(const std::array<unsigned char, 256>& table);
+
+    // Ordered dithering with a 'matrix_width' by 'matrix_height' Bayer matrix.
+    [[nodiscard]] point_operation bayer_operation(int matrix_width, int matrix_height);
+
+    // Expands 'count' pixels with 'channels' channels to RGBA.
+    void unpack_rgba(const unsigned char* source, int channels, unsigned char* destination, int count);
+
+    // Converts 'count' RGBA pixels back to 'channels' channels, the same way image::set_pixel() does.
+    void pack_rgba(const unsigned char* source, unsigned char* destination, int channels, int count);
+
+}
+
+#endif //IMG_POINT_OPERATION_H
@@ -0,0 +1,49 @@
+
+#ifndef IMG_PROBE_H
+#define IMG_PROBE_H
+
+#include "img.h"
+
+namespace img {
+
+    // Encoded image formats, as detected from the first bytes of the data.
+    enum class image_format {
+        unknown,
+        png,
+        jpg,
+        bmp,
+        gif,
+        tga,
+        psd,
+        hdr,
+        pic,
+        pnm, // PGM or PPM.
+        pbm, // One bit per pixel.
+        pam,
+        qoi
+    };
+
+    struct image_info {
+        int width;
+        int height;
+        int channels; // Channels of the decoded image, as image would load it.
+        image_format format;
+    };
+
+    // Reads only the header of an encoded image, without decoding any pixels. Returns nothing if the data is not an
+    // image that can be decoded.
+    [[nodiscard]] std::optional<image_info> probe(const std::string& filepath);
+    [[nodiscard]] std::optional<image_info> probe(const unsigned char* buffer, std::size_t size);
+
+    // Detects the format of an encoded image from its first bytes (16 are enough for every format). Formats without
+    // a signature (TGA) are reported as unknown.
+    [[nodiscard]] image_format detect_format(const unsigned char* header, std::size_t size);
+
+    // Format named by a file extension ("png", "JPEG", ...), unknown for anything else.
+    [[nodiscard]] image_format format_from_extension(const std::string& extension);
+
+    [[nodiscard]] std::string to_string(image_format format);
+
+}
+
+#endif //IMG_PROBE_H
@@ -4,34 +4,97 @@
 
 #include "img.h"
 #include "image.h"
+#include "resampler.h"
+#include "luma.h"
+#include "ascii_renderer.h"
+#include "point_operation.h"
+#include "error_diffuser.h"
+#include "bitmap.h"
+#include "k_means_result.h"
+#include "convolution.h"
 
 namespace img {
 
     // Processor stores its own image, all processes operate on the local copy.
     // Allows for chaining of image processing.
+    // In deferred mode, operations are recorded and run when the result is first needed. Consecutive point-wise
+    // operations (grayscale, thresholds, ordered dithering, lookup tables) are then fused into a single pass. When a
+    // result cache is set (see set_result_cache()), results of recorded operations are looked up first and stored after
+    // running them. Randomized operations (k-means, Voronoi) are only cached once a seed is set (see set_random_seed()),
+    // and are keyed by it.
     class processor {
         public:
             // Deep copies image, original image passed is not modified.
-            explicit processor(const image& im);
+            explicit processor(const image& im, execution mode = execution::eager);
             ~processor();
 
             // Creates copy.
             [[nodiscard]] image get() const;
-            void save() const;
+
+            // Directory results are named into, "assets/generated/<image name>" by default. Applies to operations
+            // that run afterwards (in deferred mode, all recorded operations).
+            processor& set_output_directory(const std::string& directory);
+            [[nodiscard]] const std::string& get_output_directory() const;
+            bool save(const encode_options& options = encode_options()) const;
+
+            // Writes the result to 'filepath' instead of the generated name.
+            bool save(const std::string& filepath, const encode_options& options = encode_options()) const;
+
+            // Runs pending operations, then writes the result in the background (see image::save_async()).
+            [[nodiscard]] std::future<bool> save_async(const encode_options& options = encode_options()) const;
 
             // Utility functions.
-            [[nodiscard]] processor& to_grayscale();
+            // Convert the image to grayscale.
+            //   weights        - luma coefficients
+            //   linear_light   - weight colors after decoding them from sRGB, instead of weighting the encoded values
+            //   single_channel - produce a one channel image, instead of repeating the luma in every color channel
+            [[nodiscard]] processor& to_grayscale(luma_weights weights = luma_weights::bt601, bool linear_light = false, bool single_channel = false);
             [[nodiscard]] processor& to_lower_resolution(int x_resolution = 1, int y_resolution = 1);
 
+            // Resamples the image to 'width' by 'height' pixels. Unlike to_lower_resolution(), the resulting image
+            // is actually smaller (or larger).
+            [[nodiscard]] processor& resize(int width, int height, filter type = filter::lanczos3);
+
+            // Sets pixels with a luma of at least 'level' to white, others to black. Alpha is not modified.
+            [[nodiscard]] processor& threshold(unsigned char level, luma_weights weights = luma_weights::bt601);
+
+            // Replaces every color channel value with its entry in 'table'. Alpha is not modified.
+            [[nodiscard]] processor& apply_lut(const std::array<unsigned char, 256>& table);
+
+            // Tone adjustments, lookup tables built from the (cached) histograms of the image. Alpha is not modified.
+            // Spreads luma evenly over [0, 255]. Colors are scaled by the change of their luma, which keeps their hue.
+            [[nodiscard]] processor& equalize_histogram();
+
+            // Stretches every color channel to [0, 255], ignoring the darkest and brightest 'clip' percent of its
+            // values (outliers).
+            [[nodiscard]] processor& auto_levels(float clip = 0.5f);
+
+            // Contrast limited adaptive histogram equalization. Luma is equalized separately within each of 'tiles' by
+            // 'tiles' regions, with histogram bins limited to 'clip_limit' times their average count so that noise in
+            // flat regions is not amplified. Pixels blend the tables of the four nearest regions, and colors are scaled by
+            // the change of their luma like in equalize_histogram().
+            [[nodiscard]] processor& clahe(int tiles = 8, float clip_limit = 2.0f);
+
             // Image processing functions.
             // Convert the image to ascii characters.
             //   resolution - pixels per letter
-            [[nodiscard]] std::string to_ascii(int resolution = 20);
+            //   ramp       - characters from darkest to brightest
+            //   equalize   - give every character an equal share of the image, by its luma histogram
+            // Rendered by ascii_renderer: characters are picked by block luma, rows are rendered in parallel into a
+            // preallocated string.
+            [[nodiscard]] std::string to_ascii(int resolution = 20, const std::string& ramp = ascii_renderer::default_ramp, bool equalize = false);
 
             // Convert the image via the k-means clustering algorithm.
             //   k - number of clusters
+            // Centroids are seeded with k-means++ from the unique colors of the image (sampled when there are many),
+            // images with fewer than 'k' colors get one cluster per color.
+            // Statistics of the run are available from get_k_means_result().
             [[nodiscard]] processor& k_means(int k, bool maintain_alpha = false);
 
+            // Runs pending operations, then returns statistics of the last k_means() run of this processor. Empty if
+            // k_means() did not run, or if the last call was invalid or loaded its result from the result cache.
+            [[nodiscard]] const std::optional<k_means_result>& get_k_means_result() const;
+
             // Dithering algorithms.
             [[nodiscard]] processor& dither_error_diffusion();
             [[nodiscard]] processor& dither_floyd_steinberg();
@@ -45,61 +108,121 @@ namespace img {
             [[nodiscard]] processor& dither_sierra_lite();
             [[nodiscard]] processor& dither_bayer(int matrix_width, int matrix_height);
 
+            // Dither straight into a bitmap (one bit per pixel, see bitmap), named like the matching dither_*() output
+            // but saved as PNG. The processor's image is not modified.
+            [[nodiscard]] bitmap dither_to_bitmap(diffusion_matrix matrix) const;
+            [[nodiscard]] bitmap dither_bayer_to_bitmap(int matrix_width, int matrix_height) const;
+
+            // Packs an image that is already black and white (e.g. after threshold()) into a bitmap. Pixels are white
+            // when their first channel is at least 128.
+            [[nodiscard]] bitmap to_bitmap() const;
+
             // To Voronoi diagram, using uniform distribution.
             [[nodiscard]] processor& voronoi(int num_regions);
 
-        private:
-            [[nodiscard]] std::string get_output_directory() const;
+            // Generates one Voronoi diagram per entry in 'region_counts', in the same order. Region centers are nested
+            // (every diagram uses a superset of the centers of the smaller ones) and inserted incrementally, so the
+            // whole sweep costs little more than the largest diagram. The processor's image is not modified.
+            [[nodiscard]] std::vector<image> voronoi_sweep(const std::vector<int>& region_counts) const;
 
-            // Samples pixels in a x_resolution by y_resolution area, starting at (x, y) from the given image.
-            // Returns the average color of the pixels.
-            [[nodiscard]] glm::vec4 get_average_color(int x, int y, int x_resolution, int y_resolution) const;
+            // Filters.
+            // Gaussian blur of standard deviation 'sigma' pixels, of every channel (including alpha).
+            [[nodiscard]] processor& gaussian_blur(float sigma, border_mode border = border_mode::mirror);
 
+            // Mean of the (2 * radius + 1) by (2 * radius + 1) pixels around every pixel, of every channel. Takes
+            // constant time per pixel regardless of the radius.
+            [[nodiscard]] processor& box_blur(int radius, border_mode border = border_mode::mirror);
 
-            // K-Means clustering algorithm helper functions.
-            // Returns squared euclidian distance between two given points.
-            [[nodiscard]] float euclidian_distance(const glm::vec3& first, const glm::vec3& second) const;
+            // Sharpens by adding 'amount' times the difference between the image and its Gaussian blur of 'sigma'.
+            // Differences smaller than 'threshold' are left alone, so that noise is not amplified. Alpha is not
+            // modified. Pixels past the edges of the image are taken as set by 'border'.
+            [[nodiscard]] processor& unsharp_mask(float sigma = 1.0f, float amount = 1.0f, int threshold = 0, border_mode border = border_mode::mirror);
 
-            // Updates each cluster ID with the ID of the closest centroid.
-            [[nodiscard]] bool assign_cluster_ids(const std::vector<glm::vec3>& centroids, std::vector<int>& cluster_ids) const;
+            // Replaces color channels with their Sobel gradient magnitude, clamped to 255, computed row by row with
+            // pixels past the edges clamped. Alpha is not modified. Convert to grayscale first for a single edge map.
+            [[nodiscard]] processor& detect_edges();
 
-            // Updates the centroid values based on the surrounding cluster data.
-            void update_centroids(std::vector<glm::vec3>& centroids, const std::vector<int>& cluster_ids) const;
+            // Filters the image with any kernel. 'name' is appended to the image name and identifies the kernel in
+            // the result cache.
+            [[nodiscard]] processor& convolve(const convolver& kernel, const std::string& name);
 
+        private:
+            // Operation recorded in deferred mode.
+            struct operation {
+                std::optional<point_operation> point; // Fused with neighboring point-wise operations.
+                std::function<void(processor&)> run;  // Any other operation, runs on its own.
+                std::string key;                      // Operation and parameters, part of the result cache key. Empty
+                                                      // if the result cannot be reproduced, and is not cached.
+            };
 
-            // Dithering helper functions.
-            [[nodiscard]] glm::vec4 skew_direction(glm::vec4& value) const;
+            // Runs (or records, in deferred mode) a point-wise operation.
+            processor& apply(point_operation operation);
 
+            // Records 'run' when in deferred mode. Returns false if the operation should run right away instead.
+            [[nodiscard]] bool defer(std::string key, std::function<void(processor&)> run);
 
-            // Constructs ordered dithering threshold map with side length as a power of 2. Resulting matrix is
-            // normalized.
-            // n-values corresponding to matrix dimensions:
-            //   0 - 2x2
-            //   1 - 4x4
-            //   2 - 8x8
-            //   3 - 16x16
-            [[nodiscard]] std::vector<float> get_bayer_matrix(int n) const;
+            // Runs all recorded operations, or loads their result from the result cache (if one is set).
+            void execute() const;
 
-            // Constructs un-normalized threshold map based on https://en.wikipedia.org/wiki/Ordered_dithering#Pre-calculated_threshold_maps.
-            [[nodiscard]] std::vector<float> get_bayer_matrix_helper(int n) const;
+            // Runs recorded operations, in order. If one throws, the mode is restored, operations after it stay
+            // recorded, and the exception is rethrown.
+            void run(std::vector<operation>& operations) const;
 
-            // Converts from n-value to Bayer Matrix dimension.
-            [[nodiscard]] int get_bayer_matrix_dimension(int n) const;
+            // Runs point-wise operations in a single pass, one tile of at most point_operation::max_count pixels at a
+            // time.
+            void execute(const std::vector<point_operation>& operations) const;
 
 
-            // Helper class for creating Voronoi diagrams.
-            struct voronoi_region {
-                explicit voronoi_region(const glm::vec2& point);
-                void add_influence(const glm::vec2& point, const glm::vec4& value);
-                [[nodiscard]] glm::vec4 get_average_color() const;
+            // K-Means clustering algorithm helper functions.
+            // Returns squared euclidian distance between two given points.
+            [[nodiscard]] float euclidian_distance(const glm::vec3& first, const glm::vec3& second) const;
 
-                glm::vec2 center;
-                std::vector<glm::ivec2> pixels;
-                glm::vec4 color; // Running total of color (from all influences) at this region.
+            // Picks up to 'k' distinct colors of the image as initial centroids (k-means++), from its unique colors.
+            [[nodiscard]] std::vector<glm::vec3> seed_centroids(int k) const;
+
+            // Updates each cluster ID with the ID of the closest centroid. Returns the number of pixels whose cluster
+            // changed, and sets 'inertia' to the sum of squared distances of pixels to their centroid.
+            [[nodiscard]] std::uint64_t assign_cluster_ids(const std::vector<glm::vec3>& centroids, std::vector<int>& cluster_ids, double& inertia) const;
+
+            // Updates the centroid values based on the surrounding cluster data. Clusters without pixels are moved to
+            // the pixels farthest from their centroids.
+            void update_centroids(std::vector<glm::vec3>& centroids, const std::vector<int>& cluster_ids) const;
+
+
+            // Dithering helper functions.
+            // Error diffusion dithering, streamed one row at a time. 'name' is appended to the image name.
+            processor& dither(diffusion_matrix matrix, const std::string& name);
+
+
+            // Helper class for creating Voronoi diagrams incrementally. Inserting a region only visits the pixels
+            // that end up closer to its center than to the center of their current region.
+            struct voronoi_diagram {
+                explicit voronoi_diagram(const image& source);
+                void add_region(const glm::vec2& center);
+
+                // Writes the average color of each region to the pixels of that region.
+                void apply(image& output) const;
+
+                const image& source;
+                std::vector<glm::vec2> centers;
+                std::vector<int> labels;         // Region index of each pixel.
+                std::vector<float> distances;    // Squared distance from each pixel to the center of its region.
+                std::vector<std::int64_t> sums;  // Running total of color (RGB) of the pixels in each region.
+                std::vector<int> counts;         // Number of pixels in each region.
+                std::vector<int> visited;        // Index of the last region whose flood fill reached each pixel.
+                std::vector<int> stack;          // Flood fill scratch.
             };
 
+            // Names an image produced by the Voronoi diagram functions.
+            [[nodiscard]] std::string get_voronoi_filename(int num_regions) const;
+
 
-            image im;
+            // Recorded operations are executed on first access, which may happen through const functions.
+            mutable image im;
+            mutable std::vector<operation> pending;
+            mutable execution mode;
+            std::string output_directory;
+            mutable std::optional<k_means_result> k_means_statistics;
     };
 
 }
@@ -0,0 +1,23 @@
+
+#ifndef IMG_QOI_H
+#define IMG_QOI_H
+
+#include "img.h"
+
+namespace img {
+
+    // QOI ("Quite OK Image") format: lossless and encoded or decoded in a single pass, at a fraction of the cost of
+    // PNG. Meant for intermediate results that are read back by a following stage.
+    // QOI only stores RGB and RGBA, 1 (gray) and 2 (gray, alpha) channel pixels are expanded to 3 and 4 channels.
+    [[nodiscard]] std::vector<unsigned char> encode_qoi(const unsigned char* pixels, int width, int height, int channels);
+
+    // Reads the dimensions and channels (3 or 4) from the 14-byte header. Returns false if this is not QOI data.
+    bool read_qoi_header(const unsigned char* buffer, std::size_t size, int* width, int* height, int* channels);
+
+    // Decodes QOI data into a new[] allocated buffer of 'channels' interleaved channels. Returns nullptr if the data is
+    // invalid or truncated.
+    [[nodiscard]] unsigned char* decode_qoi(const unsigned char* buffer, std::size_t size, int* width, int* height, int* channels);
+
+}
+
+#endif //IMG_QOI_H
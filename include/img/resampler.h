@@ -0,0 +1,59 @@
+
+#ifndef IMG_RESAMPLER_H
+#define IMG_RESAMPLER_H
+
+#include "img.h"
+
+namespace img {
+
+    // Reconstruction filters used when resampling.
+    //   box      - average of the covered source pixels (radius 0.5)
+    //   bilinear - triangle filter (radius 1)
+    //   bicubic  - Catmull-Rom spline (radius 2)
+    //   lanczos3 - windowed sinc (radius 3)
+    enum class filter {
+        box,
+        bilinear,
+        bicubic,
+        lanczos3
+    };
+
+    // Resamples images of one size to another with a separable filter: a horizontal pass into an intermediate buffer,
+    // followed by a vertical pass into the destination. Filter weights for every output column and row are computed
+    // once on construction, so one resampler can be reused for any number of same-sized images.
+    class resampler {
+        public:
+            resampler(int source_width, int source_height, int width, int height, filter type);
+            ~resampler();
+
+            // Resamples tightly packed 'source' data (source_width by source_height pixels) into 'destination'
+            // (width by height pixels). Both buffers have 'channels' interleaved channels per pixel.
+            void resample(const unsigned char* source, unsigned char* destination, int channels) const;
+
+        private:
+            // Filter weights along one axis. Every output pixel reads 'taps' consecutive source pixels starting at
+            // 'start', unused trailing taps have a weight of zero.
+            struct weight_table {
+                weight_table(int source_size, int size, filter type);
+
+                int taps;
+                std::vector<int> start;
+                std::vector<float> weights; // 'taps' weights per output pixel.
+            };
+
+            // Resample rows [first, last) of their respective output.
+            void resample_horizontal(const unsigned char* source, float* destination, int channels, int first, int last) const;
+            void resample_vertical(const float* source, unsigned char* destination, int channels, int first, int last) const;
+
+            int source_width;
+            int source_height;
+            int width;
+            int height;
+
+            weight_table horizontal;
+            weight_table vertical;
+    };
+
+}
+
+#endif //IMG_RESAMPLER_H
@@ -0,0 +1,63 @@
+
+#ifndef IMG_RESULT_CACHE_H
+#define IMG_RESULT_CACHE_H
+
+#include "img.h"
+#include "img/image.h"
+
+namespace img {
+
+    // On-disk cache of processed images, addressed by a 64-bit key (see make_key()). Every entry is one file in the
+    // cache directory, holding a label and the pixels (QOI, or PAM for 1 and 2 channel images).
+    // Entries are written to a temporary file and renamed into place, so processes sharing a directory never see
+    // partial entries. Hits refresh the modification time of the entry, and once the entries exceed the size budget the
+    // least recently used ones are removed.
+    class result_cache {
+        public:
+            // Creates 'directory' if it doesn't exist.
+            explicit result_cache(const std::string& directory, std::uint64_t budget = std::uint64_t(1) << 30);
+            ~result_cache();
+
+            result_cache(const result_cache& other) = delete;
+            result_cache& operator=(const result_cache& other) = delete;
+
+            struct entry {
+                std::string label;
+                image result; // Named after the label.
+            };
+
+            // Key of the result of running operations described by 'chain' on 'source', depends on the pixels and
+            // dimensions of the image but not its name.
+            [[nodiscard]] static std::uint64_t make_key(const image& source, const std::string& chain);
+
+            // Returns nothing on a miss.
+            [[nodiscard]] std::optional<entry> find(std::uint64_t key);
+
+            // Replaces any existing entry for 'key'. Returns false if the entry could not be written.
+            bool store(std::uint64_t key, const image& result, const std::string& label);
+
+            // Removes least recently used entries until the cache fits its budget.
+            void trim();
+
+            [[nodiscard]] const std::string& get_directory() const;
+            [[nodiscard]] std::uint64_t get_budget() const;
+
+        private:
+            [[nodiscard]] std::string get_entry_path(std::uint64_t key) const;
+
+            std::string directory;
+            std::uint64_t budget;
+
+            // Size of the entries as of the last trim, plus everything stored since. Other processes sharing the
+            // directory are only accounted for when trimming.
+            std::atomic<std::uint64_t> size;
+            std::mutex trim_lock;
+    };
+
+    // Cache used by deferred processors, none by default.
+    void set_result_cache(std::shared_ptr<result_cache> cache);
+    [[nodiscard]] std::shared_ptr<result_cache> get_result_cache();
+
+}
+
+#endif //IMG_RESULT_CACHE_H
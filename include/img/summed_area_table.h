@@ -0,0 +1,38 @@
+
+#ifndef IMG_SUMMED_AREA_TABLE_H
+#define IMG_SUMMED_AREA_TABLE_H
+
+#include "img.h"
+
+namespace img {
+
+    // Forward declaration.
+    class image;
+
+    // Integral image, every entry holds the per-channel sum of all pixels above and to the left of it.
+    // Allows for the sum (and average) over any rectangular area to be computed with four lookups.
+    class summed_area_table {
+        public:
+            explicit summed_area_table(const image& im);
+            ~summed_area_table();
+
+            // Returns the average color of the pixels in a w by h area, starting at (x, y). The area is clipped to the
+            // bounds of the image.
+            [[nodiscard]] glm::vec4 mean(int x, int y, int w, int h) const;
+
+            [[nodiscard]] int get_height() const;
+            [[nodiscard]] int get_width() const;
+            [[nodiscard]] int get_channels() const;
+
+        private:
+            int width;
+            int height;
+            int channels;
+
+            // (width + 1) by (height + 1) entries, first row and column are zero.
+            std::vector<std::uint64_t> sums;
+    };
+
+}
+
+#endif //IMG_SUMMED_AREA_TABLE_H
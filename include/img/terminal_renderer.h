@@ -0,0 +1,60 @@
+
+#ifndef IMG_TERMINAL_RENDERER_H
+#define IMG_TERMINAL_RENDERER_H
+
+#include "img.h"
+#include "img/image.h"
+#include "img/ascii_renderer.h"
+
+namespace img {
+
+    // Renders images to terminals with 24-bit color support, using ANSI escape sequences. Each terminal cell covers a
+    // 'resolution' by 2 * 'resolution' block of pixels (cells are twice as tall as they are wide).
+    // Renderers are meant to be fed successive frames of the same stream: after the first frame, only cells that
+    // changed since the previous frame are emitted.
+    class terminal_renderer {
+        public:
+            //   resolution - pixels per cell, horizontally
+            //   half_block - draw the top and bottom half of every cell in separate colors with the upper half block
+            //                character, otherwise cells are ascii characters (see ascii_renderer) in the block color
+            //   threshold  - largest per-channel color difference for a cell to be considered unchanged
+            explicit terminal_renderer(int resolution = 8, bool half_block = true, int threshold = 0, const std::string& ramp = ascii_renderer::default_ramp);
+            ~terminal_renderer();
+
+            // Appends the escape sequences that update the terminal from the previous frame to 'frame'. The first
+            // frame, frames after reset(), and frames of a different size are drawn in full.
+            void render(const image& frame, std::string& output);
+            void render(const image& frame, std::ostream& stream);
+
+            // Makes the next frame redraw every cell (for example after the terminal was cleared).
+            void reset();
+
+        private:
+            struct cell {
+                std::array<unsigned char, 3> top;    // Foreground color.
+                std::array<unsigned char, 3> bottom; // Background color, only used for half blocks.
+                char character;                      // Only used for ascii characters.
+            };
+
+            // Computes the color of each cell of 'frame'.
+            void sample(const image& frame, std::vector<cell>& cells) const;
+
+            [[nodiscard]] bool is_unchanged(const cell& first, const cell& second) const;
+
+            int resolution;
+            bool half_block;
+            int threshold;
+            ascii_renderer characters;
+
+            int rows;
+            int columns;
+
+            // Cells as they are currently displayed on the terminal.
+            std::vector<cell> displayed;
+            std::vector<cell> current;
+            std::string buffer;
+    };
+
+}
+
+#endif //IMG_TERMINAL_RENDERER_H
@@ -0,0 +1,90 @@
+
+#ifndef IMG_THREAD_POOL_H
+#define IMG_THREAD_POOL_H
+
+#include "img.h"
+
+namespace img {
+
+    // Work-stealing pool of worker threads shared by the whole library.
+    // Every worker owns a queue of tasks: it runs its own tasks newest first and steals the oldest tasks of other
+    // workers when it runs out. Threads that are not part of the pool hand their tasks to a shared queue instead.
+    // A thread waiting on a parallel_for() runs queued tasks until its own are done, which makes nested calls safe
+    // without starting additional threads.
+    class thread_pool {
+        public:
+            // Starts 'num_threads' - 1 workers, the thread calling parallel_for() is always the last participant.
+            // Values of 0 or below default to the hardware concurrency.
+            explicit thread_pool(int num_threads = 0);
+            ~thread_pool();
+
+            thread_pool(const thread_pool& other) = delete;
+            thread_pool& operator=(const thread_pool& other) = delete;
+
+            // Calls function(first, last) for consecutive sub-ranges of [begin, end) of at least 'grain' elements,
+            // and returns once all of them completed. If any call throws, the first exception is rethrown here after
+            // the remaining sub-ranges completed.
+            void parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& function);
+
+            [[nodiscard]] int get_thread_count() const;
+
+        private:
+            using task = std::function<void()>;
+
+            struct task_queue {
+                std::mutex lock;
+                std::deque<task> tasks;
+            };
+
+            // Tasks of a single parallel_for() call.
+            struct task_group {
+                explicit task_group(int count);
+
+                // Keeps the exception of a failed task.
+                void fail(std::exception_ptr exception);
+
+                // Marks a task as completed, waking the waiting thread after the last one.
+                void finish();
+
+                [[nodiscard]] bool is_done() const;
+
+                // Blocks until every task completed.
+                void wait();
+
+                std::mutex lock;
+                std::condition_variable done;
+                std::atomic<int> remaining;
+                std::exception_ptr error;
+            };
+
+            void push(task work);
+            bool run_pending_task();
+            void work(int index);
+
+            std::vector<std::unique_ptr<task_queue>> queues; // One per worker, the last is shared by other threads.
+            std::vector<std::thread> workers;
+
+            std::mutex sleep_lock;
+            std::condition_variable wake;
+            std::atomic<int> num_queued;
+            bool stopping;
+    };
+
+    // Returns the pool used by all operations.
+    [[nodiscard]] thread_pool& get_thread_pool();
+
+    // Replaces the shared pool with one of 'num_threads' threads (0 for the hardware concurrency).
+    // Must not be called while operations are running, or while other threads may call get_thread_pool().
+    void set_thread_count(int num_threads);
+
+    // Splits the rows [0, height) over the shared pool, calling function(first, last) for each chunk of rows.
+    // 'grain' is the smallest number of rows worth handing to another thread.
+    void parallel_for_rows(int height, const std::function<void(int, int)>& function, int grain = 16);
+
+    // Splits the image into tiles of at most 'tile_size' x 'tile_size' pixels and calls function(x, y, w, h) for each
+    // of them on the shared pool.
+    void parallel_for_tiles(int width, int height, int tile_size, const std::function<void(int, int, int, int)>& function);
+
+}
+
+#endif //IMG_THREAD_POOL_H
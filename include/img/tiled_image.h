@@ -0,0 +1,116 @@
+
+#ifndef IMG_TILED_IMAGE_H
+#define IMG_TILED_IMAGE_H
+
+#include "img.h"
+#include "img/image.h"
+#include "img/netpbm.h"
+
+namespace img {
+
+    // Image stored as fixed-size square tiles, for images that do not fit in memory.
+    // At most 'memory_budget' bytes of tiles are kept in memory. When the budget is exceeded, the least recently used
+    // tile is evicted: modified tiles are written to a temporary file (created on first use, and removed along with the
+    // image) and read back when needed again. Tiles that were never written read as zero.
+    // Pixels are accessed by copying rectangular regions in and out, which is safe from multiple threads. Copies only
+    // lock the tiles they touch, tiles being copied are never evicted. Tiles are written to and read from the temporary
+    // file without blocking copies of other tiles. If that fails (for example when the disk is full), copies throw
+    // std::runtime_error; tiles that could not be written stay in memory, so no pixels are lost.
+    // Binary Netpbm files are streamed in and out one row at a time, so that images larger than memory can be processed
+    // end to end (see tiled_processor).
+    class tiled_image {
+        public:
+            static constexpr std::size_t default_memory_budget = std::size_t(256) << 20; // 256 MiB.
+            static constexpr int default_tile_size = 256;
+
+            tiled_image(int width, int height, int channels, std::size_t memory_budget = default_memory_budget, int tile_size = default_tile_size);
+
+            // Copies the pixels of 'im'.
+            explicit tiled_image(const image& im, std::size_t memory_budget = default_memory_budget, int tile_size = default_tile_size);
+
+            // Streams the pixels of a binary PBM, PGM, PPM or PAM file (see netpbm.h) into tiles. Throws
+            // std::runtime_error if the file cannot be read. Every row touches a whole row of tiles, which should fit in
+            // the budget.
+            explicit tiled_image(const std::string& filepath, std::size_t memory_budget = default_memory_budget, int tile_size = default_tile_size);
+            ~tiled_image();
+
+            tiled_image(const tiled_image& other) = delete;
+            tiled_image& operator=(const tiled_image& other) = delete;
+
+            // Copies the w by h area starting at (x, y) to or from 'pixels', which holds w * h pixels with interleaved
+            // channels, row after row. The area must lie inside of the image. Throws std::runtime_error if tiles cannot
+            // be written to or read from the temporary file.
+            void read(int x, int y, int w, int h, unsigned char* pixels) const;
+            void write(int x, int y, int w, int h, const unsigned char* pixels);
+
+            // Copies the whole image to memory, as 'filepath'.
+            [[nodiscard]] image to_image(const std::string& filepath) const;
+
+            // Streams the image to 'filepath' one row at a time, as PAM for the .pam extension, and as PGM or PPM (PAM
+            // with alpha) for .pgm, .ppm and .pnm. Returns false for other extensions, or if the file could not be
+            // written.
+            bool save(const std::string& filepath) const;
+
+            [[nodiscard]] int get_width() const;
+            [[nodiscard]] int get_height() const;
+            [[nodiscard]] int get_channels() const;
+            [[nodiscard]] int get_tile_size() const;
+            [[nodiscard]] std::size_t get_memory_budget() const;
+
+        private:
+            struct tile {
+                std::unique_ptr<unsigned char[]> data; // Null while not in memory.
+                bool dirty = false;                    // Modified since it was last written to the temporary file.
+                bool spilled = false;                  // Has a copy in the temporary file.
+                std::list<int>::iterator position;     // Position in 'recently_used' while in memory.
+                int pins = 0;                          // Copies in progress, the tile cannot be evicted while pinned.
+                bool busy = false;                     // Being written to or read from the temporary file.
+            };
+
+            // Creates empty tiles for an image of the dimensions in 'header'.
+            tiled_image(const netpbm_header& header, std::size_t memory_budget, int tile_size);
+
+            // Copies between 'pixels' and the tiles overlapping the given area.
+            void copy(int x, int y, int w, int h, unsigned char* pixels, bool to_tiles) const;
+
+            // Returns the data of tile 'index', loading it into memory if necessary, and pins the tile. 'guard' holds
+            // 'lock', which is released while tiles are read or written. Throws std::runtime_error if the temporary file
+            // cannot be read or written.
+            unsigned char* acquire(int index, std::unique_lock<std::mutex>& guard) const;
+
+            // Evicts the least recently used tile that is not pinned. Returns false if every tile in memory is pinned.
+            // 'guard' holds 'lock', which is released while the tile is written. Throws std::runtime_error if the tile
+            // cannot be written, the tile then stays in memory.
+            bool evict(std::unique_lock<std::mutex>& guard) const;
+
+            // Copy tile 'index' to or from the temporary file. Return false on failure.
+            bool write_spill(int index, const unsigned char* data) const;
+            bool read_spill(int index, unsigned char* data) const;
+
+            // Error for a failed read or write of the temporary file.
+            [[nodiscard]] std::runtime_error spill_error(const std::string& what) const;
+
+            int width;
+            int height;
+            int channels;
+            int tile_size;
+            int columns;
+            int rows;
+            std::size_t tile_bytes;
+            std::size_t memory_budget;
+
+            mutable std::mutex lock;               // Guards tile state and the list.
+            mutable std::condition_variable changed; // Notified when a tile is no longer busy.
+            mutable std::vector<tile> tiles;
+            std::unique_ptr<std::mutex[]> locks;   // Guards the pixels of each tile.
+            mutable std::list<int> recently_used; // Tiles in memory, most recently used first.
+            mutable std::size_t resident_bytes;
+
+            mutable std::mutex spill_lock;         // Guards the temporary file.
+            mutable std::fstream spill;
+            mutable std::string spill_path;
+    };
+
+}
+
+#endif //IMG_TILED_IMAGE_H
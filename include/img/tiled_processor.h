@@ -0,0 +1,44 @@
+
+#ifndef IMG_TILED_PROCESSOR_H
+#define IMG_TILED_PROCESSOR_H
+
+#include "img.h"
+#include "img/tiled_image.h"
+#include "img/point_operation.h"
+#include "img/error_diffuser.h"
+
+namespace img {
+
+    // Processes a tiled_image in place, for images too large for processor. Only operations that can run on part of
+    // the image at a time are supported:
+    //   - point-wise operations run tile by tile, in parallel
+    //   - to_lower_resolution() runs on strips of blocks, one row of blocks at a time
+    //   - error diffusion dithering streams the image one row at a time
+    // Operations produce the same results as their processor counterparts. They throw std::runtime_error if the image
+    // cannot be written to or read from its temporary file.
+    class tiled_processor {
+        public:
+            // Operations modify 'im', which must outlive the processor.
+            explicit tiled_processor(tiled_image& im);
+            ~tiled_processor();
+
+            [[nodiscard]] tiled_processor& to_grayscale(luma_weights weights = luma_weights::bt601, bool linear_light = false);
+            [[nodiscard]] tiled_processor& threshold(unsigned char level, luma_weights weights = luma_weights::bt601);
+            [[nodiscard]] tiled_processor& apply_lut(const std::array<unsigned char, 256>& table);
+            [[nodiscard]] tiled_processor& dither_bayer(int matrix_width, int matrix_height);
+
+            // Runs 'operations' in a single pass over the image. Operations may not change the channel count.
+            [[nodiscard]] tiled_processor& apply(const std::vector<point_operation>& operations);
+
+            [[nodiscard]] tiled_processor& to_lower_resolution(int x_resolution = 1, int y_resolution = 1);
+
+            // Error diffusion dithering.
+            [[nodiscard]] tiled_processor& dither(diffusion_matrix matrix);
+
+        private:
+            tiled_image& im;
+    };
+
+}
+
+#endif //IMG_TILED_PROCESSOR_H
@@ -0,0 +1,75 @@
+
+#ifndef IMG_TRACE_H
+#define IMG_TRACE_H
+
+#include "img.h"
+
+namespace img {
+
+    // Instrumentation of the library: timed scopes around operations and their major phases (decode, k-means
+    // iterations, encode, ...) and counters (bytes allocated for pixels, pixels processed).
+    // The IMG_TRACE_* macros below only record anything when the library is built with IMG_ENABLE_TRACING (CMake option
+    // of the same name), otherwise they compile to nothing and their arguments are not evaluated. When compiled in,
+    // recording starts with set_tracing(true), until then every scope costs a single atomic load.
+
+    // Starts or stops recording, disabled by default.
+    void set_tracing(bool enabled);
+    [[nodiscard]] bool get_tracing();
+
+    // Discards all recorded events and metrics.
+    void clear_trace();
+
+    // Writes recorded events in the Chrome trace event format (JSON), for chrome://tracing or Perfetto. Each thread keeps
+    // only its most recent 65536 events, get_metrics() still covers everything recorded.
+    void write_chrome_trace(std::ostream& output);
+
+    struct scope_metrics {
+        std::string name;
+        std::uint64_t count;
+        double total; // Milliseconds.
+        double max;   // Milliseconds.
+    };
+
+    struct metrics_snapshot {
+        std::vector<scope_metrics> scopes;
+        std::vector<std::pair<std::string, std::uint64_t>> counters;
+    };
+
+    // Totals since recording started (or was last cleared), sorted by name.
+    [[nodiscard]] metrics_snapshot get_metrics();
+
+    // Writes get_metrics() as text, one "<name> <value>" line per value (e.g. "k_means.total_ms 12.5").
+    void write_metrics(std::ostream& output);
+
+    // Records the time between construction and destruction. 'name' must outlive the trace (a string literal).
+    class trace_scope {
+        public:
+            explicit trace_scope(const char* name);
+            ~trace_scope();
+
+            trace_scope(const trace_scope& other) = delete;
+            trace_scope& operator=(const trace_scope& other) = delete;
+
+        private:
+            const char* name;
+            std::chrono::steady_clock::time_point start;
+            bool active;
+    };
+
+    // Adds 'value' to the counter 'name', which must outlive the trace (a string literal).
+    void add_trace_counter(const char* name, std::uint64_t value);
+
+}
+
+#ifdef IMG_ENABLE_TRACING
+    #define IMG_TRACE_CONCATENATE_(a, b) a##b
+    #define IMG_TRACE_CONCATENATE(a, b) IMG_TRACE_CONCATENATE_(a, b)
+
+    #define IMG_TRACE_SCOPE(name) ::img::trace_scope IMG_TRACE_CONCATENATE(img_trace_scope_, __LINE__)(name)
+    #define IMG_TRACE_COUNTER(name, value) ::img::add_trace_counter(name, static_cast<std::uint64_t>(value))
+#else
+    #define IMG_TRACE_SCOPE(name) ((void) 0)
+    #define IMG_TRACE_COUNTER(name, value) ((void) 0)
+#endif
+
+#endif //IMG_TRACE_H
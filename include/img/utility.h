@@ -6,17 +6,41 @@
 
 namespace img {
 
+    // Controls printing image information to stdout when an image is loaded, enabled by default. Printing takes the
+    // stream lock, applications loading images from many threads should disable it.
+    void set_logging(bool enabled);
+    [[nodiscard]] bool get_logging();
+
+    // Path separator of the platform, '\\' on Windows and '/' elsewhere.
+    [[nodiscard]] char get_native_separator();
     [[nodiscard]] std::string convert_to_native_separators(std::string path);
 
     [[nodiscard]] std::string get_directory(std::string path);
     [[nodiscard]] std::string get_asset_name(std::string path);
     [[nodiscard]] std::string get_asset_extension(std::string path);
 
+    // Random numbers are drawn from a generator per thread. Every generator restarts from 'seed' (on its next use)
+    // when the seed is set, so single threaded operations (k-means, Voronoi) produce the same results for the same
+    // seed. Until set, each thread is seeded from std::random_device and its own index.
+    void set_random_seed(std::uint32_t seed);
+
+    // Seed last passed to set_random_seed(), nothing if it was never set.
+    [[nodiscard]] std::optional<std::uint32_t> get_random_seed();
+    [[nodiscard]] std::mt19937& get_random_generator();
+
+    // Uniformly distributed value in [min, max].
     template <typename T>
     [[nodiscard]] T uniform_distribution(T min, T max) {
-        return glm::linearRand(min, max);
+        if constexpr (std::is_integral_v<T>) {
+            return std::uniform_int_distribution<T>(min, max)(get_random_generator());
+        }
+        else {
+            return std::uniform_real_distribution<T>(min, max)(get_random_generator());
+        }
     }
 
+    [[nodiscard]] glm::vec2 uniform_distribution(const glm::vec2& min, const glm::vec2& max);
+
     // Implementation of the Fast Poisson Disk Sampling white paper.
     // https://www.cs.ubc.ca/~rbridson/docs/bridson-siggraph07-poissondisk.pdf
     [[nodiscard]] std::vector<glm::ivec2> poisson_disk_2d(int width, int height, float minimum_separation, int rejection_limit);
@@ -0,0 +1,224 @@
+
+#include "img/batch_runner.h"
+#include "img/utility.h"
+
+namespace {
+
+    void print_usage() {
+        std::cerr << "Usage: img_batch [options] <input>...\n"
+                     "\n"
+                     "Runs the same operations on every input, in the order given, and saves the results.\n"
+                     "\n"
+                     "Options:\n"
+                     "  -o, --operation <name>[:<arguments>]  Adds an operation:\n"
+                     "                                          grayscale, lower_resolution:<w>x<h>, resize:<w>x<h>,\n"
+                     "                                          threshold:<level>, k_means:<k>, voronoi:<regions>,\n"
+                     "                                          gaussian_blur:<sigma>, box_blur:<radius>,\n"
+                     "                                          unsharp_mask:<sigma>, detect_edges,\n"
+                     "                                          equalize_histogram, auto_levels:<clip percent>,\n"
+                     "                                          clahe:<tiles>,\n"
+                     "                                          dither_bayer:<w>x<h>, dither_<matrix> (error_diffusion,\n"
+                     "                                          floyd_steinberg, false_floyd_steinberg,\n"
+                     "                                          jarvis_judice_ninke, stucki, atkinson, burkes, sierra,\n"
+                     "                                          two_row_sierra, sierra_lite)\n"
+                     "  -O, --output <directory>              Saves all results to <directory> (default\n"
+                     "                                          assets/generated/<image name>)\n"
+                     "  -m, --memory <MiB>                    Decoded pixels in flight (default 512)\n"
+                     "  -d, --decode-threads <count>          Threads decoding images (default 1)\n"
+                     "  -e, --encode-threads <count>          Threads encoding images (default 1)\n"
+                     "  -q, --queue <count>                   Images waiting between stages (default 2)\n"
+                     "  -v, --verbose                         Print image information on load\n";
+    }
+
+    // Parses "<w>x<h>".
+    bool parse_size(const std::string& value, int& width, int& height) {
+        std::size_t separator = value.find('x');
+        if (separator == std::string::npos) {
+            return false;
+        }
+
+        try {
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+
+        return width > 0 && height > 0;
+    }
+
+    bool parse_integer(const std::string& value, int& result) {
+        try {
+            result = std::stoi(value);
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool parse_float(const std::string& value, float& result) {
+        try {
+            result = std::stof(value);
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+
+        return true;
+    }
+
+    // Converts an operation given on the command line to a function running it on a processor.
+    std::optional<std::function<void(img::processor&)>> parse_operation(const std::string& operation) {
+        std::size_t separator = operation.find(':');
+        std::string name = operation.substr(0, separator);
+        std::string arguments = separator == std::string::npos ? "" : operation.substr(separator + 1);
+
+        int width;
+        int height;
+        int value;
+        float number;
+
+        if (name == "grayscale") {
+            return [](img::processor& p) { (void) p.to_grayscale(); };
+        }
+        if (name == "lower_resolution" && parse_size(arguments, width, height)) {
+            return [width, height](img::processor& p) { (void) p.to_lower_resolution(width, height); };
+        }
+        if (name == "resize" && parse_size(arguments, width, height)) {
+            return [width, height](img::processor& p) { (void) p.resize(width, height); };
+        }
+        if (name == "threshold" && parse_integer(arguments, value) && value >= 0 && value <= 255) {
+            return [value](img::processor& p) { (void) p.threshold(static_cast<unsigned char>(value)); };
+        }
+        if (name == "k_means" && parse_integer(arguments, value) && value > 0) {
+            return [value](img::processor& p) { (void) p.k_means(value); };
+        }
+        if (name == "voronoi" && parse_integer(arguments, value) && value > 0) {
+            return [value](img::processor& p) { (void) p.voronoi(value); };
+        }
+        if (name == "dither_bayer" && parse_size(arguments, width, height)) {
+            return [width, height](img::processor& p) { (void) p.dither_bayer(width, height); };
+        }
+        if (name == "gaussian_blur" && parse_float(arguments, number) && number > 0.0f) {
+            return [number](img::processor& p) { (void) p.gaussian_blur(number); };
+        }
+        if (name == "box_blur" && parse_integer(arguments, value) && value > 0) {
+            return [value](img::processor& p) { (void) p.box_blur(value); };
+        }
+        if (name == "unsharp_mask" && parse_float(arguments, number) && number > 0.0f) {
+            return [number](img::processor& p) { (void) p.unsharp_mask(number); };
+        }
+        if (name == "detect_edges" && arguments.empty()) {
+            return [](img::processor& p) { (void) p.detect_edges(); };
+        }
+        if (name == "equalize_histogram" && arguments.empty()) {
+            return [](img::processor& p) { (void) p.equalize_histogram(); };
+        }
+        if (name == "auto_levels" && parse_float(arguments, number) && number >= 0.0f && number < 50.0f) {
+            return [number](img::processor& p) { (void) p.auto_levels(number); };
+        }
+        if (name == "clahe" && parse_integer(arguments, value) && value > 0) {
+            return [value](img::processor& p) { (void) p.clahe(value); };
+        }
+
+        static const std::unordered_map<std::string, img::processor& (img::processor::*)()> dithers {
+            { "dither_error_diffusion", &img::processor::dither_error_diffusion },
+            { "dither_floyd_steinberg", &img::processor::dither_floyd_steinberg },
+            { "dither_false_floyd_steinberg", &img::processor::dither_false_floyd_steinberg },
+            { "dither_jarvis_judice_ninke", &img::processor::dither_jarvis_judice_ninke },
+            { "dither_stucki", &img::processor::dither_stucki },
+            { "dither_atkinson", &img::processor::dither_atkinson },
+            { "dither_burkes", &img::processor::dither_burkes },
+            { "dither_sierra", &img::processor::dither_sierra },
+            { "dither_two_row_sierra", &img::processor::dither_two_row_sierra },
+            { "dither_sierra_lite", &img::processor::dither_sierra_lite }
+        };
+
+        auto dither = dithers.find(name);
+        if (dither != dithers.end() && arguments.empty()) {
+            auto function = dither->second;
+            return [function](img::processor& p) { (void) (p.*function)(); };
+        }
+
+        return std::nullopt;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::function<void(img::processor&)>> operations;
+    std::vector<std::string> inputs;
+    img::batch_options options;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+        int value;
+
+        if ((argument == "-o" || argument == "--operation") && has_value) {
+            std::optional<std::function<void(img::processor&)>> operation = parse_operation(argv[++i]);
+            if (!operation) {
+                std::cerr << "Invalid operation: " << argv[i] << std::endl;
+                return 1;
+            }
+
+            operations.emplace_back(std::move(*operation));
+        }
+        else if ((argument == "-O" || argument == "--output") && has_value) {
+            options.output_directory = argv[++i];
+        }
+        else if ((argument == "-m" || argument == "--memory") && has_value && parse_integer(argv[++i], value) && value > 0) {
+            options.memory_limit = static_cast<std::size_t>(value) << 20;
+        }
+        else if ((argument == "-d" || argument == "--decode-threads") && has_value && parse_integer(argv[++i], value) && value > 0) {
+            options.decode_threads = value;
+        }
+        else if ((argument == "-e" || argument == "--encode-threads") && has_value && parse_integer(argv[++i], value) && value > 0) {
+            options.encode_threads = value;
+        }
+        else if ((argument == "-q" || argument == "--queue") && has_value && parse_integer(argv[++i], value) && value > 0) {
+            options.queue_capacity = value;
+        }
+        else if (argument == "-v" || argument == "--verbose") {
+            verbose = true;
+        }
+        else if (!argument.empty() && argument[0] == '-') {
+            print_usage();
+            return 1;
+        }
+        else {
+            inputs.emplace_back(argument);
+        }
+    }
+
+    if (inputs.empty() || operations.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    img::set_logging(verbose);
+
+    img::batch_runner runner([&operations](img::processor& p) {
+        for (const std::function<void(img::processor&)>& operation : operations) {
+            operation(p);
+        }
+    }, options);
+
+    int failures = 0;
+
+    for (const img::batch_result& result : runner.run(inputs)) {
+        if (result.success) {
+            std::cout << result.input << " -> " << result.output << '\n';
+        }
+        else {
+            std::cout << result.input << ": " << result.error << '\n';
+            ++failures;
+        }
+    }
+
+    return failures == 0 ? 0 : 2;
+}
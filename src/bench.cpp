@@ -0,0 +1,674 @@
+
+#include "img/image.h"
+#include "img/processor.h"
+#include "img/thread_pool.h"
+#include "img/utility.h"
+#include "img/hash.h"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+    #include <unistd.h>
+
+    #ifdef __APPLE__
+        #include <sys/sysctl.h>
+    #endif
+#endif
+
+namespace {
+
+    void print_usage() {
+        std::cerr << "Usage: img_bench [options]\n"
+                     "\n"
+                     "Times every processor operation on synthetic images.\n"
+                     "\n"
+                     "Options:\n"
+                     "  -s, --sizes <MP>[,<MP>...]        Image sizes in megapixels (default 1,12,48)\n"
+                     "  -c, --channels <n>[,<n>...]       Channel counts (default 1,3,4)\n"
+                     "  -r, --repetitions <count>         Runs per operation (default 5)\n"
+                     "  -f, --filter <text>               Only operations whose name contains <text>\n"
+                     "  -t, --threads <count>             Threads of the shared pool (default: hardware threads)\n"
+                     "  -j, --json                        Print results as JSON\n"
+                     "\n"
+                     "Regression checks run a fixed workload (synthetic 1 MP images and assets/images) with a fixed random seed:\n"
+                     "  -b, --baseline <file>             Compare with a baseline, fails on changed output and on slowdowns if\n"
+                     "                                    the baseline was written on this machine\n"
+                     "  -w, --write-baseline <file>       Write the results as a new baseline\n"
+                     "  -T, --tolerance <percent>         Allowed slowdown of the fastest run (default 25)\n";
+    }
+
+    // Seed of the random number generators for every run, randomized operations have reproducible output.
+    constexpr std::uint32_t seed = 1;
+
+    // Slowdowns of less than this many milliseconds are always considered noise.
+    constexpr double minimum_regression = 2.0;
+
+    // Returns text output of the operation (ASCII art), if any. Receives the source image, for its dimensions.
+    struct benchmark {
+        std::string name;
+        std::function<std::string(img::processor&, const img::image&)> run;
+    };
+
+    struct input {
+        std::string name;
+        img::image source;
+    };
+
+    struct result {
+        std::string name;
+        std::string input;
+        int width;
+        int height;
+        int channels;
+        double megapixels;
+        int repetitions;
+        double minimum;  // Milliseconds.
+        double median;   // Milliseconds.
+        double p95;      // Milliseconds.
+        double peak_rss; // MiB, of the whole process up to this point.
+        std::uint64_t checksum;
+        bool deterministic; // Whether every run produced the same output.
+    };
+
+    // Entry of a baseline file. Timings compare the fastest run, the least disturbed by other processes; the spread
+    // between it and the 95th percentile is the noise of the machine.
+    struct baseline_entry {
+        double minimum; // Milliseconds.
+        double spread;  // Milliseconds.
+        std::string checksum;
+    };
+
+    struct baseline {
+        std::string machine;
+        std::map<std::string, baseline_entry> entries;
+    };
+
+    std::vector<benchmark> get_benchmarks() {
+        std::vector<benchmark> benchmarks = {
+            { "grayscale", [](img::processor& p, const img::image&) { (void) p.to_grayscale(); return std::string(); } },
+            { "threshold", [](img::processor& p, const img::image&) { (void) p.threshold(128); return std::string(); } },
+            { "apply_lut", [](img::processor& p, const img::image&) {
+                std::array<unsigned char, 256> table { };
+                for (int i = 0; i < 256; ++i) {
+                    table[i] = static_cast<unsigned char>(255 - i);
+                }
+
+                (void) p.apply_lut(table);
+                return std::string();
+            } },
+            { "lower_resolution_8x8", [](img::processor& p, const img::image&) { (void) p.to_lower_resolution(8, 8); return std::string(); } },
+            { "lower_resolution_20x20", [](img::processor& p, const img::image&) { (void) p.to_lower_resolution(20, 20); return std::string(); } },
+            { "resize_half", [](img::processor& p, const img::image& source) { (void) p.resize(source.get_width() / 2, source.get_height() / 2); return std::string(); } },
+            { "ascii_8", [](img::processor& p, const img::image&) { return p.to_ascii(8); } },
+            { "ascii_20", [](img::processor& p, const img::image&) { return p.to_ascii(20); } }
+        };
+
+        for (int k : { 2, 8, 16 }) {
+            benchmarks.push_back({ "k_means_" + std::to_string(k), [k](img::processor& p, const img::image&) { (void) p.k_means(k); return std::string(); } });
+        }
+
+        static const std::vector<std::pair<std::string, img::processor& (img::processor::*)()>> dithers {
+            { "dither_error_diffusion", &img::processor::dither_error_diffusion },
+            { "dither_floyd_steinberg", &img::processor::dither_floyd_steinberg },
+            { "dither_false_floyd_steinberg", &img::processor::dither_false_floyd_steinberg },
+            { "dither_jarvis_judice_ninke", &img::processor::dither_jarvis_judice_ninke },
+            { "dither_stucki", &img::processor::dither_stucki },
+            { "dither_atkinson", &img::processor::dither_atkinson },
+            { "dither_burkes", &img::processor::dither_burkes },
+            { "dither_sierra", &img::processor::dither_sierra },
+            { "dither_two_row_sierra", &img::processor::dither_two_row_sierra },
+            { "dither_sierra_lite", &img::processor::dither_sierra_lite }
+        };
+
+        for (const auto& dither : dithers) {
+            auto function = dither.second;
+            benchmarks.push_back({ dither.first, [function](img::processor& p, const img::image&) { (void) (p.*function)(); return std::string(); } });
+        }
+
+        for (int size : { 2, 4, 8 }) {
+            benchmarks.push_back({ "dither_bayer_" + std::to_string(size) + 'x' + std::to_string(size), [size](img::processor& p, const img::image&) { (void) p.dither_bayer(size, size); return std::string(); } });
+        }
+
+        for (float sigma : { 1.0f, 4.0f }) {
+            benchmarks.push_back({ "gaussian_blur_" + std::to_string(static_cast<int>(sigma)), [sigma](img::processor& p, const img::image&) { (void) p.gaussian_blur(sigma); return std::string(); } });
+        }
+
+        for (int radius : { 2, 16 }) {
+            benchmarks.push_back({ "box_blur_" + std::to_string(radius), [radius](img::processor& p, const img::image&) { (void) p.box_blur(radius); return std::string(); } });
+        }
+
+        benchmarks.push_back({ "unsharp_mask", [](img::processor& p, const img::image&) { (void) p.unsharp_mask(); return std::string(); } });
+        benchmarks.push_back({ "detect_edges", [](img::processor& p, const img::image&) { (void) p.detect_edges(); return std::string(); } });
+        benchmarks.push_back({ "equalize_histogram", [](img::processor& p, const img::image&) { (void) p.equalize_histogram(); return std::string(); } });
+        benchmarks.push_back({ "auto_levels", [](img::processor& p, const img::image&) { (void) p.auto_levels(); return std::string(); } });
+        benchmarks.push_back({ "clahe", [](img::processor& p, const img::image&) { (void) p.clahe(); return std::string(); } });
+
+        for (int regions : { 100, 1000, 10000 }) {
+            benchmarks.push_back({ "voronoi_" + std::to_string(regions), [regions](img::processor& p, const img::image&) { (void) p.voronoi(regions); return std::string(); } });
+        }
+
+        return benchmarks;
+    }
+
+    // Smooth gradients with some noise, so neither flat areas nor pure noise dominate. Noise is seeded per row, the
+    // pixels do not depend on the number of threads.
+    img::image make_image(double megapixels, int channels) {
+        int width = static_cast<int>(std::lround(std::sqrt(megapixels * 1e6 * 4.0 / 3.0)));
+        int height = static_cast<int>(std::lround(width * 3.0 / 4.0));
+
+        img::image im("bench/synthetic_" + std::to_string(width) + 'x' + std::to_string(height) + ".png", width, height, channels);
+        unsigned char* data = im.get_data();
+
+        img::parallel_for_rows(height, [&](int first, int last) {
+            std::mt19937 generator;
+            std::uniform_int_distribution<int> noise(-16, 16);
+
+            for (int y = first; y < last; ++y) {
+                generator.seed(static_cast<std::uint32_t>(y));
+
+                for (int x = 0; x < width; ++x) {
+                    unsigned char* pixel = data + (static_cast<std::size_t>(y) * width + x) * channels;
+
+                    for (int c = 0; c < channels; ++c) {
+                        int value = (x * (c + 1) * 255 / width + y * 255 / height) / 2 + noise(generator);
+                        pixel[c] = static_cast<unsigned char>(std::clamp(value, 0, 255));
+                    }
+                }
+            }
+        });
+
+        return im;
+    }
+
+    input make_input(double megapixels, int channels) {
+        img::image source = make_image(megapixels, channels);
+        std::string name = source.get_file().name + 'x' + std::to_string(channels);
+        return { name, std::move(source) };
+    }
+
+    // Fixed workload of regression checks: synthetic 1 MP images of every channel count and the repository images.
+    std::vector<input> get_regression_inputs() {
+        std::vector<input> inputs;
+
+        for (int channels : { 1, 3, 4 }) {
+            inputs.emplace_back(make_input(1.0, channels));
+        }
+
+        std::vector<std::string> paths;
+        std::error_code error;
+
+        for (const auto& entry : std::filesystem::directory_iterator("assets/images", error)) {
+            if (entry.is_regular_file()) {
+                paths.emplace_back(entry.path().generic_string());
+            }
+        }
+
+        if (error) {
+            std::cerr << "Failed to list assets/images, regression checks use synthetic images only." << std::endl;
+        }
+
+        // Directory order is unspecified.
+        std::sort(paths.begin(), paths.end());
+
+        for (const std::string& path : paths) {
+            try {
+                inputs.push_back({ path.substr(std::string("assets/").size()), img::image(path) });
+            }
+            catch (const std::exception& exception) {
+                std::cerr << exception.what() << std::endl;
+            }
+        }
+
+        return inputs;
+    }
+
+    double get_peak_rss() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return 0.0;
+        }
+
+        return static_cast<double>(counters.PeakWorkingSetSize) / (1 << 20);
+#else
+        rusage usage { };
+        getrusage(RUSAGE_SELF, &usage);
+
+    #ifdef __APPLE__
+        return static_cast<double>(usage.ru_maxrss) / (1 << 20); // Bytes.
+    #else
+        return static_cast<double>(usage.ru_maxrss) / (1 << 10); // Kilobytes.
+    #endif
+#endif
+    }
+
+    // Nearest-rank percentile of sorted 'samples'.
+    double percentile(const std::vector<double>& samples, double fraction) {
+        auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(samples.size())));
+        return samples[std::clamp<std::size_t>(rank, 1, samples.size()) - 1];
+    }
+
+    // Hash of the dimensions and pixels of 'im', and of 'text'.
+    std::uint64_t get_checksum(const img::image& im, const std::string& text) {
+        std::array<int, 3> shape { im.get_width(), im.get_height(), im.get_channels() };
+
+        std::uint64_t hash = img::xxhash64(shape.data(), sizeof(shape));
+        hash = img::xxhash64(text.data(), text.size(), hash);
+        return img::xxhash64(im.get_data(), static_cast<std::size_t>(im.get_width()) * im.get_height() * im.get_channels(), hash);
+    }
+
+    result measure(const benchmark& bench, const input& in, int repetitions) {
+        const img::image& source = in.source;
+
+        std::vector<double> samples;
+        std::uint64_t checksum = 0;
+        bool deterministic = true;
+
+        for (int i = 0; i < repetitions; ++i) {
+            // Fresh pixels for every run, copies of 'source' would share its summed-area table and pyramid once they
+            // are built. Copying is not part of the operation.
+            img::image pixels(source.get_file().path, source.get_width(), source.get_height(), source.get_channels());
+            std::memcpy(pixels.get_data(), source.get_data(), static_cast<std::size_t>(source.get_width()) * source.get_height() * source.get_channels());
+
+            img::processor p(pixels);
+            img::set_random_seed(seed);
+
+            auto start = std::chrono::steady_clock::now();
+            std::string text = bench.run(p, source);
+            auto end = std::chrono::steady_clock::now();
+
+            samples.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+            std::uint64_t run_checksum = get_checksum(p.get(), text);
+            if (i > 0 && run_checksum != checksum) {
+                deterministic = false;
+            }
+
+            checksum = run_checksum;
+        }
+
+        std::sort(samples.begin(), samples.end());
+
+        double megapixels = static_cast<double>(source.get_width()) * source.get_height() / 1e6;
+        return { bench.name, in.name, source.get_width(), source.get_height(), source.get_channels(), megapixels, repetitions, samples.front(), percentile(samples, 0.5), percentile(samples, 0.95), get_peak_rss(), checksum, deterministic };
+    }
+
+    std::string get_host_name() {
+#ifdef _WIN32
+        char name[MAX_COMPUTERNAME_LENGTH + 1];
+        DWORD size = sizeof(name);
+        return GetComputerNameA(name, &size) ? std::string(name, size) : std::string();
+#else
+        char name[256] { };
+        return gethostname(name, sizeof(name) - 1) == 0 ? std::string(name) : std::string();
+#endif
+    }
+
+    // Processor brand string, empty if unknown.
+    std::string get_cpu_model() {
+#if defined(_WIN32)
+        char name[256];
+        DWORD size = sizeof(name);
+        if (RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", "ProcessorNameString", RRF_RT_REG_SZ, nullptr, name, &size) != ERROR_SUCCESS) {
+            return {};
+        }
+
+        return name;
+#elif defined(__APPLE__)
+        char name[256] { };
+        std::size_t size = sizeof(name) - 1;
+        return sysctlbyname("machdep.cpu.brand_string", name, &size, nullptr, 0) == 0 ? std::string(name) : std::string();
+#else
+        // "model name" on x86, ARM kernels may only list "Hardware" or "CPU part".
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        std::string model;
+
+        while (std::getline(cpuinfo, line)) {
+            std::size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+
+            std::string key = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+            std::string value = line.substr(std::min(line.size(), colon + 2));
+
+            if (key == "model name") {
+                return value;
+            }
+
+            if (model.empty() && (key == "Hardware" || key == "CPU part")) {
+                model = value;
+            }
+        }
+
+        return model;
+#endif
+    }
+
+    // Host name, processor and hardware thread count. Timings of baselines are only comparable on the machine that
+    // wrote them, host names alone are often shared (containers, CI runners, "localhost").
+    std::string get_machine_name() {
+        std::string name = get_host_name() + ", " + get_cpu_model() + ", " + std::to_string(std::thread::hardware_concurrency()) + " threads";
+
+        // Stored as a JSON string.
+        name.erase(std::remove_if(name.begin(), name.end(), [](char c) {
+            return c == '"' || c == '\\';
+        }), name.end());
+
+        return name;
+    }
+
+    std::vector<double> parse_list(const std::string& value) {
+        std::vector<double> values;
+        std::stringstream stream(value);
+        std::string item;
+
+        while (std::getline(stream, item, ',')) {
+            try {
+                values.emplace_back(std::stod(item));
+            }
+            catch (const std::exception&) {
+                return { };
+            }
+        }
+
+        return values;
+    }
+
+    void print_json(const std::vector<result>& results) {
+        std::cout << "{\n";
+        std::cout << "  \"threads\": " << img::get_thread_pool().get_thread_count() << ",\n";
+        std::cout << "  \"results\": [\n";
+
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const result& r = results[i];
+
+            std::cout << "    { \"operation\": \"" << r.name << "\", \"input\": \"" << r.input << "\", \"width\": " << r.width << ", \"height\": " << r.height
+                      << ", \"channels\": " << r.channels << ", \"megapixels\": " << r.megapixels << ", \"repetitions\": " << r.repetitions
+                      << ", \"min_ms\": " << r.minimum << ", \"median_ms\": " << r.median << ", \"p95_ms\": " << r.p95 << ", \"megapixels_per_second\": " << r.megapixels / (r.median / 1000.0)
+                      << ", \"peak_rss_mib\": " << r.peak_rss << ", \"checksum\": \"" << img::to_hex(r.checksum) << "\" }" << (i + 1 < results.size() ? "," : "") << '\n';
+        }
+
+        std::cout << "  ]\n";
+        std::cout << "}" << std::endl;
+    }
+
+    // Baselines hold one result per line, keyed by operation and input.
+    bool write_baseline(const std::string& filepath, const std::vector<result>& results) {
+        std::ofstream file(filepath);
+        if (!file) {
+            return false;
+        }
+
+        file << "{\n";
+        file << "  \"seed\": " << seed << ",\n";
+        file << "  \"machine\": \"" << get_machine_name() << "\",\n";
+        file << "  \"results\": [\n";
+
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const result& r = results[i];
+
+            file << "    { \"operation\": \"" << r.name << "\", \"input\": \"" << r.input << "\", \"min_ms\": " << std::fixed << std::setprecision(3) << r.minimum
+                 << ", \"spread_ms\": " << r.p95 - r.minimum << ", \"checksum\": \"" << img::to_hex(r.checksum) << "\" }" << (i + 1 < results.size() ? "," : "") << '\n';
+        }
+
+        file << "  ]\n";
+        file << "}" << std::endl;
+
+        return static_cast<bool>(file);
+    }
+
+    // Returns the value of "key" in a line written by write_baseline(), without quotes.
+    std::string get_field(const std::string& line, const std::string& key) {
+        std::size_t position = line.find('"' + key + "\":");
+        if (position == std::string::npos) {
+            return { };
+        }
+
+        position = line.find_first_not_of(' ', position + key.size() + 3);
+        if (position == std::string::npos) {
+            return { };
+        }
+
+        if (line[position] == '"') {
+            std::size_t end = line.find('"', position + 1);
+            return end == std::string::npos ? std::string() : line.substr(position + 1, end - position - 1);
+        }
+
+        std::size_t end = line.find_first_of(",}", position);
+        return line.substr(position, end == std::string::npos ? std::string::npos : end - position);
+    }
+
+    std::optional<baseline> read_baseline(const std::string& filepath) {
+        std::ifstream file(filepath);
+        if (!file) {
+            return std::nullopt;
+        }
+
+        baseline contents;
+        std::string line;
+
+        while (std::getline(file, line)) {
+            std::string operation = get_field(line, "operation");
+            if (operation.empty()) {
+                if (line.find("\"machine\":") != std::string::npos) {
+                    contents.machine = get_field(line, "machine");
+                }
+
+                continue;
+            }
+
+            try {
+                contents.entries[operation + '|' + get_field(line, "input")] = { std::stod(get_field(line, "min_ms")), std::stod(get_field(line, "spread_ms")), get_field(line, "checksum") };
+            }
+            catch (const std::exception&) {
+                return std::nullopt;
+            }
+        }
+
+        return contents;
+    }
+
+    // Whether the fastest run of 'r' is slower than in the baseline by more than 'tolerance' percent plus the noise of
+    // both measurements.
+    bool is_slower(const baseline_entry& entry, const result& r, double tolerance) {
+        double noise = std::max({ minimum_regression, entry.spread, r.p95 - r.minimum });
+        return r.minimum > entry.minimum * (1.0 + tolerance / 100.0) + noise;
+    }
+
+    // Prints every result next to its baseline. Returns false if any operation produced different output, produced
+    // different output between runs, or (on the machine that wrote the baseline) had its fastest run become slower by
+    // more than 'tolerance' percent plus the noise of both measurements. Slowdowns on other machines are only reported.
+    bool check_baseline(const baseline& reference, const std::vector<result>& results, double tolerance) {
+        bool passed = true;
+        bool same_machine = !reference.machine.empty() && reference.machine == get_machine_name();
+
+        if (!same_machine) {
+            std::cout << "Baseline was written on another machine (" << (reference.machine.empty() ? "unknown" : reference.machine)
+                      << "), slowdowns are reported but do not fail the check." << std::endl;
+        }
+
+        std::cout << std::left << std::setw(30) << "operation" << std::setw(24) << "input" << std::right << std::setw(12) << "baseline ms"
+                  << std::setw(12) << "min ms" << std::setw(10) << "change" << "  status" << std::endl;
+
+        for (const result& r : results) {
+            auto iterator = reference.entries.find(r.name + '|' + r.input);
+            std::string status = "ok";
+
+            if (!r.deterministic) {
+                status = "FAIL (output differs between runs)";
+                passed = false;
+            }
+            else if (iterator == reference.entries.end()) {
+                status = "new";
+            }
+            else if (iterator->second.checksum != img::to_hex(r.checksum)) {
+                status = "FAIL (output changed)";
+                passed = false;
+            }
+            else if (is_slower(iterator->second, r, tolerance)) {
+                status = same_machine ? "FAIL (slower)" : "slower (not enforced)";
+                passed = passed && !same_machine;
+            }
+
+            std::cout << std::left << std::setw(30) << r.name << std::setw(24) << r.input << std::right << std::fixed << std::setprecision(2);
+
+            if (iterator != reference.entries.end()) {
+                double change = (r.minimum / iterator->second.minimum - 1.0) * 100.0;
+                std::cout << std::setw(12) << iterator->second.minimum << std::setw(12) << r.minimum << std::setw(9) << std::showpos << change << std::noshowpos << '%';
+            }
+            else {
+                std::cout << std::setw(12) << '-' << std::setw(12) << r.minimum << std::setw(10) << '-';
+            }
+
+            std::cout << "  " << status << std::endl;
+        }
+
+        return passed;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<double> sizes = { 1, 12, 48 };
+    std::vector<double> channel_counts = { 1, 3, 4 };
+    int repetitions = 5;
+    std::string filter;
+    bool json = false;
+
+    std::string baseline_path;
+    std::string output_baseline_path;
+    double tolerance = 25.0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if ((argument == "-s" || argument == "--sizes") && has_value) {
+            sizes = parse_list(argv[++i]);
+        }
+        else if ((argument == "-c" || argument == "--channels") && has_value) {
+            channel_counts = parse_list(argv[++i]);
+        }
+        else if ((argument == "-r" || argument == "--repetitions") && has_value) {
+            repetitions = std::atoi(argv[++i]);
+        }
+        else if ((argument == "-f" || argument == "--filter") && has_value) {
+            filter = argv[++i];
+        }
+        else if ((argument == "-t" || argument == "--threads") && has_value) {
+            img::set_thread_count(std::atoi(argv[++i]));
+        }
+        else if (argument == "-j" || argument == "--json") {
+            json = true;
+        }
+        else if ((argument == "-b" || argument == "--baseline") && has_value) {
+            baseline_path = argv[++i];
+        }
+        else if ((argument == "-w" || argument == "--write-baseline") && has_value) {
+            output_baseline_path = argv[++i];
+        }
+        else if ((argument == "-T" || argument == "--tolerance") && has_value) {
+            tolerance = std::atof(argv[++i]);
+        }
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    bool valid_channels = std::all_of(channel_counts.begin(), channel_counts.end(), [](double channels) {
+        return channels >= 1 && channels <= 4;
+    });
+
+    if (sizes.empty() || channel_counts.empty() || !valid_channels || repetitions <= 0 || tolerance < 0.0) {
+        print_usage();
+        return 1;
+    }
+
+    img::set_logging(false);
+
+    std::optional<baseline> reference;
+    if (!baseline_path.empty()) {
+        reference = read_baseline(baseline_path);
+
+        if (!reference) {
+            std::cerr << "Failed to read baseline: " << baseline_path << std::endl;
+            return 1;
+        }
+    }
+
+    bool regression = reference || !output_baseline_path.empty();
+    bool print_results = !json && !regression;
+
+    std::vector<input> inputs;
+    if (regression) {
+        inputs = get_regression_inputs();
+    }
+    else {
+        for (double size : sizes) {
+            for (double channels : channel_counts) {
+                inputs.emplace_back(make_input(size, static_cast<int>(channels)));
+            }
+        }
+    }
+
+    std::vector<benchmark> benchmarks = get_benchmarks();
+    std::vector<result> results;
+
+    if (print_results) {
+        std::cout << std::left << std::setw(30) << "operation" << std::right << std::setw(12) << "size" << std::setw(4) << "ch"
+                  << std::setw(12) << "median ms" << std::setw(12) << "p95 ms" << std::setw(12) << "MP/s" << std::setw(14) << "peak RSS MiB" << std::endl;
+    }
+
+    for (const input& in : inputs) {
+        for (const benchmark& bench : benchmarks) {
+            if (!filter.empty() && bench.name.find(filter) == std::string::npos) {
+                continue;
+            }
+
+            result r = measure(bench, in, repetitions);
+
+            // Apparent slowdowns are measured again before they are reported, load from other processes rarely lasts
+            // through several measurements.
+            if (reference) {
+                auto iterator = reference->entries.find(r.name + '|' + r.input);
+
+                for (int attempt = 0; attempt < 2 && iterator != reference->entries.end() && is_slower(iterator->second, r, tolerance); ++attempt) {
+                    result again = measure(bench, in, repetitions);
+                    r.minimum = std::min(r.minimum, again.minimum);
+                    r.deterministic = r.deterministic && again.deterministic && again.checksum == r.checksum;
+                }
+            }
+
+            results.emplace_back(r);
+
+            if (print_results) {
+                std::cout << std::left << std::setw(30) << r.name << std::right << std::setw(12) << (std::to_string(r.width) + 'x' + std::to_string(r.height))
+                          << std::setw(4) << r.channels << std::fixed << std::setprecision(2) << std::setw(12) << r.median << std::setw(12) << r.p95
+                          << std::setw(12) << r.megapixels / (r.median / 1000.0) << std::setw(14) << r.peak_rss << std::endl;
+            }
+        }
+    }
+
+    if (json) {
+        print_json(results);
+    }
+
+    if (!output_baseline_path.empty() && !write_baseline(output_baseline_path, results)) {
+        std::cerr << "Failed to write baseline: " << output_baseline_path << std::endl;
+        return 1;
+    }
+
+    if (reference && !check_baseline(*reference, results, tolerance)) {
+        std::cerr << "Performance regression check failed." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
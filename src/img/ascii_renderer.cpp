@@ -0,0 +1,158 @@
+
+#include "img/ascii_renderer.h"
+#include "img/thread_pool.h"
+
+namespace img {
+
+    const char* const ascii_renderer::default_ramp = "@%#*+=-:.";
+
+    ascii_renderer::ascii_renderer(int resolution, const std::string &ramp, luma_weights weights) : resolution(std::max(resolution, 1)),
+                                                                                                   weights(weights),
+                                                                                                   characters()
+                                                                                                   {
+        set_ramp(ramp);
+    }
+
+    ascii_renderer::~ascii_renderer() = default;
+
+    void ascii_renderer::set_ramp(const std::string &ramp) {
+        if (ramp.empty()) {
+            std::cerr << "Empty character ramp passed to ascii_renderer." << std::endl;
+            characters.fill(' ');
+            return;
+        }
+
+        std::size_t num_characters = ramp.size();
+
+        for (std::size_t value = 0; value < characters.size(); ++value) {
+            std::size_t index = value * num_characters / 255;
+            characters[value] = ramp[std::min(index, num_characters - 1)];
+        }
+    }
+
+    void ascii_renderer::set_ramp(const std::string &ramp, const histogram_counts &distribution) {
+        std::uint64_t total = std::accumulate(distribution.begin(), distribution.end(), std::uint64_t(0));
+
+        if (ramp.empty() || total == 0) {
+            set_ramp(ramp);
+            return;
+        }
+
+        std::size_t num_characters = ramp.size();
+        std::uint64_t cumulative = 0;
+
+        for (std::size_t value = 0; value < characters.size(); ++value) {
+            // Position of the middle of this value's share.
+            double position = (static_cast<double>(cumulative) + static_cast<double>(distribution[value]) / 2.0) / static_cast<double>(total);
+            cumulative += distribution[value];
+
+            std::size_t index = static_cast<std::size_t>(position * static_cast<double>(num_characters));
+            characters[value] = ramp[std::min(index, num_characters - 1)];
+        }
+    }
+
+    char ascii_renderer::get_character(unsigned char luma) const {
+        return characters[luma];
+    }
+
+    int ascii_renderer::get_rows(int height) const {
+        return (height + 2 * resolution - 1) / (2 * resolution);
+    }
+
+    int ascii_renderer::get_columns(int width) const {
+        return (width + resolution - 1) / resolution;
+    }
+
+    std::size_t ascii_renderer::get_buffer_size(int width, int height) const {
+        return static_cast<std::size_t>(get_rows(height)) * (get_columns(width) + 1);
+    }
+
+    std::size_t ascii_renderer::render(const image &im, char *buffer) const {
+        int rows = get_rows(im.get_height());
+        std::size_t row_size = get_columns(im.get_width()) + 1;
+
+        // Chunks of roughly 64K sampled pixels, smaller images are not worth splitting.
+        static const int pixels_per_chunk = 1 << 16;
+        int grain = std::max(1, pixels_per_chunk / std::max(1, im.get_width() * resolution));
+
+        parallel_for_rows(rows, [&](int first, int last) {
+            render_rows(im, first, last, buffer + first * row_size);
+        }, grain);
+
+        return rows * row_size;
+    }
+
+    void ascii_renderer::render(const image &im, std::ostream &stream) const {
+        render(im, [&stream](const char* row, std::size_t length) {
+            stream.write(row, static_cast<std::streamsize>(length));
+        });
+    }
+
+    void ascii_renderer::render(const image &im, const row_callback &callback) const {
+        int rows = get_rows(im.get_height());
+        std::size_t row_size = get_columns(im.get_width()) + 1;
+
+        // Reused between calls to avoid allocating per frame.
+        thread_local std::vector<char> row;
+        row.resize(row_size);
+
+        for (int y = 0; y < rows; ++y) {
+            render_rows(im, y, y + 1, row.data());
+            callback(row.data(), row_size);
+        }
+    }
+
+    std::string ascii_renderer::render(const image &im) const {
+        std::string ascii(get_buffer_size(im.get_width(), im.get_height()), '\n');
+        render(im, ascii.data());
+        return ascii;
+    }
+
+    void ascii_renderer::render_rows(const image &im, int first, int last, char *output) const {
+        int width = im.get_width();
+        int height = im.get_height();
+        int channels = im.get_channels();
+        int columns = get_columns(width);
+        const unsigned char* data = im.get_data();
+
+        // Luma of one pixel row, and running luma total of each block in the current row of blocks.
+        // Reused between calls to avoid allocating per frame.
+        thread_local std::vector<unsigned char> luma;
+        thread_local std::vector<std::uint32_t> sums;
+        luma.resize(width);
+        sums.resize(columns);
+
+        for (int row = first; row < last; ++row) {
+            // Only the top block of every two rows of blocks is sampled.
+            int y0 = row * 2 * resolution;
+            int y1 = std::min(y0 + resolution, height);
+
+            std::fill(sums.begin(), sums.end(), 0);
+
+            for (int y = y0; y < y1; ++y) {
+                convert_to_luma(data + static_cast<std::size_t>(y) * width * channels, channels, luma.data(), width, weights);
+
+                for (int column = 0; column < columns; ++column) {
+                    int x0 = column * resolution;
+                    int x1 = std::min(x0 + resolution, width);
+
+                    std::uint32_t sum = 0;
+                    for (int x = x0; x < x1; ++x) {
+                        sum += luma[x];
+                    }
+
+                    sums[column] += sum;
+                }
+            }
+
+            for (int column = 0; column < columns; ++column) {
+                int block_width = std::min(resolution, width - column * resolution);
+                std::uint32_t count = static_cast<std::uint32_t>(block_width * (y1 - y0));
+                *output++ = characters[sums[column] / count];
+            }
+
+            *output++ = '\n';
+        }
+    }
+
+}
@@ -0,0 +1,179 @@
+
+#include "img/batch_runner.h"
+#include "img/bounded_queue.h"
+#include "img/probe.h"
+
+namespace img {
+
+    namespace {
+
+        // Image moving through the pipeline.
+        struct job {
+            std::size_t index;
+            std::size_t bytes; // Reserved from the memory budget.
+            std::optional<image> im;
+        };
+
+    }
+
+    batch_runner::memory_budget::memory_budget(std::size_t limit) : limit(limit),
+                                                                    used(0),
+                                                                    lock(),
+                                                                    available()
+                                                                    {
+    }
+
+    void batch_runner::memory_budget::acquire(std::size_t bytes) {
+        std::unique_lock<std::mutex> guard(lock);
+
+        // Images over the limit run once nothing else is in flight.
+        available.wait(guard, [this, bytes]() {
+            return used == 0 || used + bytes <= limit;
+        });
+
+        used += bytes;
+    }
+
+    void batch_runner::memory_budget::release(std::size_t bytes) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            used -= bytes;
+        }
+
+        available.notify_all();
+    }
+
+    void batch_runner::memory_budget::resize(std::size_t from, std::size_t to) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            used = used - from + to;
+        }
+
+        available.notify_all();
+    }
+
+    batch_runner::batch_runner(std::function<void(processor&)> operations, batch_options options) : operations(std::move(operations)),
+                                                                                                      options(options)
+                                                                                                      {
+    }
+
+    batch_runner::~batch_runner() = default;
+
+    std::vector<batch_result> batch_runner::run(const std::vector<std::string> &inputs) const {
+        std::vector<batch_result> results(inputs.size());
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            results[i] = { inputs[i], "", false, "" };
+        }
+
+        memory_budget budget(options.memory_limit);
+        bounded_queue<job> decoded(options.queue_capacity);
+        bounded_queue<job> processed(options.queue_capacity);
+
+        // Decode stage, inputs are claimed in order.
+        std::atomic<std::size_t> next(0);
+
+        auto decode = [&]() {
+            for (std::size_t index = next++; index < inputs.size(); index = next++) {
+                // Reserve memory for the working set before decoding: the decoded pixels, then the processor's copy.
+                std::optional<image_info> info = probe(inputs[index]);
+                if (!info) {
+                    results[index].error = "Unsupported or unreadable file.";
+                    continue;
+                }
+
+                std::size_t bytes = 2 * static_cast<std::size_t>(info->width) * info->height * info->channels;
+                budget.acquire(bytes);
+
+                try {
+                    decoded.push({ index, bytes, image(inputs[index]) });
+                }
+                catch (const std::exception& exception) {
+                    results[index].error = exception.what();
+                    budget.release(bytes);
+                }
+            }
+        };
+
+        // Process stage, each image is parallelized over the shared thread pool.
+        auto process = [&]() {
+            while (std::optional<job> current = decoded.pop()) {
+                try {
+                    processor p(*current->im, execution::deferred);
+                    if (!options.output_directory.empty()) {
+                        p.set_output_directory(options.output_directory);
+                    }
+
+                    // Only the processor's copy is needed from here on.
+                    current->im.reset();
+
+                    operations(p);
+                    current->im = p.get();
+                }
+                catch (const std::exception& exception) {
+                    results[current->index].error = exception.what();
+                    budget.release(current->bytes);
+                    continue;
+                }
+
+                // Only the result is kept until it is encoded.
+                std::size_t bytes = static_cast<std::size_t>(current->im->get_width()) * current->im->get_height() * current->im->get_channels();
+                budget.resize(current->bytes, bytes);
+                current->bytes = bytes;
+
+                processed.push(std::move(*current));
+            }
+        };
+
+        // Encode stage.
+        auto encode = [&]() {
+            while (std::optional<job> current = processed.pop()) {
+                batch_result& result = results[current->index];
+                result.output = current->im->get_file().path;
+
+                // Failures (e.g. creating the output directory) only fail this image.
+                try {
+                    result.success = current->im->save();
+                }
+                catch (const std::exception& exception) {
+                    result.error = exception.what();
+                }
+
+                if (!result.success && result.error.empty()) {
+                    result.error = "Failed to save " + result.output + '.';
+                }
+
+                // Free the pixels before returning the memory to the budget.
+                current->im.reset();
+                budget.release(current->bytes);
+            }
+        };
+
+        std::vector<std::thread> decoders;
+        for (int i = 0; i < std::max(options.decode_threads, 1); ++i) {
+            decoders.emplace_back(decode);
+        }
+
+        std::thread processing(process);
+
+        std::vector<std::thread> encoders;
+        for (int i = 0; i < std::max(options.encode_threads, 1); ++i) {
+            encoders.emplace_back(encode);
+        }
+
+        // Stages are shut down front to back, every stage drains its queue first.
+        for (std::thread& decoder : decoders) {
+            decoder.join();
+        }
+        decoded.close();
+
+        processing.join();
+        processed.close();
+
+        for (std::thread& encoder : encoders) {
+            encoder.join();
+        }
+
+        return results;
+    }
+
+}
@@ -0,0 +1,195 @@
+
+#include "img/bitmap.h"
+#include "img/image.h"
+#include "img/png_encoder.h"
+#include "img/netpbm.h"
+#include "img/thread_pool.h"
+
+namespace img {
+
+    namespace {
+
+        // Every byte of a packed row expanded to 8 bytes of 0x00 or 0xff.
+        const std::array<std::uint64_t, 256>& get_expansion_table() {
+            static const std::array<std::uint64_t, 256> table = []() {
+                std::array<std::uint64_t, 256> entries { };
+
+                for (int value = 0; value < 256; ++value) {
+                    unsigned char bytes[8];
+
+                    for (int bit = 0; bit < 8; ++bit) {
+                        bytes[bit] = (value >> (7 - bit)) & 1 ? 0xff : 0x00;
+                    }
+
+                    std::memcpy(&entries[value], bytes, 8);
+                }
+
+                return entries;
+            }();
+
+            return table;
+        }
+
+    }
+
+    bitmap::bitmap(const std::string &filepath, int width, int height) : file(filepath),
+                                                                         width(width),
+                                                                         height(height),
+                                                                         stride((width + 7) / 8),
+                                                                         bits(static_cast<std::size_t>((width + 7) / 8) * height, 0)
+                                                                         {
+    }
+
+    bitmap::~bitmap() = default;
+
+    bool bitmap::get(int x, int y) const {
+        assert(x >= 0 && x < width && y >= 0 && y < height); // Validate bitmap offset.
+        return (bits[static_cast<std::size_t>(y) * stride + x / 8] >> (7 - x % 8)) & 1;
+    }
+
+    void bitmap::set(int x, int y, bool white) {
+        assert(x >= 0 && x < width && y >= 0 && y < height); // Validate bitmap offset.
+        unsigned char& byte = bits[static_cast<std::size_t>(y) * stride + x / 8];
+        unsigned char mask = 0x80 >> (x % 8);
+
+        byte = white ? byte | mask : byte & ~mask;
+    }
+
+    void bitmap::pack_row(int y, const unsigned char *pixels, int channels) {
+        unsigned char* row = bits.data() + static_cast<std::size_t>(y) * stride;
+
+        for (int byte = 0; byte < stride; ++byte) {
+            int count = std::min(8, width - byte * 8);
+            const unsigned char* input = pixels + static_cast<std::size_t>(byte) * 8 * channels;
+            unsigned char value = 0;
+
+            for (int bit = 0; bit < count; ++bit) {
+                value |= (input[bit * channels] >> 7) << (7 - bit);
+            }
+
+            row[byte] = value;
+        }
+    }
+
+    void bitmap::unpack_row(int y, unsigned char *pixels, int channels) const {
+        const unsigned char* row = bits.data() + static_cast<std::size_t>(y) * stride;
+        const std::array<std::uint64_t, 256>& table = get_expansion_table();
+
+        // Whole bytes of single channel pixels are expanded 8 pixels at a time.
+        int x = 0;
+        if (channels == 1) {
+            for (; x + 8 <= width; x += 8) {
+                std::memcpy(pixels + x, &table[row[x / 8]], 8);
+            }
+        }
+
+        for (; x < width; ++x) {
+            unsigned char value = (row[x / 8] >> (7 - x % 8)) & 1 ? 0xff : 0x00;
+            std::fill_n(pixels + static_cast<std::size_t>(x) * channels, channels, value);
+        }
+    }
+
+    image bitmap::to_image(int channels) const {
+        image im(file.path, width, height, channels);
+        unsigned char* data = im.get_data();
+
+        parallel_for_rows(height, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                unpack_row(y, data + static_cast<std::size_t>(y) * width * channels, channels);
+            }
+        });
+
+        return im;
+    }
+
+    std::vector<unsigned char> bitmap::encode(image_format format, const encode_options &options) const {
+        std::vector<unsigned char> encoded;
+
+        bool success = encode(format, [&encoded](const unsigned char* data, std::size_t size) {
+            encoded.insert(encoded.end(), data, data + size);
+        }, options);
+
+        if (!success) {
+            encoded.clear();
+        }
+
+        return encoded;
+    }
+
+    bool bitmap::encode(image_format format, const encode_writer &writer, const encode_options &options) const {
+        switch (format) {
+            case image_format::png: {
+                std::vector<unsigned char> png = encode_png_1bpp(bits.data(), width, height, options.png_compression);
+                if (png.empty()) {
+                    return false;
+                }
+
+                writer(png.data(), png.size());
+                return true;
+            }
+            case image_format::pnm:
+            case image_format::pbm:
+                encode_pbm(bits.data(), width, height, writer);
+                return true;
+            default:
+                std::cerr << "Invalid format passed to encode()." << std::endl;
+                return false;
+        }
+    }
+
+    bool bitmap::save(const encode_options &options) const {
+        return write(file, options);
+    }
+
+    bool bitmap::save(const std::string &filepath, const encode_options &options) const {
+        return write(file_data(filepath), options);
+    }
+
+    bool bitmap::write(const file_data &target, const encode_options &options) const {
+        if (target.format != image_format::png && target.format != image_format::pnm && target.format != image_format::pbm) {
+            std::cerr << "Invalid extension." << std::endl;
+            return false;
+        }
+
+        // Create directory for file if it doesn't exist.
+        if (!target.directory.empty() && !std::filesystem::exists(target.directory)) {
+            std::filesystem::create_directories(target.directory);
+        }
+
+        std::ofstream output(target.path, std::ios::binary);
+        if (!output) {
+            return false;
+        }
+
+        bool success = encode(target.format, [&output](const unsigned char* data, std::size_t size) {
+            output.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        }, options);
+
+        return success && static_cast<bool>(output);
+    }
+
+    const unsigned char* bitmap::get_data() const {
+        return bits.data();
+    }
+
+    unsigned char* bitmap::get_data() {
+        return bits.data();
+    }
+
+    int bitmap::get_width() const {
+        return width;
+    }
+
+    int bitmap::get_height() const {
+        return height;
+    }
+
+    int bitmap::get_stride() const {
+        return stride;
+    }
+
+    const file_data &bitmap::get_file() const {
+        return file;
+    }
+
+}
@@ -0,0 +1,527 @@
+
+#include "img/convolution.h"
+#include "img/thread_pool.h"
+#include "img/cpu.h"
+#include "img/hash.h"
+
+#ifdef IMG_X86
+    #include <immintrin.h>
+#endif
+
+namespace img {
+
+    namespace {
+
+        // Smallest number of output rows per tile. Tiles of large kernels are taller, so that the rows read above and
+        // below every tile stay a fraction of the work.
+        constexpr int tile_rows = 32;
+
+        // Maps index 'i' of a row or column of 'size' pixels into the image, -1 for pixels of a zero border.
+        int map_index(int i, int size, border_mode border) {
+            if (i >= 0 && i < size) {
+                return i;
+            }
+
+            switch (border) {
+                case border_mode::clamp:
+                    return std::clamp(i, 0, size - 1);
+
+                case border_mode::mirror: {
+                    if (size == 1) {
+                        return 0;
+                    }
+
+                    int period = 2 * (size - 1);
+                    i = std::abs(i) % period;
+                    return i < size ? i : period - i;
+                }
+
+                case border_mode::wrap:
+                    return ((i % size) + size) % size;
+
+                case border_mode::zero:
+                    return -1;
+            }
+
+            return -1;
+        }
+
+        // sum[i] += weight * input[i], the building block of both passes.
+        template <typename T>
+        void multiply_add_scalar(const T* input, T weight, T* sum, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                sum[i] += weight * input[i];
+            }
+        }
+
+#ifdef IMG_X86
+        IMG_TARGET_SSE4 void multiply_add_sse4(const float* input, float weight, float* sum, std::size_t count) {
+            __m128 w = _mm_set1_ps(weight);
+            std::size_t i = 0;
+
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(_mm_loadu_ps(input + i), w)));
+            }
+
+            for (; i < count; ++i) {
+                sum[i] += weight * input[i];
+            }
+        }
+
+        IMG_TARGET_SSE4 void multiply_add_sse4(const std::int32_t* input, std::int32_t weight, std::int32_t* sum, std::size_t count) {
+            __m128i w = _mm_set1_epi32(weight);
+            std::size_t i = 0;
+
+            for (; i + 4 <= count; i += 4) {
+                __m128i value = _mm_mullo_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i)), w);
+                __m128i total = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + i)), value);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + i), total);
+            }
+
+            for (; i < count; ++i) {
+                sum[i] += weight * input[i];
+            }
+        }
+
+        IMG_TARGET_AVX2 void multiply_add_avx2(const float* input, float weight, float* sum, std::size_t count) {
+            // Multiply and add separately, fused results would differ from the other instruction sets.
+            __m256 w = _mm256_set1_ps(weight);
+            std::size_t i = 0;
+
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_mul_ps(_mm256_loadu_ps(input + i), w)));
+            }
+
+            for (; i < count; ++i) {
+                sum[i] += weight * input[i];
+            }
+        }
+
+        IMG_TARGET_AVX2 void multiply_add_avx2(const std::int32_t* input, std::int32_t weight, std::int32_t* sum, std::size_t count) {
+            __m256i w = _mm256_set1_epi32(weight);
+            std::size_t i = 0;
+
+            for (; i + 8 <= count; i += 8) {
+                __m256i value = _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i)), w);
+                __m256i total = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + i)), value);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + i), total);
+            }
+
+            for (; i < count; ++i) {
+                sum[i] += weight * input[i];
+            }
+        }
+#endif
+
+        template <typename T>
+        using multiply_add_function = void (*)(const T*, T, T*, std::size_t);
+
+        template <typename T>
+        multiply_add_function<T> get_multiply_add() {
+            switch (get_instruction_set()) {
+#ifdef IMG_X86
+                case instruction_set::avx2:
+                    return multiply_add_avx2;
+                case instruction_set::sse4:
+                    return multiply_add_sse4;
+#endif
+                default:
+                    return multiply_add_scalar<T>;
+            }
+        }
+
+        // Widens row 'y' of the source into 'row', with 'radius' pixels of border on either side.
+        template <typename T>
+        void load_row(const unsigned char* source, int y, int width, int height, int channels, int radius, border_mode border, T* row) {
+            std::size_t padded_size = static_cast<std::size_t>(width + 2 * radius) * channels;
+
+            int source_y = map_index(y, height, border);
+            if (source_y < 0) {
+                std::fill(row, row + padded_size, T(0));
+                return;
+            }
+
+            const unsigned char* input = source + static_cast<std::size_t>(source_y) * width * channels;
+            T* interior = row + static_cast<std::size_t>(radius) * channels;
+
+            for (std::size_t i = 0; i < static_cast<std::size_t>(width) * channels; ++i) {
+                interior[i] = static_cast<T>(input[i]);
+            }
+
+            // Border pixels, left and right.
+            auto set_border = [&](int x) {
+                int source_x = map_index(x, width, border);
+                T* pixel = interior + static_cast<std::ptrdiff_t>(x) * channels;
+
+                for (int c = 0; c < channels; ++c) {
+                    pixel[c] = source_x < 0 ? T(0) : interior[static_cast<std::size_t>(source_x) * channels + c];
+                }
+            };
+
+            for (int x = -radius; x < 0; ++x) {
+                set_border(x);
+            }
+
+            for (int x = width; x < width + radius; ++x) {
+                set_border(x);
+            }
+        }
+
+        // Sums 2 * radius + 1 pixels around every pixel of a row, per channel.
+        void sum_row(const unsigned char* input, int width, int channels, int radius, border_mode border, std::uint32_t* output) {
+            auto get = [&](int x, int c) -> std::uint32_t {
+                int source_x = map_index(x, width, border);
+                return source_x < 0 ? 0 : input[static_cast<std::size_t>(source_x) * channels + c];
+            };
+
+            for (int c = 0; c < channels; ++c) {
+                std::uint32_t sum = 0;
+
+                for (int x = -radius; x <= radius; ++x) {
+                    sum += get(x, c);
+                }
+
+                for (int x = 0; x < width; ++x) {
+                    output[static_cast<std::size_t>(x) * channels + c] = sum;
+
+                    // Slide the window one pixel to the right.
+                    int entering = x + radius + 1;
+                    int leaving = x - radius;
+
+                    sum += entering < width ? input[static_cast<std::size_t>(entering) * channels + c] : get(entering, c);
+                    sum -= leaving >= 0 ? input[static_cast<std::size_t>(leaving) * channels + c] : get(leaving, c);
+                }
+            }
+        }
+
+        template <typename T>
+        std::int64_t get_absolute_sum(const T* weights, int count) {
+            std::int64_t total = 0;
+
+            for (int i = 0; i < count; ++i) {
+                total += std::abs(static_cast<std::int64_t>(weights[i]));
+            }
+
+            return total;
+        }
+
+    }
+
+    convolver::convolver(std::vector<float> horizontal, std::vector<float> vertical, border_mode border) : kernel_width(static_cast<int>(horizontal.size())),
+                                                                                                            kernel_height(static_cast<int>(vertical.size())),
+                                                                                                            separable(true),
+                                                                                                            border(border),
+                                                                                                            integer(false),
+                                                                                                            divisor(1),
+                                                                                                            integer_weights(),
+                                                                                                            float_weights(std::move(horizontal))
+                                                                                                            {
+        float_weights.insert(float_weights.end(), vertical.begin(), vertical.end());
+
+        // Invalid kernel dimensions.
+        if (kernel_width % 2 == 0 || kernel_height % 2 == 0) {
+            std::cerr << "Invalid kernel dimensions passed to convolver()." << std::endl;
+            kernel_width = 1;
+            kernel_height = 1;
+            float_weights = { 1.0f, 1.0f };
+        }
+    }
+
+    convolver::convolver(std::vector<int> horizontal, std::vector<int> vertical, int divisor, border_mode border) : kernel_width(static_cast<int>(horizontal.size())),
+                                                                                                                     kernel_height(static_cast<int>(vertical.size())),
+                                                                                                                     separable(true),
+                                                                                                                     border(border),
+                                                                                                                     integer(true),
+                                                                                                                     divisor(divisor),
+                                                                                                                     integer_weights(std::move(horizontal)),
+                                                                                                                     float_weights()
+                                                                                                                     {
+        integer_weights.insert(integer_weights.end(), vertical.begin(), vertical.end());
+
+        // Invalid kernel dimensions or divisor.
+        if (kernel_width % 2 == 0 || kernel_height % 2 == 0 || divisor <= 0) {
+            std::cerr << "Invalid kernel passed to convolver()." << std::endl;
+            kernel_width = 1;
+            kernel_height = 1;
+            this->divisor = 1;
+            integer_weights = { 1, 1 };
+            return;
+        }
+
+        // Sums that may not fit in 32 bits are computed in floating point instead.
+        std::int64_t bound = 255 * get_absolute_sum(integer_weights.data(), kernel_width) * get_absolute_sum(integer_weights.data() + kernel_width, kernel_height);
+
+        if (bound > std::numeric_limits<std::int32_t>::max()) {
+            integer = false;
+            float_weights.assign(integer_weights.begin(), integer_weights.end());
+
+            for (int i = 0; i < kernel_width; ++i) {
+                float_weights[i] /= static_cast<float>(divisor);
+            }
+        }
+    }
+
+    convolver::convolver(std::vector<float> weights, int width, int height, border_mode border) : kernel_width(width),
+                                                                                                   kernel_height(height),
+                                                                                                   separable(false),
+                                                                                                   border(border),
+                                                                                                   integer(false),
+                                                                                                   divisor(1),
+                                                                                                   integer_weights(),
+                                                                                                   float_weights(std::move(weights))
+                                                                                                   {
+        // Invalid kernel dimensions.
+        if (width <= 0 || height <= 0 || width % 2 == 0 || height % 2 == 0 || float_weights.size() != static_cast<std::size_t>(width) * height) {
+            std::cerr << "Invalid kernel dimensions passed to convolver()." << std::endl;
+            kernel_width = 1;
+            kernel_height = 1;
+            float_weights = { 1.0f };
+        }
+    }
+
+    convolver::convolver(std::vector<int> weights, int width, int height, int divisor, border_mode border) : kernel_width(width),
+                                                                                                              kernel_height(height),
+                                                                                                              separable(false),
+                                                                                                              border(border),
+                                                                                                              integer(true),
+                                                                                                              divisor(divisor),
+                                                                                                              integer_weights(std::move(weights)),
+                                                                                                              float_weights()
+                                                                                                              {
+        // Invalid kernel dimensions or divisor.
+        if (width <= 0 || height <= 0 || width % 2 == 0 || height % 2 == 0 || integer_weights.size() != static_cast<std::size_t>(width) * height || divisor <= 0) {
+            std::cerr << "Invalid kernel passed to convolver()." << std::endl;
+            kernel_width = 1;
+            kernel_height = 1;
+            this->divisor = 1;
+            integer_weights = { 1 };
+            return;
+        }
+
+        // Sums that may not fit in 32 bits are computed in floating point instead.
+        if (255 * get_absolute_sum(integer_weights.data(), width * height) > std::numeric_limits<std::int32_t>::max()) {
+            integer = false;
+            float_weights.reserve(integer_weights.size());
+
+            for (int weight : integer_weights) {
+                float_weights.emplace_back(static_cast<float>(weight) / static_cast<float>(divisor));
+            }
+        }
+    }
+
+    convolver::~convolver() = default;
+
+    void convolver::convolve(const unsigned char *source, unsigned char *destination, int width, int height, int channels) const {
+        std::size_t row_size = static_cast<std::size_t>(width) * channels;
+
+        if (integer) {
+            // Rounded half up, negative sums clamp to zero.
+            std::int32_t half = divisor / 2;
+
+            run(integer_weights, source, width, height, channels, [&](int y, const std::int32_t* sums) {
+                unsigned char* output = destination + static_cast<std::size_t>(y) * row_size;
+
+                for (std::size_t i = 0; i < row_size; ++i) {
+                    output[i] = static_cast<unsigned char>(sums[i] <= 0 ? 0 : std::min((sums[i] + half) / divisor, 255));
+                }
+            });
+        }
+        else {
+            run(float_weights, source, width, height, channels, [&](int y, const float* sums) {
+                unsigned char* output = destination + static_cast<std::size_t>(y) * row_size;
+
+                for (std::size_t i = 0; i < row_size; ++i) {
+                    output[i] = static_cast<unsigned char>(std::clamp(std::nearbyint(sums[i]), 0.0f, 255.0f));
+                }
+            });
+        }
+    }
+
+    void convolver::convolve(const unsigned char *source, float *destination, int width, int height, int channels) const {
+        std::size_t row_size = static_cast<std::size_t>(width) * channels;
+
+        convolve(source, width, height, channels, [&](int y, const float* results) {
+            std::copy(results, results + row_size, destination + static_cast<std::size_t>(y) * row_size);
+        });
+    }
+
+    void convolver::convolve(const unsigned char *source, int width, int height, int channels, const row_function &row) const {
+        std::size_t row_size = static_cast<std::size_t>(width) * channels;
+
+        if (integer) {
+            float scale = 1.0f / static_cast<float>(divisor);
+
+            run(integer_weights, source, width, height, channels, [&](int y, const std::int32_t* sums) {
+                thread_local std::vector<float> results;
+                results.resize(row_size);
+
+                for (std::size_t i = 0; i < row_size; ++i) {
+                    results[i] = static_cast<float>(sums[i]) * scale;
+                }
+
+                row(y, results.data());
+            });
+        }
+        else {
+            run(float_weights, source, width, height, channels, row);
+        }
+    }
+
+    bool convolver::is_integer() const {
+        return integer;
+    }
+
+    bool convolver::is_separable() const {
+        return separable;
+    }
+
+    std::string convolver::get_key() const {
+        std::uint64_t hash = integer ? xxhash64(integer_weights.data(), integer_weights.size() * sizeof(int)) : xxhash64(float_weights.data(), float_weights.size() * sizeof(float));
+        return std::to_string(kernel_width) + 'x' + std::to_string(kernel_height) + ',' + std::to_string(separable) + ',' + std::to_string(integer) + ',' + std::to_string(divisor) + ',' + std::to_string(static_cast<int>(border)) + ',' + to_hex(hash);
+    }
+
+    template <typename T, typename Store>
+    void convolver::run(const std::vector<T>& weights, const unsigned char* source, int width, int height, int channels, const Store& store) const {
+        int x_radius = kernel_width / 2;
+        int y_radius = kernel_height / 2;
+        int rows_per_tile = std::max(tile_rows, 4 * y_radius);
+
+        std::size_t row_size = static_cast<std::size_t>(width) * channels;
+        std::size_t padded_size = static_cast<std::size_t>(width + 2 * x_radius) * channels;
+
+        // Tiles hold the rows their output reads: horizontally filtered rows of separable kernels, padded source rows
+        // of general kernels.
+        std::size_t band_row_size = separable ? row_size : padded_size;
+        multiply_add_function<T> multiply_add = get_multiply_add<T>();
+
+        parallel_for_rows(height, [&](int first, int last) {
+            std::vector<T> padded(separable ? padded_size : 0);
+            std::vector<T> band(static_cast<std::size_t>(rows_per_tile + 2 * y_radius) * band_row_size);
+            std::vector<T> sums(row_size);
+
+            for (int tile = first; tile < last; tile += rows_per_tile) {
+                int tile_end = std::min(tile + rows_per_tile, last);
+
+                for (int j = tile - y_radius; j < tile_end + y_radius; ++j) {
+                    T* row = band.data() + static_cast<std::size_t>(j - tile + y_radius) * band_row_size;
+
+                    if (!separable) {
+                        load_row(source, j, width, height, channels, x_radius, border, row);
+                        continue;
+                    }
+
+                    // Horizontal pass.
+                    load_row(source, j, width, height, channels, x_radius, border, padded.data());
+                    std::fill(row, row + row_size, T(0));
+
+                    for (int t = 0; t < kernel_width; ++t) {
+                        if (weights[t] != T(0)) {
+                            multiply_add(padded.data() + static_cast<std::size_t>(t) * channels, weights[t], row, row_size);
+                        }
+                    }
+                }
+
+                for (int y = tile; y < tile_end; ++y) {
+                    // First row read by output row y.
+                    const T* rows = band.data() + static_cast<std::size_t>(y - tile) * band_row_size;
+                    std::fill(sums.begin(), sums.end(), T(0));
+
+                    if (separable) {
+                        // Vertical pass.
+                        const T* vertical = weights.data() + kernel_width;
+
+                        for (int t = 0; t < kernel_height; ++t) {
+                            if (vertical[t] != T(0)) {
+                                multiply_add(rows + static_cast<std::size_t>(t) * band_row_size, vertical[t], sums.data(), row_size);
+                            }
+                        }
+                    }
+                    else {
+                        for (int ky = 0; ky < kernel_height; ++ky) {
+                            for (int kx = 0; kx < kernel_width; ++kx) {
+                                T weight = weights[static_cast<std::size_t>(ky) * kernel_width + kx];
+
+                                if (weight != T(0)) {
+                                    multiply_add(rows + static_cast<std::size_t>(ky) * band_row_size + static_cast<std::size_t>(kx) * channels, weight, sums.data(), row_size);
+                                }
+                            }
+                        }
+                    }
+
+                    store(y, sums.data());
+                }
+            }
+        }, tile_rows);
+    }
+
+    void box_blur(const unsigned char *source, unsigned char *destination, int width, int height, int channels, int radius, border_mode border) {
+        std::size_t row_size = static_cast<std::size_t>(width) * channels;
+
+        if (radius <= 0) {
+            std::copy(source, source + row_size * height, destination);
+            return;
+        }
+
+        std::uint64_t area = static_cast<std::uint64_t>(2 * radius + 1) * (2 * radius + 1);
+
+        parallel_for_rows(height, [&](int first, int last) {
+            // Running totals of the row sums of the 2 * radius + 1 rows around the current row.
+            std::vector<std::uint64_t> columns(row_size, 0);
+            std::vector<std::uint32_t> row(row_size);
+
+            auto add_row = [&](int y, bool subtract) {
+                int source_y = map_index(y, height, border);
+                if (source_y < 0) {
+                    return;
+                }
+
+                sum_row(source + static_cast<std::size_t>(source_y) * row_size, width, channels, radius, border, row.data());
+
+                for (std::size_t i = 0; i < row_size; ++i) {
+                    columns[i] = subtract ? columns[i] - row[i] : columns[i] + row[i];
+                }
+            };
+
+            for (int y = first - radius; y <= first + radius; ++y) {
+                add_row(y, false);
+            }
+
+            for (int y = first; y < last; ++y) {
+                unsigned char* output = destination + static_cast<std::size_t>(y) * row_size;
+
+                for (std::size_t i = 0; i < row_size; ++i) {
+                    output[i] = static_cast<unsigned char>((columns[i] + area / 2) / area);
+                }
+
+                // Slide the window one row down.
+                if (y + 1 < last) {
+                    add_row(y + radius + 1, false);
+                    add_row(y - radius, true);
+                }
+            }
+        }, 64);
+    }
+
+    std::vector<float> get_gaussian_kernel(float sigma) {
+        if (sigma <= 0.0f) {
+            return { 1.0f };
+        }
+
+        int radius = std::max(1, static_cast<int>(std::ceil(3.0f * sigma)));
+        std::vector<float> weights(2 * radius + 1);
+        double total = 0.0;
+
+        for (int i = -radius; i <= radius; ++i) {
+            double weight = std::exp(-static_cast<double>(i * i) / (2.0 * sigma * sigma));
+            weights[i + radius] = static_cast<float>(weight);
+            total += weight;
+        }
+
+        for (float& weight : weights) {
+            weight = static_cast<float>(weight / total);
+        }
+
+        return weights;
+    }
+
+}
@@ -0,0 +1,66 @@
+
+#include "img/cpu.h"
+
+#if defined(IMG_X86) && defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+namespace img {
+
+    namespace {
+
+        instruction_set detect_instruction_set() {
+#if defined(IMG_X86) && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            int max_leaf = info[0];
+
+            __cpuid(info, 1);
+            bool sse4 = (info[2] & (1 << 19)) != 0;
+            bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+            bool avx2 = false;
+            if (max_leaf >= 7 && os_saves_avx) {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+
+            return avx2 ? instruction_set::avx2 : sse4 ? instruction_set::sse4 : instruction_set::scalar;
+#elif defined(IMG_X86) && (defined(__GNUC__) || defined(__clang__))
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx2")) {
+                return instruction_set::avx2;
+            }
+            if (__builtin_cpu_supports("sse4.1")) {
+                return instruction_set::sse4;
+            }
+
+            return instruction_set::scalar;
+#else
+            return instruction_set::scalar;
+#endif
+        }
+
+        instruction_set get_supported_instruction_set() {
+            static const instruction_set supported = detect_instruction_set();
+            return supported;
+        }
+
+        std::atomic<instruction_set>& get_active_instruction_set() {
+            static std::atomic<instruction_set> active(get_supported_instruction_set());
+            return active;
+        }
+
+    }
+
+    instruction_set get_instruction_set() {
+        return get_active_instruction_set().load(std::memory_order_relaxed);
+    }
+
+    void set_instruction_set(instruction_set set) {
+        set = std::min(set, get_supported_instruction_set());
+        get_active_instruction_set().store(set, std::memory_order_relaxed);
+    }
+
+}
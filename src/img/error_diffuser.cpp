@@ -0,0 +1,195 @@
+
+#include "img/error_diffuser.h"
+
+namespace img {
+
+    std::string to_string(diffusion_matrix matrix) {
+        switch (matrix) {
+            case diffusion_matrix::floyd_steinberg:
+                return "floyd_steinberg";
+            case diffusion_matrix::false_floyd_steinberg:
+                return "false_floyd_steinberg";
+            case diffusion_matrix::jarvis_judice_ninke:
+                return "jarvis_judice_ninke";
+            case diffusion_matrix::stucki:
+                return "stucki";
+            case diffusion_matrix::atkinson:
+                return "atkinson";
+            case diffusion_matrix::burkes:
+                return "burkes";
+            case diffusion_matrix::sierra:
+                return "sierra";
+            case diffusion_matrix::two_row_sierra:
+                return "two_row_sierra";
+            case diffusion_matrix::sierra_lite:
+                return "sierra_lite";
+            default:
+                return "error_diffusion";
+        }
+    }
+
+    namespace {
+
+        // Sets 'value' to black or white depending on which one it is closest to (alpha is ignored), and returns the
+        // difference between the two.
+        glm::vec4 skew_direction(glm::vec4& value) {
+            static const glm::vec4 zero = glm::vec4(0.0f);
+            static const glm::vec4 one = glm::vec4(255.0f);
+
+            float distance_to_zero = glm::length2(glm::vec3(zero) - glm::vec3(value));
+            float distance_to_one = glm::length2(glm::vec3(one) - glm::vec3(value));
+
+            glm::vec4 distance;
+
+            if (distance_to_zero < distance_to_one) {
+                distance = value - zero;
+                value = zero;
+            }
+            else {
+                distance = value - one;
+                value = one;
+            }
+
+            return distance;
+        }
+
+    }
+
+    error_diffuser::error_diffuser(diffusion_matrix matrix, int width, int height) : weights(),
+                                                                                     margin(),
+                                                                                     width(width),
+                                                                                     height(height),
+                                                                                     errors(),
+                                                                                     num_rows(0)
+                                                                                     {
+        switch (matrix) {
+            case diffusion_matrix::basic:
+                //   X   1
+                weights = { { 1, 0, 1.0f } };
+                margin = { 0, 0, 0 };
+                break;
+
+            case diffusion_matrix::floyd_steinberg:
+                //           X    7/16
+                //    3/16  5/16  1/16
+                weights = { { 1, 0, 7.0f / 16.0f },
+                            { -1, 1, 3.0f / 16.0f }, { 0, 1, 5.0f / 16.0f }, { 1, 1, 1.0f / 16.0f } };
+                margin = { 1, 1, 1 };
+                break;
+
+            case diffusion_matrix::false_floyd_steinberg:
+                //   X   3/8
+                //  3/8  2/8
+                weights = { { 1, 0, 3.0f / 8.0f },
+                            { 0, 1, 3.0f / 8.0f }, { 1, 1, 2.0f / 8.0f } };
+                margin = { 0, 1, 1 };
+                break;
+
+            case diffusion_matrix::jarvis_judice_ninke:
+                //               X    7/48  5/48
+                //  3/48  5/48  7/48  5/48  3/48
+                //  1/48  3/48  5/48  3/48  1/48
+                weights = { { 1, 0, 7.0f / 48.0f }, { 2, 0, 5.0f / 48.0f },
+                            { -2, 1, 3.0f / 48.0f }, { -1, 1, 5.0f / 48.0f }, { 0, 1, 7.0f / 48.0f }, { 1, 1, 5.0f / 48.0f }, { 2, 1, 3.0f / 48.0f },
+                            { -2, 2, 1.0f / 48.0f }, { -1, 2, 3.0f / 48.0f }, { 0, 2, 5.0f / 48.0f }, { 1, 2, 3.0f / 48.0f }, { 2, 2, 1.0f / 48.0f } };
+                margin = { 2, 2, 2 };
+                break;
+
+            case diffusion_matrix::stucki:
+                //               X    8/42  4/42
+                //  2/42  4/42  8/42  4/42  2/42
+                //  1/42  2/42  4/42  2/42  1/42
+                weights = { { 1, 0, 8.0f / 42.0f }, { 2, 0, 4.0f / 42.0f },
+                            { -2, 1, 2.0f / 42.0f }, { -1, 1, 4.0f / 42.0f }, { 0, 1, 8.0f / 42.0f }, { 1, 1, 4.0f / 42.0f }, { 2, 1, 2.0f / 42.0f },
+                            { -2, 2, 1.0f / 42.0f }, { -1, 2, 2.0f / 42.0f }, { 0, 2, 4.0f / 42.0f }, { 1, 2, 2.0f / 42.0f }, { 2, 2, 1.0f / 42.0f } };
+                margin = { 2, 2, 2 };
+                break;
+
+            case diffusion_matrix::atkinson:
+                //        X   1/8  1/8
+                //  1/8  1/8  1/8
+                //       1/8
+                weights = { { 1, 0, 1.0f / 8.0f }, { 2, 0, 1.0f / 8.0f },
+                            { -1, 1, 1.0f / 8.0f }, { 0, 1, 1.0f / 8.0f }, { 1, 1, 1.0f / 8.0f },
+                            { 0, 2, 1.0f / 8.0f } };
+                margin = { 2, 2, 2 };
+                break;
+
+            case diffusion_matrix::burkes:
+                //               X    8/32  4/32
+                //  2/32  4/32  8/32  4/32  2/32
+                weights = { { 1, 0, 8.0f / 32.0f }, { 2, 0, 4.0f / 32.0f },
+                            { -2, 1, 2.0f / 32.0f }, { -1, 1, 4.0f / 32.0f }, { 0, 1, 8.0f / 32.0f }, { 1, 1, 4.0f / 32.0f }, { 2, 1, 2.0f / 32.0f } };
+                margin = { 2, 2, 2 };
+                break;
+
+            case diffusion_matrix::sierra:
+                //               X    5/32  3/32
+                //  2/32  4/32  5/32  4/32  2/32
+                //        2/32  3/32  2/32
+                weights = { { 1, 0, 5.0f / 32.0f }, { 2, 0, 3.0f / 32.0f },
+                            { -2, 1, 2.0f / 32.0f }, { -1, 1, 4.0f / 32.0f }, { 0, 1, 5.0f / 32.0f }, { 1, 1, 4.0f / 32.0f }, { 2, 1, 2.0f / 32.0f },
+                            { -1, 2, 2.0f / 32.0f }, { 0, 2, 3.0f / 32.0f }, { 1, 2, 2.0f / 32.0f } };
+                margin = { 2, 2, 2 };
+                break;
+
+            case diffusion_matrix::two_row_sierra:
+                //               X    4/16  3/16
+                //  1/16  2/16  3/16  2/16  1/16
+                weights = { { 1, 0, 4.0f / 16.0f }, { 2, 0, 3.0f / 16.0f },
+                            { -2, 1, 1.0f / 16.0f }, { -1, 1, 2.0f / 16.0f }, { 0, 1, 3.0f / 16.0f }, { 1, 1, 2.0f / 16.0f }, { 2, 1, 1.0f / 16.0f } };
+                margin = { 2, 2, 2 };
+                break;
+
+            case diffusion_matrix::sierra_lite:
+                //         X   2/4
+                //  1/4   1/4
+                weights = { { 1, 0, 2.0f / 4.0f },
+                            { -1, 1, 1.0f / 4.0f }, { 0, 1, 1.0f / 4.0f } };
+                margin = { 2, 2, 2 };
+                break;
+        }
+
+        for (const weight& w : weights) {
+            num_rows = std::max(num_rows, w.y + 1);
+        }
+
+        errors.resize(static_cast<std::size_t>(num_rows) * (width + 2 * padding), glm::vec4(0.0f));
+    }
+
+    error_diffuser::~error_diffuser() = default;
+
+    void error_diffuser::dither_row(int y, unsigned char *pixels) {
+        int stride = width + 2 * padding;
+        glm::vec4* error = errors.data() + static_cast<std::size_t>(y % num_rows) * stride + padding;
+
+        for (int x = 0; x < width; ++x) {
+            unsigned char* pixel = pixels + x * 4;
+
+            // Ensure valid bounds.
+            if (y >= height - margin.bottom || x < margin.left || x >= width - margin.right) {
+                pixel[0] = pixel[1] = pixel[2] = 0x00;
+                pixel[3] = 0xff;
+                continue;
+            }
+
+            glm::vec4 value = glm::vec4(pixel[0], pixel[1], pixel[2], 255.0f); // Ignore alpha channel.
+            value += error[x];
+
+            glm::vec4 unscaled_error = skew_direction(value);
+
+            // Propagate error to neighboring cells based on error propagation matrix.
+            for (const weight& w : weights) {
+                glm::vec4* row = errors.data() + static_cast<std::size_t>((y + w.y) % num_rows) * stride + padding;
+                row[x + w.x] += w.value * unscaled_error;
+            }
+
+            pixel[0] = pixel[1] = pixel[2] = static_cast<unsigned char>(value.r);
+            pixel[3] = 0xff;
+        }
+
+        // This row of the ring buffer is reused for row y + num_rows.
+        std::fill(error - padding, error - padding + stride, glm::vec4(0.0f));
+    }
+
+}
@@ -5,9 +5,28 @@
 namespace img {
 
     file_data::file_data(const std::string &filepath) : path(convert_to_native_separators(filepath)),
-                                                        directory(get_directory(path)),
-                                                        name(get_asset_name(path)),
-                                                        extension(get_asset_extension(path)) {
+                                                        directory(),
+                                                        name(),
+                                                        extension(),
+                                                        format(image_format::unknown) {
+        // Split the path in a single pass, names are created for every processed image.
+        std::size_t separator = path.rfind(get_native_separator());
+        std::size_t start = separator == std::string::npos ? 0 : separator + 1;
+
+        // Dots in directory names don't start an extension.
+        std::size_t dot = path.rfind('.');
+        if (dot == std::string::npos || dot < start) {
+            dot = path.size();
+        }
+
+        directory.assign(path, 0, start); // Keep slash.
+        name.assign(path, start, dot - start);
+
+        if (dot < path.size()) {
+            extension.assign(path, dot + 1, std::string::npos);
+        }
+
+        format = format_from_extension(extension);
     }
 
     file_data::~file_data() = default;
@@ -0,0 +1,139 @@
+
+#include "img/hash.h"
+#include "img/thread_pool.h"
+
+namespace img {
+
+    namespace {
+
+        const std::uint64_t prime_1 = 0x9e3779b185ebca87ull;
+        const std::uint64_t prime_2 = 0xc2b2ae3d27d4eb4full;
+        const std::uint64_t prime_3 = 0x165667b19e3779f9ull;
+        const std::uint64_t prime_4 = 0x85ebca77c2b2ae63ull;
+        const std::uint64_t prime_5 = 0x27d4eb2f165667c5ull;
+
+        const std::size_t block_size = std::size_t(1) << 20;
+
+        std::uint64_t rotate_left(std::uint64_t value, int count) {
+            return (value << count) | (value >> (64 - count));
+        }
+
+        // Little-endian reads, regardless of alignment.
+        std::uint64_t read_64(const unsigned char* data) {
+            std::uint64_t value = 0;
+            for (int i = 7; i >= 0; --i) {
+                value = (value << 8) | data[i];
+            }
+
+            return value;
+        }
+
+        std::uint32_t read_32(const unsigned char* data) {
+            return std::uint32_t(data[0]) | (std::uint32_t(data[1]) << 8) | (std::uint32_t(data[2]) << 16) | (std::uint32_t(data[3]) << 24);
+        }
+
+        std::uint64_t lane_round(std::uint64_t accumulator, std::uint64_t input) {
+            accumulator += input * prime_2;
+            accumulator = rotate_left(accumulator, 31);
+            return accumulator * prime_1;
+        }
+
+        std::uint64_t merge_round(std::uint64_t accumulator, std::uint64_t value) {
+            accumulator ^= lane_round(0, value);
+            return accumulator * prime_1 + prime_4;
+        }
+
+    }
+
+    std::uint64_t xxhash64(const void *data, std::size_t size, std::uint64_t seed) {
+        const auto* input = static_cast<const unsigned char*>(data);
+        const unsigned char* end = input + size;
+        std::uint64_t hash;
+
+        if (size >= 32) {
+            // Four independent lanes of 8 bytes.
+            std::uint64_t v1 = seed + prime_1 + prime_2;
+            std::uint64_t v2 = seed + prime_2;
+            std::uint64_t v3 = seed;
+            std::uint64_t v4 = seed - prime_1;
+
+            const unsigned char* limit = end - 32;
+
+            do {
+                v1 = lane_round(v1, read_64(input));
+                v2 = lane_round(v2, read_64(input + 8));
+                v3 = lane_round(v3, read_64(input + 16));
+                v4 = lane_round(v4, read_64(input + 24));
+                input += 32;
+            } while (input <= limit);
+
+            hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+            hash = merge_round(hash, v1);
+            hash = merge_round(hash, v2);
+            hash = merge_round(hash, v3);
+            hash = merge_round(hash, v4);
+        }
+        else {
+            hash = seed + prime_5;
+        }
+
+        hash += static_cast<std::uint64_t>(size);
+
+        // Remaining bytes.
+        for (; input + 8 <= end; input += 8) {
+            hash ^= lane_round(0, read_64(input));
+            hash = rotate_left(hash, 27) * prime_1 + prime_4;
+        }
+
+        if (input + 4 <= end) {
+            hash ^= static_cast<std::uint64_t>(read_32(input)) * prime_1;
+            hash = rotate_left(hash, 23) * prime_2 + prime_3;
+            input += 4;
+        }
+
+        for (; input < end; ++input) {
+            hash ^= (*input) * prime_5;
+            hash = rotate_left(hash, 11) * prime_1;
+        }
+
+        // Avalanche.
+        hash ^= hash >> 33;
+        hash *= prime_2;
+        hash ^= hash >> 29;
+        hash *= prime_3;
+        hash ^= hash >> 32;
+
+        return hash;
+    }
+
+    std::uint64_t hash_blocks(const void *data, std::size_t size) {
+        const auto* input = static_cast<const unsigned char*>(data);
+
+        std::size_t num_blocks = std::max<std::size_t>(1, (size + block_size - 1) / block_size);
+        std::vector<std::uint64_t> hashes(num_blocks);
+
+        parallel_for_rows(static_cast<int>(num_blocks), [&](int first, int last) {
+            for (int block = first; block < last; ++block) {
+                std::size_t offset = static_cast<std::size_t>(block) * block_size;
+                std::size_t length = std::min(block_size, size - std::min(offset, size));
+
+                hashes[block] = xxhash64(input + offset, length, block);
+            }
+        }, 1);
+
+        return xxhash64(hashes.data(), hashes.size() * sizeof(std::uint64_t), size);
+    }
+
+    std::string to_hex(std::uint64_t hash) {
+        static const char digits[] = "0123456789abcdef";
+
+        std::string hex(16, '0');
+        for (int i = 15; i >= 0; --i) {
+            hex[i] = digits[hash & 0xf];
+            hash >>= 4;
+        }
+
+        return hex;
+    }
+
+}
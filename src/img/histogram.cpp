@@ -0,0 +1,164 @@
+
+#include "img/histogram.h"
+#include "img/image.h"
+#include "img/luma.h"
+#include "img/thread_pool.h"
+
+namespace img {
+
+    namespace {
+
+        // Counts 'count' values, 'stride' bytes apart. Consecutive values go to four separate tables, so that runs of
+        // equal values (flat areas) do not wait on increments of the same counter.
+        void count_values(const unsigned char* values, int count, int stride, std::array<histogram_counts, 4>& tables) {
+            int i = 0;
+
+            for (; i + 4 <= count; i += 4) {
+                ++tables[0][values[(i + 0) * stride]];
+                ++tables[1][values[(i + 1) * stride]];
+                ++tables[2][values[(i + 2) * stride]];
+                ++tables[3][values[(i + 3) * stride]];
+            }
+
+            for (; i < count; ++i) {
+                ++tables[0][values[i * stride]];
+            }
+        }
+
+        void merge(const std::array<histogram_counts, 4>& tables, histogram_counts& counts) {
+            for (std::size_t value = 0; value < counts.size(); ++value) {
+                counts[value] += tables[0][value] + tables[1][value] + tables[2][value] + tables[3][value];
+            }
+        }
+
+    }
+
+    histogram::histogram(const image &im) : channels(im.get_channels()),
+                                            total(static_cast<std::uint64_t>(im.get_width()) * im.get_height()),
+                                            counts(im.get_channels(), histogram_counts { }),
+                                            luma()
+                                            {
+        int width = im.get_width();
+        const unsigned char* data = im.get_data();
+
+        // Gray images are their own luma.
+        bool color = channels >= 3;
+        std::mutex lock;
+
+        parallel_for_rows(im.get_height(), [&](int first, int last) {
+            // Partial tables of every channel, followed by luma.
+            std::vector<std::array<histogram_counts, 4>> partial(channels + 1);
+            std::vector<unsigned char> row_luma(color ? width : 0);
+
+            for (int y = first; y < last; ++y) {
+                const unsigned char* row = data + static_cast<std::size_t>(y) * width * channels;
+
+                for (int c = 0; c < channels; ++c) {
+                    count_values(row + c, width, channels, partial[c]);
+                }
+
+                if (color) {
+                    convert_to_luma(row, channels, row_luma.data(), width);
+                    count_values(row_luma.data(), width, 1, partial[channels]);
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+
+            for (int c = 0; c < channels; ++c) {
+                merge(partial[c], counts[c]);
+            }
+
+            if (color) {
+                merge(partial[channels], luma);
+            }
+        });
+
+        if (!color) {
+            luma = counts[0];
+        }
+    }
+
+    histogram::~histogram() = default;
+
+    const histogram_counts &histogram::get_channel(int channel) const {
+        assert(channel >= 0 && channel < channels); // Validate channel.
+        return counts[channel];
+    }
+
+    const histogram_counts &histogram::get_luma() const {
+        return luma;
+    }
+
+    int histogram::get_channels() const {
+        return channels;
+    }
+
+    std::uint64_t histogram::get_total() const {
+        return total;
+    }
+
+    int get_percentile(const histogram_counts &counts, double fraction) {
+        std::uint64_t total = std::accumulate(counts.begin(), counts.end(), std::uint64_t(0));
+        if (total == 0) {
+            return 0;
+        }
+
+        // At least one count, so that a fraction of 0 gives the lowest value present.
+        auto target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(total))));
+        std::uint64_t cumulative = 0;
+
+        for (int value = 0; value < 256; ++value) {
+            cumulative += counts[value];
+
+            if (cumulative >= target) {
+                return value;
+            }
+        }
+
+        return 255;
+    }
+
+    std::array<unsigned char, 256> get_equalization_table(const histogram_counts &counts) {
+        std::array<unsigned char, 256> table { };
+
+        std::uint64_t total = std::accumulate(counts.begin(), counts.end(), std::uint64_t(0));
+        int lowest = get_percentile(counts, 0.0);
+        std::uint64_t range = total - counts[lowest];
+
+        // A single value, nothing to spread.
+        if (range == 0) {
+            std::iota(table.begin(), table.end(), 0);
+            return table;
+        }
+
+        std::uint64_t cumulative = 0;
+
+        for (int value = 0; value < 256; ++value) {
+            cumulative += counts[value];
+
+            double position = static_cast<double>(cumulative - std::min(cumulative, counts[lowest])) / static_cast<double>(range);
+            table[value] = static_cast<unsigned char>(std::lround(position * 255.0));
+        }
+
+        return table;
+    }
+
+    std::array<unsigned char, 256> get_levels_table(int low, int high) {
+        std::array<unsigned char, 256> table { };
+
+        // Nothing to stretch.
+        if (high <= low) {
+            std::iota(table.begin(), table.end(), 0);
+            return table;
+        }
+
+        for (int value = 0; value < 256; ++value) {
+            double position = static_cast<double>(value - low) / static_cast<double>(high - low);
+            table[value] = static_cast<unsigned char>(std::clamp(std::lround(position * 255.0), 0L, 255L));
+        }
+
+        return table;
+    }
+
+}
@@ -2,8 +2,11 @@
 #include "img/image.h"
 #include "img/utility.h"
 #include "img/processor.h"
-
-#define FULL_QUALITY 100
+#include "img/luma.h"
+#include "img/png_encoder.h"
+#include "img/qoi.h"
+#include "img/netpbm.h"
+#include "img/trace.h"
 
 namespace img {
 
@@ -13,23 +16,45 @@ namespace img {
                                                 channels(-1),
                                                 total(-1),
                                                 data(nullptr),
-                                                stb_allocated(true) {
+                                                stb_allocated(true),
+                                                derived(std::make_shared<derived_data>()) {
 //        stbi_set_flip_vertically_on_load(true);
 
-        // Load in texture data.
-        data = stbi_load(file.path.c_str(), &width, &height, &channels, 0);
-        if (!data) {
-            throw std::runtime_error("Failed to open file: " + file.path);
+        // Load in texture data. Formats decoded without stb_image are read straight from a mapping of the file.
+        if (file.format == image_format::qoi || file.format == image_format::pnm || file.format == image_format::pbm || file.format == image_format::pam) {
+            memory_mapped_file mapping(file.path);
+            decode(mapping.get_data(), mapping.get_size(), "Failed to open file: " + file.path);
         }
+        else {
+            IMG_TRACE_SCOPE("image::decode");
+            load(stbi_load(file.path.c_str(), &width, &height, &channels, 0), "Failed to open file: " + file.path);
+        }
+    }
 
-        // Print image information.
-        std::cout << "Asset: " << file.name + '.' + file.extension << std::endl;
-        std::cout << "Width: " << width << std::endl;
-        std::cout << "Height: " << height << std::endl;
-        std::cout << "Channels: " << channels << ' ';
-        std::cout << (channels >= 4 ? "[RGBA]" : "[RGB]") << std::endl;
+    image::image(const std::string &filename, const unsigned char *buffer, std::size_t size) : file(filename),
+                                                                                             width(-1),
+                                                                                             height(-1),
+                                                                                             channels(-1),
+                                                                                             total(-1),
+                                                                                             data(nullptr),
+                                                                                             stb_allocated(true),
+                                                                                             derived(std::make_shared<derived_data>()) {
+        decode(buffer, size, "Failed to decode buffer: " + file.path);
+    }
 
-        total = width * height * channels;
+    image::image(const memory_mapped_file &mapping) : image(mapping.get_path(), mapping.get_data(), mapping.get_size()) {
+    }
+
+    image::image(const std::string &filename, const stbi_io_callbacks &callbacks, void *user) : file(filename),
+                                                                                              width(-1),
+                                                                                              height(-1),
+                                                                                              channels(-1),
+                                                                                              total(-1),
+                                                                                              data(nullptr),
+                                                                                              stb_allocated(true),
+                                                                                              derived(std::make_shared<derived_data>()) {
+        IMG_TRACE_SCOPE("image::decode");
+        load(stbi_load_from_callbacks(&callbacks, user, &width, &height, &channels, 0), "Failed to decode stream: " + file.path);
     }
 
     image::image(const std::string &filepath, int width, int height, int channels) : file(filepath),
@@ -38,8 +63,10 @@ namespace img {
                                                                                      channels(channels),
                                                                                      total(width * height * channels),
                                                                                      data(nullptr),
-                                                                                     stb_allocated(false) {
+                                                                                     stb_allocated(false),
+                                                                                     derived(std::make_shared<derived_data>()) {
         data = new unsigned char[width * height * channels];
+        IMG_TRACE_COUNTER("bytes_allocated", total);
     }
 
     image::~image() {
@@ -52,11 +79,13 @@ namespace img {
                                        total(other.total),
                                        channels(other.channels),
                                        data(nullptr),
-                                       stb_allocated(false) // Deep copy happened, don't free with stb.
+                                       stb_allocated(false), // Deep copy happened, don't free with stb.
+                                       derived(other.derived) // Same pixels, derived data can be shared.
                                        {
         // Deep copy data.
         data = new unsigned char[width * height * channels];
         memcpy(data, other.data, width * height * channels);
+        IMG_TRACE_COUNTER("bytes_allocated", total);
     }
 
     image& image::operator=(const image& other) {
@@ -64,16 +93,57 @@ namespace img {
             return *this;
         }
 
+        // Release previous data.
+        stb_allocated ? stbi_image_free(data) : delete[] data;
+
         file = other.file;
         width = other.width;
         height = other.height;
         channels = other.channels;
         total = other.total;
         stb_allocated = false; // Deep copy happened, don't free with stb.
+        derived = other.derived;
 
         // Deep copy data.
         data = new unsigned char[width * height * channels];
         memcpy(data, other.data, width * height * channels);
+        IMG_TRACE_COUNTER("bytes_allocated", total);
+
+        return *this;
+    }
+
+    image::image(image&& other) noexcept : file(std::move(other.file)),
+                                           width(other.width),
+                                           height(other.height),
+                                           channels(other.channels),
+                                           total(other.total),
+                                           data(other.data),
+                                           stb_allocated(other.stb_allocated),
+                                           derived(std::move(other.derived))
+                                           {
+        other.data = nullptr;
+        other.stb_allocated = false;
+    }
+
+    image& image::operator=(image&& other) noexcept {
+        if (&other == this) {
+            return *this;
+        }
+
+        // Release previous data.
+        stb_allocated ? stbi_image_free(data) : delete[] data;
+
+        file = std::move(other.file);
+        width = other.width;
+        height = other.height;
+        channels = other.channels;
+        total = other.total;
+        data = other.data;
+        stb_allocated = other.stb_allocated;
+        derived = std::move(other.derived);
+
+        other.data = nullptr;
+        other.stb_allocated = false;
 
         return *this;
     }
@@ -83,14 +153,32 @@ namespace img {
         assert(offset < total); // Validate image offset.
         unsigned char *address = data + offset;
 
+        if (channels < 3) {
+            // Grayscale, with optional alpha.
+            return {address[0], address[0], address[0], channels == 2 ? address[1] : static_cast<unsigned char>(0xff)};
+        }
+
         return {address[0], address[1], address[2], channels >= 4 ? address[3] : static_cast<unsigned char>(0xff)};
     }
 
     void image::set_pixel(int x, int y, const pixel &value) {
+        detach();
+
         int offset = (x + width * y) * channels;
         assert(offset < total); // Validate image offset.
         unsigned char *address = data + offset;
 
+        if (channels < 3) {
+            // Grayscale, with optional alpha.
+            address[0] = get_luma(value.r, value.g, value.b);
+
+            if (channels == 2) {
+                address[1] = value.a;
+            }
+
+            return;
+        }
+
         address[0] = value.r;
         address[1] = value.g;
         address[2] = value.b;
@@ -102,43 +190,277 @@ namespace img {
     }
 
     void image::set_pixel(int x, int y, const glm::vec4 &value) {
-        int offset = (x + width * y) * channels;
-        assert(offset < total); // Validate image offset.
-        unsigned char *address = data + offset;
+        set_pixel(x, y, pixel(value));
+    }
 
-        address[0] = static_cast<unsigned char>(value.r);
-        address[1] = static_cast<unsigned char>(value.g);
-        address[2] = static_cast<unsigned char>(value.b);
+    glm::vec4 image::mean(int x, int y, int w, int h) const {
+        return get_summed_area_table()->mean(x, y, w, h);
+    }
 
-        // Only set alpha if there is an alpha channel.
-        if (channels >= 4) {
-            address[3] = static_cast<unsigned char>(value.a);
+    std::shared_ptr<const summed_area_table> image::get_summed_area_table() const {
+        std::lock_guard<std::mutex> guard(derived->lock);
+
+        if (!derived->table) {
+            derived->table = std::make_shared<summed_area_table>(*this);
+            derived->populated = true;
         }
+
+        return derived->table;
     }
 
-    void image::save() const {
-        const std::string &ext = file.extension;
+    std::shared_ptr<const image> image::get_pyramid_level(int level) const {
+        assert(level >= 0 && level < get_pyramid_level_count()); // Validate pyramid level.
 
-        // Create directory for file if it doesn't exist.
-        bool directory_exists = std::filesystem::exists(file.directory);
-        if (!directory_exists || (directory_exists && std::filesystem::is_directory(file.directory))) {
-            std::filesystem::create_directory(file.directory);
+        if (level == 0) {
+            return std::shared_ptr<const image>(std::shared_ptr<const image>(), this);
+        }
+
+        std::lock_guard<std::mutex> guard(derived->lock);
+        std::vector<std::shared_ptr<const image>>& levels = derived->levels;
+
+        // Build missing levels from the deepest existing one.
+        while (static_cast<int>(levels.size()) < level) {
+            const image& previous = levels.empty() ? *this : *levels.back();
+            levels.emplace_back(std::make_shared<image>(previous.downsample()));
+            derived->populated = true;
+        }
+
+        return levels[level - 1];
+    }
+
+    std::shared_ptr<const histogram> image::get_histogram() const {
+        std::lock_guard<std::mutex> guard(derived->lock);
+
+        if (!derived->histograms) {
+            derived->histograms = std::make_shared<histogram>(*this);
+            derived->populated = true;
         }
 
-        if (ext == "jpg" || ext == "JPG" || ext == "jpeg" || ext == "JPEG") {
-            stbi_write_jpg(file.path.c_str(), width, height, channels, data, FULL_QUALITY);
+        return derived->histograms;
+    }
+
+    int image::get_pyramid_level_count() const {
+        int count = 1;
+
+        for (int size = std::max(width, height); size > 1; size = (size + 1) / 2) {
+            ++count;
         }
-        else if (ext == "png" || ext == "PNG") {
-            int stride = width * channels;
-            stbi_write_png(file.path.c_str(), width, height, channels, data, stride);
+
+        return count;
+    }
+
+    image image::downsample() const {
+        int half_width = (width + 1) / 2;
+        int half_height = (height + 1) / 2;
+
+        image half(file.path, half_width, half_height, channels);
+
+        for (int y = 0; y < half_height; ++y) {
+            // Rows and columns past the edge of an odd-sized image are not sampled.
+            int y0 = 2 * y;
+            int y1 = std::min(y0 + 1, height - 1);
+
+            const unsigned char* top = data + static_cast<std::size_t>(y0) * width * channels;
+            const unsigned char* bottom = data + static_cast<std::size_t>(y1) * width * channels;
+            unsigned char* output = half.data + static_cast<std::size_t>(y) * half_width * channels;
+
+            for (int x = 0; x < half_width; ++x) {
+                int x0 = 2 * x;
+                int x1 = std::min(x0 + 1, width - 1);
+
+                for (int c = 0; c < channels; ++c) {
+                    int sum = top[x0 * channels + c] + top[x1 * channels + c] + bottom[x0 * channels + c] + bottom[x1 * channels + c];
+                    output[x * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
         }
-        else {
+
+        return half;
+    }
+
+    void image::decode(const unsigned char *buffer, std::size_t size, const std::string &source) {
+        IMG_TRACE_SCOPE("image::decode");
+
+        image_format format = detect_format(buffer, size);
+
+        if (format == image_format::qoi || format == image_format::pnm || format == image_format::pbm || format == image_format::pam) {
+            // Not stb_image allocated, unsupported PGM and PPM variants (ASCII, 16-bit) are left to stb_image.
+            if (unsigned char* pixels = format == image_format::qoi ? decode_qoi(buffer, size, &width, &height, &channels) : decode_netpbm(buffer, size, &width, &height, &channels)) {
+                stb_allocated = false;
+                load(pixels, source);
+                return;
+            }
+
+            if (format != image_format::pnm) {
+                throw std::runtime_error(source);
+            }
+        }
+
+        if (size > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+            throw std::runtime_error(source + " (too large)");
+        }
+
+        load(stbi_load_from_memory(buffer, static_cast<int>(size), &width, &height, &channels, 0), source);
+    }
+
+    void image::load(unsigned char *pixels, const std::string &source) {
+        data = pixels;
+        if (!data) {
+            throw std::runtime_error(source);
+        }
+
+        total = width * height * channels;
+        IMG_TRACE_COUNTER("bytes_allocated", total);
+
+        if (!get_logging()) {
+            return;
+        }
+
+        // Print image information, as a single write.
+        std::stringstream info;
+        info << "Asset: " << file.name + '.' + file.extension << '\n';
+        info << "Width: " << width << '\n';
+        info << "Height: " << height << '\n';
+        info << "Channels: " << channels << ' ';
+        info << (channels >= 4 ? "[RGBA]" : channels == 3 ? "[RGB]" : channels == 2 ? "[Gray, Alpha]" : "[Gray]") << '\n';
+
+        std::cout << info.str() << std::flush;
+    }
+
+    const unsigned char* image::get_data() const {
+        return data;
+    }
+
+    unsigned char* image::get_data() {
+        detach();
+        return data;
+    }
+
+    void image::detach() {
+        // Derived data is either shared with another image or no longer matches the pixels once they are modified.
+        if (derived.use_count() > 1 || derived->populated.load(std::memory_order_relaxed)) {
+            derived = std::make_shared<derived_data>();
+        }
+    }
+
+    std::vector<unsigned char> image::encode_png(const encode_options &options) const {
+        return encode(image_format::png, options);
+    }
+
+    std::vector<unsigned char> image::encode_jpg(const encode_options &options) const {
+        return encode(image_format::jpg, options);
+    }
+
+    std::vector<unsigned char> image::encode(image_format format, const encode_options &options) const {
+        std::vector<unsigned char> encoded;
+
+        bool success = encode(format, [&encoded](const unsigned char* data, std::size_t size) {
+            encoded.insert(encoded.end(), data, data + size);
+        }, options);
+
+        if (!success) {
+            encoded.clear();
+        }
+
+        return encoded;
+    }
+
+    bool image::encode(image_format format, const encode_writer &writer, const encode_options &options) const {
+        IMG_TRACE_SCOPE("image::encode");
+
+        // Forwards stb_image_write output to the writer.
+        auto forward = [](void* context, void* data, int size) {
+            (*static_cast<const encode_writer*>(context))(static_cast<const unsigned char*>(data), static_cast<std::size_t>(size));
+        };
+
+        void* context = const_cast<encode_writer*>(&writer);
+
+        switch (format) {
+            case image_format::png: {
+                std::vector<unsigned char> png = img::encode_png(data, width, height, channels, options.png_compression);
+                if (png.empty()) {
+                    return false;
+                }
+
+                writer(png.data(), png.size());
+                return true;
+            }
+            case image_format::jpg:
+                return stbi_write_jpg_to_func(forward, context, width, height, channels, data, std::clamp(options.jpg_quality, 1, 100)) != 0;
+            case image_format::bmp:
+                return stbi_write_bmp_to_func(forward, context, width, height, channels, data) != 0;
+            case image_format::tga:
+                return stbi_write_tga_to_func(forward, context, width, height, channels, data) != 0;
+            case image_format::qoi: {
+                std::vector<unsigned char> qoi = encode_qoi(data, width, height, channels);
+                if (qoi.empty()) {
+                    return false;
+                }
+
+                writer(qoi.data(), qoi.size());
+                return true;
+            }
+            case image_format::pnm:
+            case image_format::pam:
+                encode_netpbm(data, width, height, channels, format == image_format::pam, writer);
+                return true;
+            case image_format::pbm: {
+                // Pixels are white when their first channel is at least 128, like processor::to_bitmap().
+                bitmap bits(file.path, width, height);
+
+                for (int y = 0; y < height; ++y) {
+                    bits.pack_row(y, data + static_cast<std::size_t>(y) * width * channels, channels);
+                }
+
+                return bits.encode(format, writer, options);
+            }
+            default:
+                std::cerr << "Invalid format passed to encode()." << std::endl;
+                return false;
+        }
+    }
+
+    bool image::save(const encode_options& options) const {
+        return write(file, options);
+    }
+
+    bool image::save(const std::string &filepath, const encode_options &options) const {
+        return write(file_data(filepath), options);
+    }
+
+    bool image::write(const file_data &target, const encode_options &options) const {
+        image_format format = target.format;
+        if (format != image_format::png && format != image_format::jpg && format != image_format::bmp && format != image_format::tga && format != image_format::qoi && format != image_format::pnm && format != image_format::pbm && format != image_format::pam) {
             std::cerr << "Invalid extension." << std::endl;
+            return false;
+        }
+
+        // Create directory for file if it doesn't exist.
+        if (!target.directory.empty() && !std::filesystem::exists(target.directory)) {
+            std::filesystem::create_directories(target.directory);
         }
+
+        std::ofstream output(target.path, std::ios::binary);
+        if (!output) {
+            return false;
+        }
+
+        bool success = encode(format, [&output](const unsigned char* data, std::size_t size) {
+            output.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        }, options);
+
+        return success && static_cast<bool>(output);
     }
 
-    processor image::process() const {
-        return img::processor(*this);
+    std::future<bool> image::save_async(const encode_options& options) const {
+        // The copy keeps the pixels alive (and unchanged) until they are written.
+        return std::async(std::launch::async, [copy = *this, options]() {
+            return copy.save(options);
+        });
+    }
+
+    processor image::process(execution mode) const {
+        return img::processor(*this, mode);
     }
 
     int image::get_height() const {
@@ -153,4 +475,8 @@ namespace img {
         return channels;
     }
 
+    const file_data &image::get_file() const {
+        return file;
+    }
+
 }
\ No newline at end of file
@@ -0,0 +1,243 @@
+
+#include "img/luma.h"
+#include "img/cpu.h"
+
+#ifdef IMG_X86
+    #include <immintrin.h>
+#endif
+
+namespace img {
+
+    namespace {
+
+        // Fixed-point weights, summing to 256.
+        struct fixed_weights {
+            int r;
+            int g;
+            int b;
+        };
+
+        fixed_weights get_fixed_weights(luma_weights weights) {
+            switch (weights) {
+                case luma_weights::bt601:
+                    return { 77, 150, 29 };
+                case luma_weights::bt709:
+                    return { 54, 183, 19 };
+            }
+
+            return { 77, 150, 29 };
+        }
+
+        void convert_to_luma_scalar(const unsigned char* source, int channels, unsigned char* destination, std::size_t count, const fixed_weights& w) {
+            if (channels < 3) {
+                // Already gray.
+                for (std::size_t i = 0; i < count; ++i) {
+                    destination[i] = source[i * channels];
+                }
+                return;
+            }
+
+            for (std::size_t i = 0; i < count; ++i) {
+                const unsigned char* pixel = source + i * channels;
+                destination[i] = static_cast<unsigned char>((pixel[0] * w.r + pixel[1] * w.g + pixel[2] * w.b + 128) >> 8);
+            }
+        }
+
+#ifdef IMG_X86
+        // Converts 16 pixels to luma, four pixels per register expanded to RGBA with the alpha byte zeroed.
+        IMG_TARGET_SSE4 inline void convert_16_sse4(const __m128i (&pixels)[4], unsigned char* destination, __m128i weights) {
+            __m128i rounding = _mm_set1_epi32(128);
+            __m128i zero = _mm_setzero_si128();
+            __m128i luma[4];
+
+            for (int i = 0; i < 4; ++i) {
+                // Widen to 16 bits, multiply-add to (r * wr + g * wg, b * wb) pairs and add the pairs together.
+                __m128i low = _mm_madd_epi16(_mm_cvtepu8_epi16(pixels[i]), weights);
+                __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(pixels[i], zero), weights);
+                __m128i sum = _mm_hadd_epi32(low, high);
+
+                luma[i] = _mm_srli_epi32(_mm_add_epi32(sum, rounding), 8);
+            }
+
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(luma[0], luma[1]), _mm_packs_epi32(luma[2], luma[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), packed);
+        }
+
+        IMG_TARGET_SSE4 void convert_to_luma_sse4(const unsigned char* source, int channels, unsigned char* destination, std::size_t count, const fixed_weights& w) {
+            __m128i weights = _mm_setr_epi16(w.r, w.g, w.b, 0, w.r, w.g, w.b, 0);
+            __m128i pixels[4];
+            std::size_t i = 0;
+
+            if (channels == 4) {
+                __m128i clear_alpha = _mm_set1_epi32(0x00ffffff);
+
+                for (; i + 16 <= count; i += 16) {
+                    for (int group = 0; group < 4; ++group) {
+                        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + (i + group * 4) * 4));
+                        pixels[group] = _mm_and_si128(value, clear_alpha);
+                    }
+
+                    convert_16_sse4(pixels, destination + i, weights);
+                }
+            }
+            else if (channels == 3) {
+                // Expand 4 RGB pixels (12 bytes) to RGB0.
+                __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+                // Each load reads 16 bytes, 4 bytes past the pixels being converted.
+                for (; i + 16 + 2 <= count; i += 16) {
+                    for (int group = 0; group < 4; ++group) {
+                        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + (i + group * 4) * 3));
+                        pixels[group] = _mm_shuffle_epi8(value, expand);
+                    }
+
+                    convert_16_sse4(pixels, destination + i, weights);
+                }
+            }
+
+            // Remaining pixels.
+            convert_to_luma_scalar(source + i * channels, channels, destination + i, count - i, w);
+        }
+
+        // Converts 8 pixels, loaded as four pixels per 128-bit lane and expanded to RGBA with the alpha byte zeroed.
+        IMG_TARGET_AVX2 inline void convert_8_avx2(__m256i pixels, unsigned char* destination, __m256i weights) {
+            __m256i rounding = _mm256_set1_epi32(128);
+            __m256i zero = _mm256_setzero_si256();
+
+            // Unpacking stays within lanes, so pixels come out of the horizontal add in order.
+            __m256i low = _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero), weights);
+            __m256i high = _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero), weights);
+            __m256i luma = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(low, high), rounding), 8);
+
+            __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(luma, luma), zero);
+            int first = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+            int second = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+
+            memcpy(destination + 0, &first, sizeof(int));
+            memcpy(destination + 4, &second, sizeof(int));
+        }
+
+        IMG_TARGET_AVX2 void convert_to_luma_avx2(const unsigned char* source, int channels, unsigned char* destination, std::size_t count, const fixed_weights& w) {
+            __m256i weights = _mm256_setr_epi16(w.r, w.g, w.b, 0, w.r, w.g, w.b, 0, w.r, w.g, w.b, 0, w.r, w.g, w.b, 0);
+            std::size_t i = 0;
+
+            if (channels == 4) {
+                __m256i clear_alpha = _mm256_set1_epi32(0x00ffffff);
+
+                for (; i + 8 <= count; i += 8) {
+                    __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+                    convert_8_avx2(_mm256_and_si256(pixels, clear_alpha), destination + i, weights);
+                }
+            }
+            else if (channels == 3) {
+                // Expand 4 RGB pixels (12 bytes) per lane to RGB0.
+                __m256i expand = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                  0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+                // The second load reads 4 bytes past the pixels being converted.
+                for (; i + 8 + 2 <= count; i += 8) {
+                    const unsigned char* pixels = source + i * 3;
+                    __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+                    __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 12));
+
+                    __m256i combined = _mm256_inserti128_si256(_mm256_castsi128_si256(first), second, 1);
+                    convert_8_avx2(_mm256_shuffle_epi8(combined, expand), destination + i, weights);
+                }
+            }
+
+            // Remaining pixels.
+            convert_to_luma_scalar(source + i * channels, channels, destination + i, count - i, w);
+        }
+#endif
+
+        // sRGB transfer functions.
+        float decode_srgb(float value) {
+            return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        float encode_srgb(float value) {
+            return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        }
+
+        // Encoded 8-bit value to 16-bit linear value.
+        const std::vector<std::uint16_t>& get_decoding_table() {
+            static const std::vector<std::uint16_t> table = [] {
+                std::vector<std::uint16_t> values(256);
+                for (int i = 0; i < 256; ++i) {
+                    values[i] = static_cast<std::uint16_t>(std::lround(decode_srgb(static_cast<float>(i) / 255.0f) * 65535.0f));
+                }
+                return values;
+            }();
+
+            return table;
+        }
+
+        // 12-bit linear value (top bits of the 16-bit value) to encoded 8-bit value.
+        const std::vector<unsigned char>& get_encoding_table() {
+            static const std::vector<unsigned char> table = [] {
+                std::vector<unsigned char> values(4096);
+                for (int i = 0; i < 4096; ++i) {
+                    float linear = (static_cast<float>(i) + 0.5f) / 4096.0f;
+                    values[i] = static_cast<unsigned char>(std::lround(encode_srgb(linear) * 255.0f));
+                }
+                return values;
+            }();
+
+            return table;
+        }
+
+    }
+
+    void convert_to_luma(const unsigned char *source, int channels, unsigned char *destination, std::size_t count, luma_weights weights) {
+        fixed_weights w = get_fixed_weights(weights);
+
+        switch (get_instruction_set()) {
+#ifdef IMG_X86
+            case instruction_set::avx2:
+                convert_to_luma_avx2(source, channels, destination, count, w);
+                return;
+            case instruction_set::sse4:
+                convert_to_luma_sse4(source, channels, destination, count, w);
+                return;
+#endif
+            default:
+                convert_to_luma_scalar(source, channels, destination, count, w);
+                return;
+        }
+    }
+
+    void convert_to_linear_luma(const unsigned char *source, int channels, unsigned char *destination, std::size_t count, luma_weights weights) {
+        fixed_weights w = get_fixed_weights(weights);
+        const std::vector<std::uint16_t>& decode = get_decoding_table();
+        const std::vector<unsigned char>& encode = get_encoding_table();
+
+        if (channels < 3) {
+            // Already gray, luma of a gray color is the same in linear light.
+            convert_to_luma_scalar(source, channels, destination, count, w);
+            return;
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const unsigned char* pixel = source + i * channels;
+            std::uint32_t linear = (decode[pixel[0]] * w.r + decode[pixel[1]] * w.g + decode[pixel[2]] * w.b + 128) >> 8;
+            destination[i] = encode[linear >> 4];
+        }
+    }
+
+    unsigned char get_luma(unsigned char r, unsigned char g, unsigned char b, luma_weights weights) {
+        fixed_weights w = get_fixed_weights(weights);
+        return static_cast<unsigned char>((r * w.r + g * w.g + b * w.b + 128) >> 8);
+    }
+
+    void scale_luma(unsigned char* color, unsigned char luma, unsigned char target) {
+        if (luma == 0) {
+            color[0] = color[1] = color[2] = target;
+            return;
+        }
+
+        for (int c = 0; c < 3; ++c) {
+            color[c] = static_cast<unsigned char>(std::min((color[c] * target + luma / 2) / luma, 255));
+        }
+    }
+
+}
@@ -0,0 +1,145 @@
+
+#include "img/memory_mapped_file.h"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace img {
+
+    memory_mapped_file::memory_mapped_file(const std::string &filepath) : path(filepath),
+                                                                          data(nullptr),
+                                                                          size(0)
+#ifdef _WIN32
+                                                                          , mapping(nullptr)
+#endif
+                                                                          {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file); // The mapping keeps the file open.
+
+        if (!mapping) {
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+
+        data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!data) {
+            CloseHandle(mapping);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+
+        size = static_cast<std::size_t>(file_size.QuadPart);
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        struct stat info { };
+        if (fstat(file, &info) != 0 || info.st_size == 0) {
+            close(file);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+
+        void* address = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        close(file); // The mapping keeps the file open.
+
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+
+        // Decoders read front to back.
+        madvise(address, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+
+        data = static_cast<const unsigned char*>(address);
+        size = static_cast<std::size_t>(info.st_size);
+#endif
+    }
+
+    memory_mapped_file::~memory_mapped_file() {
+        unmap();
+    }
+
+    memory_mapped_file::memory_mapped_file(memory_mapped_file &&other) noexcept : path(std::move(other.path)),
+                                                                                 data(other.data),
+                                                                                 size(other.size)
+#ifdef _WIN32
+                                                                                 , mapping(other.mapping)
+#endif
+                                                                                 {
+        other.data = nullptr;
+        other.size = 0;
+#ifdef _WIN32
+        other.mapping = nullptr;
+#endif
+    }
+
+    memory_mapped_file &memory_mapped_file::operator=(memory_mapped_file &&other) noexcept {
+        if (&other == this) {
+            return *this;
+        }
+
+        unmap();
+
+        path = std::move(other.path);
+        data = other.data;
+        size = other.size;
+        other.data = nullptr;
+        other.size = 0;
+
+#ifdef _WIN32
+        mapping = other.mapping;
+        other.mapping = nullptr;
+#endif
+
+        return *this;
+    }
+
+    const unsigned char *memory_mapped_file::get_data() const {
+        return data;
+    }
+
+    std::size_t memory_mapped_file::get_size() const {
+        return size;
+    }
+
+    const std::string &memory_mapped_file::get_path() const {
+        return path;
+    }
+
+    void memory_mapped_file::unmap() {
+        if (!data) {
+            return;
+        }
+
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(const_cast<unsigned char*>(data), size);
+#endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+}
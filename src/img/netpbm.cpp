@@ -0,0 +1,242 @@
+
+#include "img/netpbm.h"
+
+namespace img {
+
+    namespace {
+
+        bool is_space(unsigned char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+        }
+
+        // Reads through the header text of PGM and PPM data.
+        class header_reader {
+            public:
+                header_reader(const unsigned char* buffer, std::size_t size) : buffer(buffer),
+                                                                               size(size),
+                                                                               position(2) // Past the magic number.
+                                                                               {
+                }
+
+                // Skips whitespace and comments, then reads a decimal number. Returns -1 if there is none.
+                int read_number() {
+                    while (position < size) {
+                        if (buffer[position] == '#') {
+                            while (position < size && buffer[position] != '\n') {
+                                ++position;
+                            }
+                        }
+                        else if (is_space(buffer[position])) {
+                            ++position;
+                        }
+                        else {
+                            break;
+                        }
+                    }
+
+                    std::int64_t value = -1;
+
+                    while (position < size && buffer[position] >= '0' && buffer[position] <= '9') {
+                        value = (value < 0 ? 0 : value * 10) + (buffer[position++] - '0');
+
+                        if (value > std::numeric_limits<int>::max()) {
+                            return -1;
+                        }
+                    }
+
+                    return static_cast<int>(value);
+                }
+
+                // Reads one line of a PAM header, without the line break.
+                bool read_line(std::string& line) {
+                    if (position >= size) {
+                        return false;
+                    }
+
+                    std::size_t end = position;
+                    while (end < size && buffer[end] != '\n') {
+                        ++end;
+                    }
+
+                    line.assign(reinterpret_cast<const char*>(buffer + position), end - position);
+                    position = std::min(end + 1, size);
+                    return true;
+                }
+
+                std::size_t get_position() const {
+                    return position;
+                }
+
+                void skip(std::size_t count) {
+                    position += count;
+                }
+
+            private:
+                const unsigned char* buffer;
+                std::size_t size;
+                std::size_t position;
+        };
+
+        std::optional<netpbm_header> read_pam_header(header_reader& reader) {
+            int width = -1;
+            int height = -1;
+            int depth = -1;
+            int max_value = -1;
+
+            std::string line;
+
+            // Rest of the magic number line.
+            if (!reader.read_line(line)) {
+                return std::nullopt;
+            }
+
+            while (reader.read_line(line)) {
+                std::stringstream tokens(line);
+                std::string key;
+                tokens >> key;
+
+                if (key.empty() || key[0] == '#' || key == "TUPLTYPE") {
+                    continue;
+                }
+                if (key == "ENDHDR") {
+                    if (width <= 0 || height <= 0 || depth < 1 || depth > 4 || max_value != 255) {
+                        return std::nullopt;
+                    }
+
+                    return netpbm_header { width, height, depth, reader.get_position() };
+                }
+
+                int value = -1;
+                tokens >> value;
+
+                if (key == "WIDTH") {
+                    width = value;
+                }
+                else if (key == "HEIGHT") {
+                    height = value;
+                }
+                else if (key == "DEPTH") {
+                    depth = value;
+                }
+                else if (key == "MAXVAL") {
+                    max_value = value;
+                }
+            }
+
+            return std::nullopt;
+        }
+
+    }
+
+    std::optional<netpbm_header> read_netpbm_header(const unsigned char *buffer, std::size_t size) {
+        if (!buffer || size < 3 || buffer[0] != 'P' || buffer[1] < '4' || buffer[1] > '7') {
+            return std::nullopt;
+        }
+
+        header_reader reader(buffer, size);
+        std::optional<netpbm_header> header;
+
+        if (buffer[1] == '7') {
+            header = read_pam_header(reader);
+        }
+        else {
+            int width = reader.read_number();
+            int height = reader.read_number();
+
+            // PBM has no maximum value.
+            int max_value = buffer[1] == '4' ? 255 : reader.read_number();
+
+            // A single whitespace character separates the header from the pixels.
+            if (width <= 0 || height <= 0 || max_value != 255 || reader.get_position() >= size || !is_space(buffer[reader.get_position()])) {
+                return std::nullopt;
+            }
+
+            reader.skip(1);
+            header = netpbm_header { width, height, buffer[1] == '6' ? 3 : 1, reader.get_position(), buffer[1] == '4' };
+        }
+
+        return header;
+    }
+
+    std::string get_netpbm_header(int width, int height, int channels, bool pam) {
+        std::stringstream header;
+
+        if (pam || channels == 2 || channels == 4) {
+            static const char* tuple_types[5] = { "", "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA" };
+
+            header << "P7\n";
+            header << "WIDTH " << width << '\n';
+            header << "HEIGHT " << height << '\n';
+            header << "DEPTH " << channels << '\n';
+            header << "MAXVAL 255\n";
+            header << "TUPLTYPE " << tuple_types[channels] << '\n';
+            header << "ENDHDR\n";
+        }
+        else {
+            header << (channels == 1 ? "P5" : "P6") << '\n' << width << ' ' << height << "\n255\n";
+        }
+
+        return header.str();
+    }
+
+    void encode_netpbm(const unsigned char *pixels, int width, int height, int channels, bool pam, const encode_writer &writer) {
+        std::string text = get_netpbm_header(width, height, channels, pam);
+        writer(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+        writer(pixels, static_cast<std::size_t>(width) * height * channels);
+    }
+
+    void unpack_pbm_row(const unsigned char *bits, int width, unsigned char *pixels) {
+        for (int x = 0; x < width; ++x) {
+            // Set bits are black.
+            pixels[x] = (bits[x / 8] >> (7 - x % 8)) & 1 ? 0x00 : 0xff;
+        }
+    }
+
+    void encode_pbm(const unsigned char *bits, int width, int height, const encode_writer &writer) {
+        std::string header = "P4\n" + std::to_string(width) + ' ' + std::to_string(height) + '\n';
+        writer(reinterpret_cast<const unsigned char*>(header.data()), header.size());
+
+        int stride = (width + 7) / 8;
+        std::vector<unsigned char> row(stride);
+
+        for (int y = 0; y < height; ++y) {
+            const unsigned char* source = bits + static_cast<std::size_t>(y) * stride;
+            std::transform(source, source + stride, row.begin(), [](unsigned char value) {
+                return static_cast<unsigned char>(~value);
+            });
+
+            writer(row.data(), row.size());
+        }
+    }
+
+    unsigned char* decode_netpbm(const unsigned char *buffer, std::size_t size, int *width, int *height, int *channels) {
+        std::optional<netpbm_header> header = read_netpbm_header(buffer, size);
+        if (!header || static_cast<std::uint64_t>(header->width) * header->height * header->channels > static_cast<std::uint64_t>(std::numeric_limits<int>::max())) {
+            return nullptr;
+        }
+
+        std::size_t total = static_cast<std::size_t>(header->width) * header->height * header->channels;
+        std::size_t stride = header->packed ? (static_cast<std::size_t>(header->width) + 7) / 8 : static_cast<std::size_t>(header->width) * header->channels;
+
+        if (size - header->offset < stride * header->height) {
+            return nullptr;
+        }
+
+        auto* pixels = new unsigned char[total];
+
+        if (header->packed) {
+            for (int y = 0; y < header->height; ++y) {
+                unpack_pbm_row(buffer + header->offset + y * stride, header->width, pixels + static_cast<std::size_t>(y) * header->width);
+            }
+        }
+        else {
+            std::memcpy(pixels, buffer + header->offset, total);
+        }
+
+        *width = header->width;
+        *height = header->height;
+        *channels = header->channels;
+        return pixels;
+    }
+
+}
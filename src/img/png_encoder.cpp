@@ -0,0 +1,497 @@
+
+#include "img/png_encoder.h"
+#include "img/thread_pool.h"
+
+namespace img {
+
+    namespace {
+
+        // Filtered bytes per band, bands are compressed independently so larger bands compress (slightly) better.
+        const std::size_t band_size = std::size_t(1) << 18;
+
+        // LZ77 parameters.
+        const int window_size = 1 << 15;
+        const int window_mask = window_size - 1;
+        const int hash_bits = 15;
+        const int hash_size = 1 << hash_bits;
+        const int min_match = 3;
+        const int max_match = 258;
+
+        // Longest hash chain followed for each compression level.
+        const int chain_lengths[10] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+
+        // Base lengths and extra bits of length symbols 257 to 285.
+        const int length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        const int length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+        // Base distances and extra bits of distance symbols 0 to 29.
+        const int distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        const int distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        // Deflate writes bits starting from the least significant one.
+        class bit_writer {
+            public:
+                explicit bit_writer(std::vector<unsigned char>& output) : output(output),
+                                                                          buffer(0),
+                                                                          count(0)
+                                                                          {
+                }
+
+                void write(std::uint32_t bits, int length) {
+                    buffer |= static_cast<std::uint64_t>(bits) << count;
+                    count += length;
+
+                    while (count >= 8) {
+                        output.emplace_back(static_cast<unsigned char>(buffer));
+                        buffer >>= 8;
+                        count -= 8;
+                    }
+                }
+
+                // Pads to a byte boundary with zero bits.
+                void align() {
+                    if (count > 0) {
+                        write(0, 8 - count);
+                    }
+                }
+
+            private:
+                std::vector<unsigned char>& output;
+                std::uint64_t buffer;
+                int count;
+        };
+
+        std::uint32_t reverse_bits(std::uint32_t code, int length) {
+            std::uint32_t result = 0;
+
+            for (int i = 0; i < length; ++i) {
+                result = (result << 1) | ((code >> i) & 1);
+            }
+
+            return result;
+        }
+
+        // Fixed Huffman codes (RFC 1951, 3.2.6), bit-reversed for writing.
+        struct fixed_codes {
+            fixed_codes() {
+                for (int symbol = 0; symbol < 288; ++symbol) {
+                    int length;
+                    std::uint32_t code;
+
+                    if (symbol < 144) {
+                        length = 8;
+                        code = 0x30 + symbol;
+                    }
+                    else if (symbol < 256) {
+                        length = 9;
+                        code = 0x190 + (symbol - 144);
+                    }
+                    else if (symbol < 280) {
+                        length = 7;
+                        code = symbol - 256;
+                    }
+                    else {
+                        length = 8;
+                        code = 0xc0 + (symbol - 280);
+                    }
+
+                    literals[symbol] = reverse_bits(code, length);
+                    literal_lengths[symbol] = length;
+                }
+
+                for (int symbol = 0; symbol < 30; ++symbol) {
+                    distances[symbol] = reverse_bits(symbol, 5);
+                }
+            }
+
+            std::uint32_t literals[288];
+            int literal_lengths[288];
+            std::uint32_t distances[30];
+        };
+
+        const fixed_codes& get_fixed_codes() {
+            static const fixed_codes codes;
+            return codes;
+        }
+
+        void write_literal(bit_writer& writer, const fixed_codes& codes, int symbol) {
+            writer.write(codes.literals[symbol], codes.literal_lengths[symbol]);
+        }
+
+        void write_match(bit_writer& writer, const fixed_codes& codes, int length, int distance) {
+            int length_symbol = static_cast<int>(std::upper_bound(std::begin(length_base), std::end(length_base), length) - std::begin(length_base)) - 1;
+            write_literal(writer, codes, 257 + length_symbol);
+            writer.write(length - length_base[length_symbol], length_extra[length_symbol]);
+
+            int distance_symbol = static_cast<int>(std::upper_bound(std::begin(distance_base), std::end(distance_base), distance) - std::begin(distance_base)) - 1;
+            writer.write(codes.distances[distance_symbol], 5);
+            writer.write(distance - distance_base[distance_symbol], distance_extra[distance_symbol]);
+        }
+
+        std::uint32_t hash(const unsigned char* data) {
+            return ((data[0] << 10) ^ (data[1] << 5) ^ data[2]) & (hash_size - 1);
+        }
+
+        // Compresses 'size' bytes into a single fixed Huffman block, with LZ77 matches found through hash chains.
+        void deflate_band(const unsigned char* data, std::size_t size, int level, bool last, std::vector<unsigned char>& output) {
+            const fixed_codes& codes = get_fixed_codes();
+            bit_writer writer(output);
+
+            // Block header: final flag, then type 1 (fixed Huffman codes).
+            writer.write(last ? 1 : 0, 1);
+            writer.write(1, 2);
+
+            std::vector<int> head(hash_size, -1);
+            std::vector<int> previous(window_size, -1);
+            int max_chain = chain_lengths[level];
+
+            auto insert = [&](std::size_t position) {
+                if (position + min_match <= size) {
+                    std::uint32_t h = hash(data + position);
+                    previous[position & window_mask] = head[h];
+                    head[h] = static_cast<int>(position);
+                }
+            };
+
+            std::size_t i = 0;
+
+            while (i < size) {
+                int best_length = 0;
+                int best_distance = 0;
+
+                if (i + min_match <= size) {
+                    int limit = static_cast<int>(std::min<std::size_t>(max_match, size - i));
+                    int candidate = head[hash(data + i)];
+
+                    for (int chain = 0; candidate >= 0 && chain < max_chain; ++chain) {
+                        int distance = static_cast<int>(i) - candidate;
+                        if (distance > window_size) {
+                            break;
+                        }
+
+                        const unsigned char* match = data + candidate;
+                        if (match[best_length] == data[i + best_length]) {
+                            int length = 0;
+                            while (length < limit && match[length] == data[i + length]) {
+                                ++length;
+                            }
+
+                            if (length > best_length) {
+                                best_length = length;
+                                best_distance = distance;
+
+                                if (length == limit) {
+                                    break;
+                                }
+                            }
+                        }
+
+                        // Entries of the chain only ever point backwards, anything else was overwritten.
+                        int next = previous[candidate & window_mask];
+                        if (next >= candidate) {
+                            break;
+                        }
+
+                        candidate = next;
+                    }
+                }
+
+                if (best_length >= min_match) {
+                    write_match(writer, codes, best_length, best_distance);
+
+                    for (int j = 0; j < best_length; ++j) {
+                        insert(i + j);
+                    }
+
+                    i += best_length;
+                }
+                else {
+                    write_literal(writer, codes, data[i]);
+                    insert(i);
+                    ++i;
+                }
+            }
+
+            // End of block.
+            write_literal(writer, codes, 256);
+
+            if (!last) {
+                // Sync flush: an empty stored block ends the band on a byte boundary.
+                writer.write(0, 3);
+                writer.align();
+
+                output.insert(output.end(), { 0x00, 0x00, 0xff, 0xff });
+            }
+
+            writer.align();
+        }
+
+        // Stores 'size' bytes uncompressed, in blocks of up to 65535 bytes.
+        void store_band(const unsigned char* data, std::size_t size, bool last, std::vector<unsigned char>& output) {
+            std::size_t offset = 0;
+
+            do {
+                std::size_t length = std::min<std::size_t>(size - offset, 65535);
+                bool final = last && offset + length == size;
+
+                // Header (final flag, type 0) padded to a full byte, then the length and its complement.
+                output.emplace_back(final ? 1 : 0);
+                output.emplace_back(static_cast<unsigned char>(length));
+                output.emplace_back(static_cast<unsigned char>(length >> 8));
+                output.emplace_back(static_cast<unsigned char>(~length));
+                output.emplace_back(static_cast<unsigned char>(~length >> 8));
+                output.insert(output.end(), data + offset, data + offset + length);
+
+                offset += length;
+            } while (offset < size);
+        }
+
+        std::uint32_t adler32(std::uint32_t adler, const unsigned char* data, std::size_t size) {
+            static const std::uint32_t base = 65521;
+
+            // Largest number of bytes before the sums need to be reduced.
+            static const std::size_t chunk = 5552;
+
+            std::uint32_t a = adler & 0xffff;
+            std::uint32_t b = adler >> 16;
+
+            while (size > 0) {
+                std::size_t length = std::min(size, chunk);
+                size -= length;
+
+                for (std::size_t i = 0; i < length; ++i) {
+                    a += data[i];
+                    b += a;
+                }
+
+                data += length;
+                a %= base;
+                b %= base;
+            }
+
+            return a | (b << 16);
+        }
+
+        // Checksum of two consecutive pieces of data, from the checksums of both pieces and the size of the second.
+        std::uint32_t adler32_combine(std::uint32_t first, std::uint32_t second, std::size_t second_size) {
+            static const std::uint32_t base = 65521;
+
+            std::uint32_t remainder = static_cast<std::uint32_t>(second_size % base);
+            std::uint32_t a = first & 0xffff;
+            std::uint32_t b = static_cast<std::uint32_t>((static_cast<std::uint64_t>(remainder) * a) % base);
+
+            a += (second & 0xffff) + base - 1;
+            b += (first >> 16) + (second >> 16) + base - remainder;
+
+            if (a >= base) {
+                a -= base;
+            }
+            if (a >= base) {
+                a -= base;
+            }
+            if (b >= base * 2) {
+                b -= base * 2;
+            }
+            if (b >= base) {
+                b -= base;
+            }
+
+            return a | (b << 16);
+        }
+
+        std::uint32_t crc32(std::uint32_t crc, const unsigned char* data, std::size_t size) {
+            static const std::array<std::uint32_t, 256> table = []() {
+                std::array<std::uint32_t, 256> entries { };
+
+                for (std::uint32_t i = 0; i < 256; ++i) {
+                    std::uint32_t value = i;
+
+                    for (int bit = 0; bit < 8; ++bit) {
+                        value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                    }
+
+                    entries[i] = value;
+                }
+
+                return entries;
+            }();
+
+            crc = ~crc;
+            for (std::size_t i = 0; i < size; ++i) {
+                crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            }
+
+            return ~crc;
+        }
+
+        int paeth(int a, int b, int c) {
+            int p = a + b - c;
+            int pa = std::abs(p - a);
+            int pb = std::abs(p - b);
+            int pc = std::abs(p - c);
+
+            if (pa <= pb && pa <= pc) {
+                return a;
+            }
+
+            return pb <= pc ? b : c;
+        }
+
+        // Filters one row with the filter type that minimizes the sum of absolute (signed) filtered values, the
+        // heuristic suggested by the PNG specification. 'output' receives the filter type followed by the row.
+        void filter_row(const unsigned char* row, const unsigned char* above, int row_size, int channels, unsigned char* output, std::vector<unsigned char>& scratch) {
+            scratch.resize(row_size);
+
+            std::uint64_t best_estimate = std::numeric_limits<std::uint64_t>::max();
+
+            for (int type = 0; type < 5; ++type) {
+                std::uint64_t estimate = 0;
+
+                for (int i = 0; i < row_size; ++i) {
+                    int left = i >= channels ? row[i - channels] : 0;
+                    int up = above ? above[i] : 0;
+                    int up_left = above && i >= channels ? above[i - channels] : 0;
+
+                    int prediction = 0;
+                    switch (type) {
+                        case 1:
+                            prediction = left;
+                            break;
+                        case 2:
+                            prediction = up;
+                            break;
+                        case 3:
+                            prediction = (left + up) / 2;
+                            break;
+                        case 4:
+                            prediction = paeth(left, up, up_left);
+                            break;
+                        default:
+                            break;
+                    }
+
+                    auto value = static_cast<unsigned char>(row[i] - prediction);
+                    scratch[i] = value;
+                    estimate += std::abs(static_cast<signed char>(value));
+                }
+
+                if (estimate < best_estimate) {
+                    best_estimate = estimate;
+                    output[0] = static_cast<unsigned char>(type);
+                    std::copy(scratch.begin(), scratch.end(), output + 1);
+                }
+            }
+        }
+
+        void write_big_endian(std::vector<unsigned char>& output, std::uint32_t value) {
+            output.insert(output.end(), { static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value) });
+        }
+
+        void write_chunk(std::vector<unsigned char>& output, const char* type, const unsigned char* data, std::size_t size) {
+            write_big_endian(output, static_cast<std::uint32_t>(size));
+
+            std::size_t start = output.size();
+            output.insert(output.end(), type, type + 4);
+            output.insert(output.end(), data, data + size);
+
+            // Checksum covers the chunk type and data.
+            write_big_endian(output, crc32(0, output.data() + start, size + 4));
+        }
+
+
+        // Encodes 'height' rows of 'row_size' bytes. Filters predict from the byte 'bytes_per_pixel' to the left.
+        std::vector<unsigned char> encode(const unsigned char* pixels, int row_size, int width, int height, int bytes_per_pixel, unsigned char bit_depth, unsigned char color_type, int level) {
+            std::vector<unsigned char> png;
+            level = std::clamp(level, 0, 9);
+
+            std::size_t filtered_row_size = static_cast<std::size_t>(row_size) + 1;
+
+            int rows_per_band = static_cast<int>(std::max<std::size_t>(1, band_size / filtered_row_size));
+            int num_bands = (height + rows_per_band - 1) / rows_per_band;
+
+            std::vector<std::vector<unsigned char>> bands(num_bands);
+            std::vector<std::uint32_t> checksums(num_bands);
+
+            // Rows only depend on the row above, every band is filtered and compressed on its own.
+            parallel_for_rows(num_bands, [&](int first, int last) {
+                std::vector<unsigned char> filtered;
+                std::vector<unsigned char> scratch;
+
+                for (int band = first; band < last; ++band) {
+                    int y0 = band * rows_per_band;
+                    int y1 = std::min(y0 + rows_per_band, height);
+
+                    filtered.resize((y1 - y0) * filtered_row_size);
+
+                    for (int y = y0; y < y1; ++y) {
+                        const unsigned char* row = pixels + static_cast<std::size_t>(y) * row_size;
+                        const unsigned char* above = y > 0 ? row - row_size : nullptr;
+                        filter_row(row, above, row_size, bytes_per_pixel, filtered.data() + (y - y0) * filtered_row_size, scratch);
+                    }
+
+                    checksums[band] = adler32(1, filtered.data(), filtered.size());
+
+                    bool final = band == num_bands - 1;
+                    if (level == 0) {
+                        store_band(filtered.data(), filtered.size(), final, bands[band]);
+                    }
+                    else {
+                        deflate_band(filtered.data(), filtered.size(), level, final, bands[band]);
+                    }
+                }
+            }, 1);
+
+            // zlib stream: header (deflate, 32K window, no dictionary), bands, checksum of the uncompressed data.
+            std::vector<unsigned char> stream = { 0x78, 0x01 };
+            std::uint32_t adler = 1;
+
+            for (int band = 0; band < num_bands; ++band) {
+                stream.insert(stream.end(), bands[band].begin(), bands[band].end());
+
+                int y0 = band * rows_per_band;
+                int y1 = std::min(y0 + rows_per_band, height);
+                adler = adler32_combine(adler, checksums[band], (y1 - y0) * filtered_row_size);
+            }
+
+            write_big_endian(stream, adler);
+
+            // Signature.
+            png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+            std::vector<unsigned char> header;
+            write_big_endian(header, static_cast<std::uint32_t>(width));
+            write_big_endian(header, static_cast<std::uint32_t>(height));
+            header.insert(header.end(), { bit_depth, color_type, 0, 0, 0 }); // Bit depth, color type, compression, filter, interlace.
+
+            write_chunk(png, "IHDR", header.data(), header.size());
+            write_chunk(png, "IDAT", stream.data(), stream.size());
+            write_chunk(png, "IEND", nullptr, 0);
+
+            return png;
+        }
+
+    }
+
+    std::vector<unsigned char> encode_png(const unsigned char *pixels, int width, int height, int channels, int level) {
+        if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+            std::cerr << "Invalid image passed to encode_png()." << std::endl;
+            return { };
+        }
+
+        // Color types by channel count: gray, gray with alpha, RGB, RGBA.
+        static const unsigned char color_types[5] = { 0, 0, 4, 2, 6 };
+
+        return encode(pixels, width * channels, width, height, channels, 8, color_types[channels], level);
+    }
+
+    std::vector<unsigned char> encode_png_1bpp(const unsigned char *bits, int width, int height, int level) {
+        if (!bits || width <= 0 || height <= 0) {
+            std::cerr << "Invalid bitmap passed to encode_png_1bpp()." << std::endl;
+            return { };
+        }
+
+        // Gray with a bit depth of 1, filters work on whole bytes.
+        return encode(bits, (width + 7) / 8, width, height, 1, 1, 0, level);
+    }
+
+}
@@ -0,0 +1,281 @@
+
+#include "img/point_operation.h"
+#include "img/hash.h"
+#include "img/utility.h"
+
+namespace img {
+
+    namespace {
+
+        // Constructs un-normalized threshold map based on https://en.wikipedia.org/wiki/Ordered_dithering#Pre-calculated_threshold_maps.
+        std::vector<float> get_bayer_matrix_helper(int n) {
+            int dimension = integer_power(2, n + 1);
+
+            std::vector<float> matrix{ };
+            matrix.resize(dimension * dimension);
+
+            // Bayer(0) = [ 0  2 ]
+            //            [ 3  1 ]
+            //  ...
+            // Bayer(n) = [ 4 * Bayer(n - 1) + 0    4 * Bayer(n - 1) + 2 ]
+            //            [ 4 * Bayer(n - 1) + 3    4 * Bayer(n - 1) + 1 ]
+
+            if (n == 0) {
+                // Base case.
+                matrix[0] = 0;
+                matrix[1] = 2;
+                matrix[2] = 3;
+                matrix[3] = 1;
+            }
+            else {
+                std::vector<float> previous = get_bayer_matrix_helper(n - 1);
+                int previous_dimension = integer_power(2, n);
+
+                int index = 0;
+
+                // Copy over elements.
+                // Top two, row by row.
+                for (int y = 0; y < previous_dimension; ++y) {
+                    // Copy row from first Bayer matrix.
+                    for (int x = 0; x < previous_dimension; ++x) {
+                        matrix[index++] = 4.0f * previous[y * previous_dimension + x] + 0.0f;
+                    }
+
+                    // Copy row from second Bayer matrix.
+                    for (int x = 0; x < previous_dimension; ++x) {
+                        matrix[index++] = 4.0f * previous[y * previous_dimension + x] + 2.0f;
+                    }
+                }
+
+                // Bottom two, row by row.
+                for (int y = 0; y < previous_dimension; ++y) {
+                    // Copy row from first Bayer matrix.
+                    for (int x = 0; x < previous_dimension; ++x) {
+                        matrix[index++] = 4.0f * previous[y * previous_dimension + x] + 3.0f;
+                    }
+
+                    // Copy row from second Bayer matrix.
+                    for (int x = 0; x < previous_dimension; ++x) {
+                        matrix[index++] = 4.0f * previous[y * previous_dimension + x] + 1.0f;
+                    }
+                }
+            }
+
+            return matrix;
+        }
+
+        // Constructs ordered dithering threshold map with side length as a power of 2. Resulting matrix is
+        // normalized.
+        // n-values corresponding to matrix dimensions:
+        //   0 - 2x2
+        //   1 - 4x4
+        //   2 - 8x8
+        //   3 - 16x16
+        std::vector<float> get_bayer_matrix(int n) {
+            std::vector<float> bayer_matrix = get_bayer_matrix_helper(n);
+
+            // Apply normalization (divide all elements by 2 ^ (2 * n + 2)
+            float divisor = static_cast<float>(integer_power(2, 2 * n + 2));
+
+            for (float& value : bayer_matrix) {
+                value /= divisor;
+            }
+
+            return bayer_matrix;
+        }
+
+        // Converts from n-value to Bayer Matrix dimension.
+        int get_bayer_matrix_dimension(int n) {
+            return integer_power(2, n + 1);
+        }
+
+    }
+
+    point_operation grayscale_operation(luma_weights weights, bool linear_light, bool single_channel) {
+        point_operation operation;
+
+        // Write luma back to every color channel, alpha is set to opaque. Single channel images only keep the luma.
+        operation.function = [weights, linear_light](unsigned char* pixels, int count, int, int) {
+            unsigned char luma[point_operation::max_count];
+
+            // SIMD fixed-point kernels.
+            if (linear_light) {
+                convert_to_linear_luma(pixels, 4, luma, count, weights);
+            }
+            else {
+                convert_to_luma(pixels, 4, luma, count, weights);
+            }
+
+            for (int i = 0; i < count; ++i) {
+                unsigned char* pixel = pixels + i * 4;
+                pixel[0] = pixel[1] = pixel[2] = luma[i];
+                pixel[3] = 0xff;
+            }
+        };
+
+        operation.channels = single_channel ? 1 : 0;
+        operation.suffix = "_grayscale";
+        operation.key = "grayscale(" + std::to_string(static_cast<int>(weights)) + ',' + std::to_string(linear_light) + ',' + std::to_string(single_channel) + ')';
+
+        return operation;
+    }
+
+    point_operation threshold_operation(unsigned char level, luma_weights weights) {
+        point_operation operation;
+
+        operation.function = [level, weights](unsigned char* pixels, int count, int, int) {
+            unsigned char luma[point_operation::max_count];
+            convert_to_luma(pixels, 4, luma, count, weights);
+
+            for (int i = 0; i < count; ++i) {
+                unsigned char* pixel = pixels + i * 4;
+                pixel[0] = pixel[1] = pixel[2] = luma[i] >= level ? 0xff : 0x00;
+            }
+        };
+
+        operation.channels = 0;
+        operation.suffix = "_threshold_" + std::to_string(level);
+        operation.key = "threshold(" + std::to_string(level) + ',' + std::to_string(static_cast<int>(weights)) + ')';
+
+        return operation;
+    }
+
+    point_operation lut_operation(const std::array<unsigned char, 256>& table) {
+        point_operation operation;
+
+        operation.function = [table](unsigned char* pixels, int count, int, int) {
+            for (int i = 0; i < count; ++i) {
+                unsigned char* pixel = pixels + i * 4;
+                pixel[0] = table[pixel[0]];
+                pixel[1] = table[pixel[1]];
+                pixel[2] = table[pixel[2]];
+            }
+        };
+
+        operation.channels = 0;
+        operation.suffix = "_lut";
+        operation.key = "lut(" + to_hex(xxhash64(table.data(), table.size())) + ')';
+
+        return operation;
+    }
+
+    point_operation lut_operation(const std::array<std::array<unsigned char, 256>, 3>& tables) {
+        point_operation operation;
+
+        operation.function = [tables](unsigned char* pixels, int count, int, int) {
+            for (int i = 0; i < count; ++i) {
+                unsigned char* pixel = pixels + i * 4;
+                pixel[0] = tables[0][pixel[0]];
+                pixel[1] = tables[1][pixel[1]];
+                pixel[2] = tables[2][pixel[2]];
+            }
+        };
+
+        operation.channels = 0;
+        operation.suffix = "_lut";
+        operation.key = "lut(" + to_hex(xxhash64(tables.data(), sizeof(tables))) + ')';
+
+        return operation;
+    }
+
+    point_operation luma_lut_operation(const std::array<unsigned char, 256>& table) {
+        point_operation operation;
+
+        operation.function = [table](unsigned char* pixels, int count, int, int) {
+            std::array<unsigned char, point_operation::max_count> luma;
+            convert_to_luma(pixels, 4, luma.data(), count);
+
+            for (int i = 0; i < count; ++i) {
+                scale_luma(pixels + i * 4, luma[i], table[luma[i]]);
+            }
+        };
+
+        operation.channels = 0;
+        operation.suffix = "_luma_lut";
+        operation.key = "luma_lut(" + to_hex(xxhash64(table.data(), table.size())) + ')';
+
+        return operation;
+    }
+
+    point_operation bayer_operation(int matrix_width, int matrix_height) {
+        // Get Bayer Matrix that encompasses the desired matrix dimension.
+        int max = matrix_height >= matrix_width ? matrix_height : matrix_width;
+
+        int bayer_matrix_level = next_power_of(2, max) - 1; // Zero-based.
+
+        std::vector<float> bayer_matrix = get_bayer_matrix(bayer_matrix_level);
+        int dimension = get_bayer_matrix_dimension(bayer_matrix_level);
+
+        point_operation operation;
+
+        operation.function = [bayer_matrix, dimension, matrix_width, matrix_height](unsigned char* pixels, int count, int x, int y) {
+            const float* row = bayer_matrix.data() + (y % matrix_height) * dimension;
+
+            for (int i = 0; i < count; ++i) {
+                unsigned char* pixel = pixels + i * 4;
+
+                // Helpful resource for this part: https://github.com/ShadowfaxRodeo/dither-me-this
+                float bayer_element = row[(x + i) % matrix_width];
+
+                // Bayer Matrix is in the domain [0, 1]. Alpha channel is ignored.
+                float r = static_cast<float>(pixel[0]) / 255.0f;
+                float g = static_cast<float>(pixel[1]) / 255.0f;
+                float b = static_cast<float>(pixel[2]) / 255.0f;
+
+                unsigned char value = (r + g + b) / 3.0f > bayer_element ? 0xff : 0x00;
+                pixel[0] = pixel[1] = pixel[2] = pixel[3] = value;
+            }
+        };
+
+        operation.channels = 0;
+        operation.suffix = "_dither_bayer_" + std::to_string(matrix_width) + 'x' + std::to_string(matrix_height);
+        operation.key = "bayer(" + std::to_string(matrix_width) + ',' + std::to_string(matrix_height) + ')';
+
+        return operation;
+    }
+
+    void unpack_rgba(const unsigned char* source, int channels, unsigned char* destination, int count) {
+        for (int i = 0; i < count; ++i) {
+            const unsigned char* input = source + i * channels;
+            unsigned char* output = destination + i * 4;
+
+            if (channels < 3) {
+                // Grayscale, with optional alpha.
+                output[0] = output[1] = output[2] = input[0];
+                output[3] = channels == 2 ? input[1] : 0xff;
+            }
+            else {
+                output[0] = input[0];
+                output[1] = input[1];
+                output[2] = input[2];
+                output[3] = channels >= 4 ? input[3] : 0xff;
+            }
+        }
+    }
+
+    void pack_rgba(const unsigned char* source, unsigned char* destination, int channels, int count) {
+        for (int i = 0; i < count; ++i) {
+            const unsigned char* input = source + i * 4;
+            unsigned char* output = destination + i * channels;
+
+            if (channels < 3) {
+                // Grayscale, with optional alpha.
+                output[0] = get_luma(input[0], input[1], input[2]);
+
+                if (channels == 2) {
+                    output[1] = input[3];
+                }
+            }
+            else {
+                output[0] = input[0];
+                output[1] = input[1];
+                output[2] = input[2];
+
+                if (channels >= 4) {
+                    output[3] = input[3];
+                }
+            }
+        }
+    }
+
+}
@@ -0,0 +1,191 @@
+
+#include "img/probe.h"
+#include "img/qoi.h"
+#include "img/netpbm.h"
+
+namespace img {
+
+    namespace {
+
+        bool starts_with(const unsigned char* header, std::size_t size, std::initializer_list<unsigned char> magic) {
+            return size >= magic.size() && std::equal(magic.begin(), magic.end(), header);
+        }
+
+        // Bytes read from files for detect_format() and the headers of formats decoded without stb_image, enough for
+        // any PAM header without long comments.
+        const std::size_t header_size = 512;
+
+        // Formats decoded without stb_image.
+        std::optional<image_info> probe_native(const unsigned char* header, std::size_t size) {
+            image_info info { };
+
+            if (read_qoi_header(header, size, &info.width, &info.height, &info.channels)) {
+                info.format = image_format::qoi;
+                return info;
+            }
+
+            if (std::optional<netpbm_header> netpbm = read_netpbm_header(header, size)) {
+                info.width = netpbm->width;
+                info.height = netpbm->height;
+                info.channels = netpbm->channels;
+                info.format = detect_format(header, size);
+                return info;
+            }
+
+            return std::nullopt;
+        }
+
+        // Format of data stb_image recognized as an image.
+        image_format get_format(const unsigned char* header, std::size_t size) {
+            image_format format = detect_format(header, size);
+
+            // TGA has no signature, anything else stb_image recognized is TGA.
+            return format == image_format::unknown ? image_format::tga : format;
+        }
+
+    }
+
+    std::optional<image_info> probe(const std::string &filepath) {
+        // Header and dimensions are read through the same file, stb_image only reads as much as it needs.
+        FILE* file = fopen(filepath.c_str(), "rb");
+        if (!file) {
+            return std::nullopt;
+        }
+
+        unsigned char header[header_size];
+        std::size_t size = fread(header, 1, header_size, file);
+        fseek(file, 0, SEEK_SET);
+
+        if (std::optional<image_info> native = probe_native(header, size)) {
+            fclose(file);
+            return native;
+        }
+
+        image_info info { };
+        int result = stbi_info_from_file(file, &info.width, &info.height, &info.channels);
+        fclose(file);
+
+        if (!result) {
+            return std::nullopt;
+        }
+
+        info.format = get_format(header, size);
+        return info;
+    }
+
+    std::optional<image_info> probe(const unsigned char *buffer, std::size_t size) {
+        if (!buffer || size > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+            return std::nullopt;
+        }
+
+        if (std::optional<image_info> native = probe_native(buffer, size)) {
+            return native;
+        }
+
+        image_info info { };
+        if (!stbi_info_from_memory(buffer, static_cast<int>(size), &info.width, &info.height, &info.channels)) {
+            return std::nullopt;
+        }
+
+        info.format = get_format(buffer, size);
+        return info;
+    }
+
+    image_format detect_format(const unsigned char *header, std::size_t size) {
+        if (starts_with(header, size, { 0x89, 'P', 'N', 'G' })) {
+            return image_format::png;
+        }
+        if (starts_with(header, size, { 0xff, 0xd8, 0xff })) {
+            return image_format::jpg;
+        }
+        if (starts_with(header, size, { 'B', 'M' })) {
+            return image_format::bmp;
+        }
+        if (starts_with(header, size, { 'G', 'I', 'F', '8' })) {
+            return image_format::gif;
+        }
+        if (starts_with(header, size, { '8', 'B', 'P', 'S' })) {
+            return image_format::psd;
+        }
+        if (starts_with(header, size, { '#', '?', 'R', 'A', 'D', 'I', 'A', 'N', 'C', 'E' }) || starts_with(header, size, { '#', '?', 'R', 'G', 'B', 'E' })) {
+            return image_format::hdr;
+        }
+        if (starts_with(header, size, { 0x53, 0x80, 0xf6, 0x34 })) {
+            return image_format::pic;
+        }
+        if (starts_with(header, size, { 'q', 'o', 'i', 'f' })) {
+            return image_format::qoi;
+        }
+        if (starts_with(header, size, { 'P', '7' })) {
+            return image_format::pam;
+        }
+        if (starts_with(header, size, { 'P', '1' }) || starts_with(header, size, { 'P', '4' })) {
+            return image_format::pbm;
+        }
+        if (size >= 2 && header[0] == 'P' && header[1] >= '2' && header[1] <= '6') {
+            return image_format::pnm;
+        }
+
+        return image_format::unknown;
+    }
+
+    image_format format_from_extension(const std::string& extension) {
+        std::string lower = extension;
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+
+        static const std::unordered_map<std::string, image_format> formats = {
+            { "png", image_format::png },
+            { "jpg", image_format::jpg },
+            { "jpeg", image_format::jpg },
+            { "bmp", image_format::bmp },
+            { "gif", image_format::gif },
+            { "tga", image_format::tga },
+            { "psd", image_format::psd },
+            { "hdr", image_format::hdr },
+            { "pic", image_format::pic },
+            { "pnm", image_format::pnm },
+            { "ppm", image_format::pnm },
+            { "pgm", image_format::pnm },
+            { "pbm", image_format::pbm },
+            { "pam", image_format::pam },
+            { "qoi", image_format::qoi }
+        };
+
+        auto it = formats.find(lower);
+        return it == formats.end() ? image_format::unknown : it->second;
+    }
+
+    std::string to_string(image_format format) {
+        switch (format) {
+            case image_format::png:
+                return "png";
+            case image_format::jpg:
+                return "jpg";
+            case image_format::bmp:
+                return "bmp";
+            case image_format::gif:
+                return "gif";
+            case image_format::tga:
+                return "tga";
+            case image_format::psd:
+                return "psd";
+            case image_format::hdr:
+                return "hdr";
+            case image_format::pic:
+                return "pic";
+            case image_format::pnm:
+                return "pnm";
+            case image_format::pbm:
+                return "pbm";
+            case image_format::pam:
+                return "pam";
+            case image_format::qoi:
+                return "qoi";
+            default:
+                return "unknown";
+        }
+    }
+
+}
@@ -1,195 +1,512 @@
 
 #include "img/processor.h"
 #include "img/utility.h"
+#include "img/thread_pool.h"
+#include "img/result_cache.h"
+#include "img/trace.h"
 
 namespace img {
 
-    processor::processor(const image &im) : im(im) {
+    namespace {
+
+        double get_milliseconds_since(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // Shortest representation of 'value' for result names ("1.5" rather than "1.500000").
+        std::string to_compact_string(float value) {
+            std::ostringstream stream;
+            stream << value;
+            return stream.str();
+        }
+
+        // Result cache key of a randomized operation. Results are only reproducible once a seed is set (see
+        // set_random_seed()), which becomes part of the key. Empty otherwise, so the result is not cached.
+        std::string get_random_key(const std::string& operation, const std::string& parameters) {
+            std::optional<std::uint32_t> seed = get_random_seed();
+            if (!seed) {
+                return {};
+            }
+
+            return operation + '(' + parameters + ",seed=" + std::to_string(*seed) + ')';
+        }
+
+        // Converts 'color' to 'channels' channels the same way image::set_pixel() does, so that it can be copied into
+        // pixels directly.
+        void convert_color(const glm::vec4& color, int channels, unsigned char* destination) {
+            pixel value(color);
+            unsigned char rgba[4] = { value.r, value.g, value.b, value.a };
+            pack_rgba(rgba, destination, channels, 1);
+        }
+
+        // Copies the alpha channel (if any) of 'source' into 'destination', both of the same dimensions.
+        void copy_alpha(const image& source, image& destination) {
+            int channels = source.get_channels();
+            if (channels != 2 && channels != 4) {
+                return;
+            }
+
+            std::size_t count = static_cast<std::size_t>(source.get_width()) * source.get_height();
+            const unsigned char* input = source.get_data();
+            unsigned char* output = destination.get_data();
+
+            for (std::size_t i = 0; i < count; ++i) {
+                output[i * channels + channels - 1] = input[i * channels + channels - 1];
+            }
+        }
+
+    }
+
+    processor::processor(const image &im, execution mode) : im(im),
+                                                             pending(),
+                                                             mode(mode),
+                                                             output_directory(convert_to_native_separators("assets/generated/" + im.file.name)),
+                                                             k_means_statistics()
+                                                             {
     }
 
     processor::~processor() = default;
 
     image processor::get() const {
+        execute();
         return im;
     }
 
-    void processor::save() const {
-        im.save();
+    bool processor::save(const encode_options& options) const {
+        execute();
+        return im.save(options);
+    }
+
+    bool processor::save(const std::string &filepath, const encode_options &options) const {
+        execute();
+        return im.save(filepath, options);
+    }
+
+    processor &processor::set_output_directory(const std::string &directory) {
+        output_directory = convert_to_native_separators(directory);
+        return *this;
+    }
+
+    const std::string &processor::get_output_directory() const {
+        return output_directory;
+    }
+
+    std::future<bool> processor::save_async(const encode_options& options) const {
+        execute();
+        return im.save_async(options);
+    }
+
+    processor &processor::to_grayscale(luma_weights weights, bool linear_light, bool single_channel) {
+        return apply(grayscale_operation(weights, linear_light, single_channel));
     }
 
-    processor &processor::to_grayscale() {
-        // Luminosity constants.
-        static const float r_weight = 0.299f;
-        static const float g_weight = 0.587f;
-        static const float b_weight = 0.114f;
+    processor &processor::threshold(unsigned char level, luma_weights weights) {
+        return apply(threshold_operation(level, weights));
+    }
+
+    processor &processor::apply_lut(const std::array<unsigned char, 256>& table) {
+        return apply(lut_operation(table));
+    }
+
+    processor &processor::equalize_histogram() {
+        if (defer("equalize_histogram", [](processor& p) { (void) p.equalize_histogram(); })) {
+            return *this;
+        }
+
+        IMG_TRACE_SCOPE("processor::equalize_histogram");
+
+        // The table depends on the pixels, so it can only be built once all previous operations have run.
+        point_operation operation = luma_lut_operation(get_equalization_table(im.get_histogram()->get_luma()));
+        operation.suffix = "_equalized";
+        execute({ std::move(operation) });
+
+        return *this;
+    }
+
+    processor &processor::auto_levels(float clip) {
+        if (defer("auto_levels(" + std::to_string(clip) + ')', [clip](processor& p) { (void) p.auto_levels(clip); })) {
+            return *this;
+        }
+
+        IMG_TRACE_SCOPE("processor::auto_levels");
+
+        // Invalid clip percentage.
+        if (clip < 0.0f || clip >= 50.0f) {
+            std::cerr << "Invalid clip percentage passed to auto_levels()." << std::endl;
+            return *this;
+        }
+
+        std::shared_ptr<const histogram> counts = im.get_histogram();
+        double fraction = clip / 100.0;
+
+        // Gray images use the same table for every channel.
+        std::array<std::array<unsigned char, 256>, 3> tables { };
+        for (int c = 0; c < 3; ++c) {
+            const histogram_counts& channel = counts->get_channel(im.channels >= 3 ? c : 0);
+            tables[c] = get_levels_table(get_percentile(channel, fraction), get_percentile(channel, 1.0 - fraction));
+        }
+
+        point_operation operation = lut_operation(tables);
+        operation.suffix = "_auto_levels";
+        execute({ std::move(operation) });
+
+        return *this;
+    }
+
+    processor &processor::clahe(int tiles, float clip_limit) {
+        if (defer("clahe(" + std::to_string(tiles) + ',' + std::to_string(clip_limit) + ')', [tiles, clip_limit](processor& p) { (void) p.clahe(tiles, clip_limit); })) {
+            return *this;
+        }
+
+        IMG_TRACE_SCOPE("processor::clahe");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
+
+        // Invalid parameters.
+        if (tiles <= 0 || clip_limit < 1.0f) {
+            std::cerr << "Invalid parameters passed to clahe()." << std::endl;
+            return *this;
+        }
 
         int width = im.width;
         int height = im.height;
         int channels = im.channels;
+        int color_channels = channels == 2 || channels == 4 ? channels - 1 : channels;
 
-        // Convert to grayscale.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                // Scale pixel value by grayscale modifiers.
-                glm::vec4 value = glm::vec4(im.get_pixel(x, y));
-                unsigned char color = static_cast<unsigned char>((float) value.r * r_weight +
-                                                                 (float) value.g * g_weight +
-                                                                 (float) value.b * b_weight);
-                im.set_pixel(x, y, glm::vec4(color, color, color, 255.0f));
+        // Every region holds at least one pixel.
+        int tiles_x = std::min(tiles, width);
+        int tiles_y = std::min(tiles, height);
+
+        std::vector<unsigned char> luma(static_cast<std::size_t>(width) * height);
+        parallel_for_rows(height, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                std::size_t offset = static_cast<std::size_t>(y) * width;
+                convert_to_luma(im.data + offset * channels, channels, luma.data() + offset, width);
+            }
+        });
+
+        // Clipped equalization table of every region, in row-major order.
+        std::vector<std::array<unsigned char, 256>> tables(static_cast<std::size_t>(tiles_x) * tiles_y);
+
+        parallel_for_rows(tiles_x * tiles_y, [&](int first, int last) {
+            for (int tile = first; tile < last; ++tile) {
+                int tx = tile % tiles_x;
+                int ty = tile / tiles_x;
+
+                int x0 = tx * width / tiles_x;
+                int x1 = (tx + 1) * width / tiles_x;
+                int y0 = ty * height / tiles_y;
+                int y1 = (ty + 1) * height / tiles_y;
+
+                histogram_counts counts { };
+                for (int y = y0; y < y1; ++y) {
+                    const unsigned char* row = luma.data() + static_cast<std::size_t>(y) * width;
+
+                    for (int x = x0; x < x1; ++x) {
+                        ++counts[row[x]];
+                    }
+                }
+
+                // Clip bins, and spread the excess evenly over all of them.
+                std::uint64_t pixels = static_cast<std::uint64_t>(x1 - x0) * (y1 - y0);
+                auto limit = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(clip_limit * static_cast<float>(pixels) / 256.0f));
+                std::uint64_t excess = 0;
+
+                for (std::uint64_t& count : counts) {
+                    if (count > limit) {
+                        excess += count - limit;
+                        count = limit;
+                    }
+                }
+
+                for (std::size_t value = 0; value < counts.size(); ++value) {
+                    counts[value] += excess / 256 + (value < excess % 256 ? 1 : 0);
+                }
+
+                std::uint64_t cumulative = 0;
+                for (std::size_t value = 0; value < counts.size(); ++value) {
+                    cumulative += counts[value];
+                    tables[tile][value] = static_cast<unsigned char>((cumulative * 255 + pixels / 2) / pixels);
+                }
             }
+        }, 1);
+
+        // Neighboring regions and the weight of the right one, per column. Regions are centered on their pixels, and
+        // pixels past the outermost centers only use the outermost regions.
+        std::vector<int> left(width);
+        std::vector<int> right(width);
+        std::vector<float> right_weights(width);
+
+        float tile_width = static_cast<float>(width) / static_cast<float>(tiles_x);
+        for (int x = 0; x < width; ++x) {
+            float position = std::clamp((static_cast<float>(x) + 0.5f) / tile_width - 0.5f, 0.0f, static_cast<float>(tiles_x - 1));
+            left[x] = static_cast<int>(position);
+            right[x] = std::min(left[x] + 1, tiles_x - 1);
+            right_weights[x] = position - static_cast<float>(left[x]);
         }
 
-        // Update name.
-        std::string filename = get_output_directory() + "/" + im.file.name + "_grayscale." + im.file.extension;
+        float tile_height = static_cast<float>(height) / static_cast<float>(tiles_y);
+        unsigned char* data = im.get_data();
+
+        parallel_for_rows(height, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                float position = std::clamp((static_cast<float>(y) + 0.5f) / tile_height - 0.5f, 0.0f, static_cast<float>(tiles_y - 1));
+                int top = static_cast<int>(position);
+                int bottom = std::min(top + 1, tiles_y - 1);
+                float bottom_weight = position - static_cast<float>(top);
+
+                const std::array<unsigned char, 256>* top_tables = tables.data() + static_cast<std::size_t>(top) * tiles_x;
+                const std::array<unsigned char, 256>* bottom_tables = tables.data() + static_cast<std::size_t>(bottom) * tiles_x;
+                unsigned char* row = data + static_cast<std::size_t>(y) * width * channels;
+                const unsigned char* row_luma = luma.data() + static_cast<std::size_t>(y) * width;
+
+                for (int x = 0; x < width; ++x) {
+                    float weight = right_weights[x];
+                    unsigned char value = row_luma[x];
+
+                    float upper = (1.0f - weight) * top_tables[left[x]][value] + weight * top_tables[right[x]][value];
+                    float lower = (1.0f - weight) * bottom_tables[left[x]][value] + weight * bottom_tables[right[x]][value];
+                    auto target = static_cast<unsigned char>(std::nearbyint((1.0f - bottom_weight) * upper + bottom_weight * lower));
+
+                    // Gray values are their own luma.
+                    unsigned char* color = row + static_cast<std::size_t>(x) * channels;
+                    if (color_channels == 1) {
+                        color[0] = target;
+                    }
+                    else {
+                        scale_luma(color, value, target);
+                    }
+                }
+            }
+        });
+
+        // Update naming.
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "clahe" + '_' + std::to_string(tiles) + '_' + to_compact_string(clip_limit) + '.' + im.file.extension;
         im.file = file_data(filename);
 
         return *this;
     }
 
     processor &processor::to_lower_resolution(int x_resolution, int y_resolution) {
+        if (defer("to_lower_resolution(" + std::to_string(x_resolution) + ',' + std::to_string(y_resolution) + ')', [x_resolution, y_resolution](processor& p) { (void) p.to_lower_resolution(x_resolution, y_resolution); })) {
+            return *this;
+        }
+
+        IMG_TRACE_SCOPE("processor::to_lower_resolution");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
+
         int width = im.width;
         int height = im.height;
 
         // Invalid dimensions.
-        if (x_resolution < 0 || y_resolution < 0) {
+        if (x_resolution <= 0 || y_resolution <= 0) {
             std::cerr << "Invalid image dimensions passed to to_lower_resolution()." << std::endl;
             return *this;
         }
 
-        glm::vec4 data;
+        // Block averages come from the summed-area table, built once and shared with the source image. Pyramid
+        // levels are rounded at every level, and would not give exact averages.
+        std::shared_ptr<const summed_area_table> table = im.get_summed_area_table();
+
+        // Detach from shared data once, pixels are then written from multiple threads through the raw pointer.
+        unsigned char* pixels = im.get_data();
+        int channels = im.channels;
 
-        for (int y = 0; y <= height - y_resolution; y += y_resolution) {
-            for (int x = 0; x <= width - x_resolution; x += x_resolution) {
-                data = get_average_color(x, y, x_resolution, y_resolution);
+        int num_block_rows = (height + y_resolution - 1) / y_resolution;
 
-                // Fill pixel data to be the same color.
-                for (int j = 0; j < y_resolution; ++j) {
-                    for (int i = 0; i < x_resolution; ++i) {
-                        im.set_pixel(x + i, y + j, data);
+        parallel_for_rows(num_block_rows, [&](int first, int last) {
+            for (int row = first; row < last; ++row) {
+                int y = row * y_resolution;
+
+                // Blocks along the bottom and right side are smaller when the resolution doesn't divide evenly.
+                int block_height = std::min(y_resolution, height - y);
+
+                for (int x = 0; x < width; x += x_resolution) {
+                    int block_width = std::min(x_resolution, width - x);
+                    unsigned char color[4];
+                    convert_color(table->mean(x, y, block_width, block_height), channels, color);
+
+                    // Fill pixel data to be the same color.
+                    for (int j = 0; j < block_height; ++j) {
+                        unsigned char* row = pixels + (static_cast<std::size_t>(y + j) * width + x) * channels;
+
+                        for (int i = 0; i < block_width; ++i) {
+                            std::memcpy(row + i * channels, color, channels);
+                        }
                     }
                 }
             }
-        }
+        }, 1);
 
-        // In case resolution didn't divide evenly.
-        int x_remainder = width % x_resolution;
-        int y_remainder = height % y_resolution;
+        // Update naming.
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + std::to_string(x_resolution) + 'x' + std::to_string(y_resolution) + "px" + '.' + im.file.extension;
+        im.file = file_data(filename);
 
-        // Right side of image.
-        for (int y = 0; y < height - y_resolution; y += y_resolution) {
-            data = get_average_color(width - x_remainder, y, x_remainder, y_resolution);
+        return *this;
+    }
 
-            // Fill pixel data to be the same color.
-            for (int j = 0; j < y_resolution; ++j) {
-                for (int i = 0; i < x_remainder; ++i) {
-                    im.set_pixel(width - x_remainder + i, y + j, data);
-                }
-            }
+    processor &processor::resize(int width, int height, filter type) {
+        if (defer("resize(" + std::to_string(width) + ',' + std::to_string(height) + ',' + std::to_string(static_cast<int>(type)) + ')', [width, height, type](processor& p) { (void) p.resize(width, height, type); })) {
+            return *this;
         }
 
-        // Bottom side of image.
-        for (int x = 0; x < width - x_resolution; x += x_resolution) {
-            data = get_average_color(x, height - y_remainder, x_resolution, y_remainder);
+        IMG_TRACE_SCOPE("processor::resize");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-            // Fill pixel data to be the same color.
-            for (int j = 0; j < y_remainder; ++j) {
-                for (int i = 0; i < x_resolution; ++i) {
-                    im.set_pixel(x + i, height - y_remainder + j, data);
-                }
-            }
+        // Invalid dimensions.
+        if (width <= 0 || height <= 0) {
+            std::cerr << "Invalid image dimensions passed to resize()." << std::endl;
+            return *this;
         }
 
-        // Bottom right corner.
-        data = get_average_color(width - x_remainder, height - y_remainder, x_remainder, y_remainder);
+        // Start from the smallest pyramid level that is still at least as large as the result.
+        int level = 0;
+        int level_width = im.width;
+        int level_height = im.height;
 
-        // Fill pixel data to be the same color.
-        for (int j = 0; j < y_remainder; ++j) {
-            for (int i = 0; i < x_remainder; ++i) {
-                im.set_pixel(width - x_remainder + i, height - y_remainder + j, data);
-            }
+        while (level + 1 < im.get_pyramid_level_count() && (level_width + 1) / 2 >= width && (level_height + 1) / 2 >= height) {
+            level_width = (level_width + 1) / 2;
+            level_height = (level_height + 1) / 2;
+            ++level;
         }
 
+        std::shared_ptr<const image> source = im.get_pyramid_level(level);
+        image resized(im.file.path, width, height, im.channels);
+
+        resampler sampler(source->width, source->height, width, height, type);
+        sampler.resample(source->data, resized.data, im.channels);
+
+        im = std::move(resized);
+
         // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + std::to_string(x_resolution) + 'x' + std::to_string(y_resolution) + "px" + '.' + im.file.extension;
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "resize" + '_' + std::to_string(width) + 'x' + std::to_string(height) + '.' + im.file.extension;
         im.file = file_data(filename);
 
         return *this;
     }
 
-    std::string processor::to_ascii(int resolution) {
-        int width = im.width;
-        int height = im.height;
-
-        // TODO: user-defined sequence.
-        std::vector<char> sequence{'@', '%', '#', '*', '+', '=', '-', ':', '.'};
-        std::size_t num_characters = sequence.size();
-        std::string ascii;
-
-        processor copy = *this;
+    std::string processor::to_ascii(int resolution, const std::string& ramp, bool equalize) {
+        execute();
 
-        image lower_resolution_image = processor(im).to_lower_resolution(resolution, resolution).get();
+        IMG_TRACE_SCOPE("processor::to_ascii");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-        for (int y = 0; y < height; y += 2 * resolution) {
-            for (int x = 0; x < width; x += resolution) {
-                pixel pixel = lower_resolution_image.get_pixel(x, y);
-                ascii += sequence[static_cast<int>((static_cast<float>(pixel.r) / 255.0f *
-                                                    static_cast<float>(num_characters)))];
-            }
+        // Invalid resolution.
+        if (resolution <= 0) {
+            std::cerr << "Invalid resolution passed to to_ascii()." << std::endl;
+            return {};
+        }
 
-            ascii += '\n';
+        // Maps block luma to characters of the ramp.
+        ascii_renderer renderer(resolution, ramp);
+        if (equalize) {
+            renderer.set_ramp(ramp, im.get_histogram()->get_luma());
         }
 
-        return ascii;
+        return renderer.render(im);
     }
 
     processor &processor::k_means(int k, bool maintain_alpha) {
+        if (defer(get_random_key("k_means", std::to_string(k) + ',' + std::to_string(maintain_alpha)), [k, maintain_alpha](processor& p) { (void) p.k_means(k, maintain_alpha); })) {
+            return *this;
+        }
+
+        IMG_TRACE_SCOPE("processor::k_means");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
+
+        // Statistics of a previous run no longer describe the image.
+        k_means_statistics.reset();
+
+        // Invalid cluster count.
+        if (k <= 0) {
+            std::cerr << "Invalid k passed to k_means()." << std::endl;
+            return *this;
+        }
+
         int width = im.width;
         int height = im.height;
 
+        k_means_result result;
+        result.k = k;
+
+        auto start = std::chrono::steady_clock::now();
+
         // pixel mapped to ID of centroid.
         std::vector<int> cluster_ids;
         cluster_ids.resize(width * height, -1);
 
-        // Get all unique colors.
-        std::unordered_set<glm::vec3> unique_colors;
+        std::vector<glm::vec3> centroids;
 
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                unique_colors.emplace(im.get_pixel(x, y));
-            }
+        {
+            IMG_TRACE_SCOPE("k_means::unique_colors");
+            centroids = seed_centroids(k);
         }
 
-        // Generate k random centroids.
-        std::vector<glm::vec3> centroids;
-        for (int i = 0; i < k; ++i) {
-            int index = uniform_distribution(0, static_cast<int>(unique_colors.size()));
-            centroids.emplace_back(*std::next(unique_colors.begin(), index));
-        }
+        result.unique_colors_time = get_milliseconds_since(start);
+
+        // Run k-means clustering, until an assignment pass no longer changes any cluster.
+        while (true) {
+            start = std::chrono::steady_clock::now();
+            std::uint64_t reassignments = assign_cluster_ids(centroids, cluster_ids, result.inertia);
+            result.assignment_time += get_milliseconds_since(start);
 
-        // Run k-means clustering.
-        while (assign_cluster_ids(centroids, cluster_ids)) {
+            ++result.iterations;
+            result.reassignments.emplace_back(reassignments);
+            result.distance_evaluations += static_cast<std::uint64_t>(width) * height * centroids.size();
+
+            if (reassignments == 0) {
+                break;
+            }
+
+            IMG_TRACE_COUNTER("k_means_iterations", 1);
+
+            start = std::chrono::steady_clock::now();
             update_centroids(centroids, cluster_ids);
+            result.update_time += get_milliseconds_since(start);
         }
 
         // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
+        {
+            IMG_TRACE_SCOPE("k_means::write_back");
+            start = std::chrono::steady_clock::now();
+
+            // Detach from shared data once, pixels are then written from multiple threads through the raw pointer.
+            unsigned char* pixels = im.get_data();
+            int channels = im.channels;
+            bool keep_alpha = maintain_alpha && (channels == 2 || channels == 4);
+
+            // Centroid colors, converted to the channels of the image once.
+            std::vector<unsigned char> colors(centroids.size() * channels);
+            for (std::size_t i = 0; i < centroids.size(); ++i) {
+                convert_color(glm::vec4(centroids[i], 255.0f), channels, colors.data() + i * channels);
+            }
+
+            parallel_for_rows(height, [&](int first, int last) {
+                for (int y = first; y < last; ++y) {
+                    for (int x = 0; x < width; ++x) {
+                        int index = x + width * y;
 
-                int cluster_id = cluster_ids[index];
-                assert(cluster_id >= 0); // Check cluster ID validity.
-                const glm::vec3& color = centroids[cluster_id];
+                        int cluster_id = cluster_ids[index];
+                        assert(cluster_id >= 0); // Check cluster ID validity.
 
-                // Update color.
-                unsigned alpha = 255;
-                if (maintain_alpha) {
-                    alpha = im.get_pixel(x, y).a;
+                        // Update color.
+                        unsigned char* address = pixels + static_cast<std::size_t>(index) * channels;
+                        unsigned char alpha = address[channels - 1];
+
+                        std::memcpy(address, colors.data() + static_cast<std::size_t>(cluster_id) * channels, channels);
+
+                        if (keep_alpha) {
+                            address[channels - 1] = alpha;
+                        }
+                    }
                 }
+            });
 
-                im.set_pixel(x, y, glm::vec4(color, alpha));
-            }
+            result.write_time = get_milliseconds_since(start);
         }
 
+        result.centroids = std::move(centroids);
+        k_means_statistics = std::move(result);
+
         // Update naming.
         std::string filename = get_output_directory() + "/" + im.file.name + '_' + "k_means" + '_' + std::to_string(k) + '.' + im.file.extension;
         im.file = file_data(filename);
@@ -197,894 +514,1016 @@ namespace img {
         return *this;
     }
 
+    const std::optional<k_means_result> &processor::get_k_means_result() const {
+        execute();
+        return k_means_statistics;
+    }
+
     processor &processor::dither_error_diffusion() {
-        glm::vec4 next_pixel_error = glm::vec4(0.0f);
-        int height = im.height;
-        int width = im.width;
+        if (defer("dither_error_diffusion", [](processor& p) { (void) p.dither_error_diffusion(); })) {
+            return *this;
+        }
 
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
+        return dither(diffusion_matrix::basic, "dither_error_diffusion");
+    }
 
-        glm::vec4 value;
+    processor &processor::dither_floyd_steinberg() {
+        if (defer("dither_floyd_steinberg", [](processor& p) { (void) p.dither_floyd_steinberg(); })) {
+            return *this;
+        }
 
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
+        return dither(diffusion_matrix::floyd_steinberg, "dither_floyd_steinberg");
+    }
 
-                // Diffuse error.
-                value += next_pixel_error;
+    processor &processor::dither_false_floyd_steinberg() {
+        if (defer("dither_false_floyd_steinberg", [](processor& p) { (void) p.dither_false_floyd_steinberg(); })) {
+            return *this;
+        }
 
-                // For next iteration.
-                next_pixel_error = skew_direction(value);
-                dithered[index] = value;
-            }
+        return dither(diffusion_matrix::false_floyd_steinberg, "dither_false_floyd_steinberg");
+    }
 
-            // Discard error after processing one line.
-            next_pixel_error = glm::vec4(0.0f);
+    processor &processor::dither_jarvis_judice_ninke() {
+        if (defer("dither_jarvis_judice_ninke", [](processor& p) { (void) p.dither_jarvis_judice_ninke(); })) {
+            return *this;
         }
 
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
-            }
+        return dither(diffusion_matrix::jarvis_judice_ninke, "dither_jarvis_judice_ninke");
+    }
+
+    processor &processor::dither_stucki() {
+        if (defer("dither_stucki", [](processor& p) { (void) p.dither_stucki(); })) {
+            return *this;
         }
 
-        // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_error_diffusion" + '.' + im.file.extension;
-        im.file = file_data(filename);
+        return dither(diffusion_matrix::stucki, "dither_stucki");
+    }
 
-        return *this;
+    processor &processor::dither_atkinson() {
+        if (defer("dither_atkinson", [](processor& p) { (void) p.dither_atkinson(); })) {
+            return *this;
+        }
+
+        return dither(diffusion_matrix::atkinson, "dither_atkinson");
     }
 
-    processor &processor::dither_floyd_steinberg() {
-        int height = im.height;
-        int width = im.width;
+    processor &processor::dither_burkes() {
+        if (defer("dither_burkes", [](processor& p) { (void) p.dither_burkes(); })) {
+            return *this;
+        }
 
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
+        return dither(diffusion_matrix::burkes, "dither_burkes");
+    }
 
-        glm::vec4 pixel_error = glm::vec4(0.0f);
+    processor &processor::dither_sierra() {
+        if (defer("dither_sierra", [](processor& p) { (void) p.dither_sierra(); })) {
+            return *this;
+        }
 
-        // Floyd-Steinberg requires storage for the error values being applied on the next row.
-        std::vector<glm::vec4> row_error;
-        row_error.resize(width, glm::vec4(0.0f));
+        return dither(diffusion_matrix::sierra, "dither_sierra");
+    }
 
-        std::vector<glm::vec4> next_row_error;
-        next_row_error.resize(width, glm::vec4(0.0f));
+    processor &processor::dither_two_row_sierra() {
+        if (defer("dither_two_row_sierra", [](processor& p) { (void) p.dither_two_row_sierra(); })) {
+            return *this;
+        }
 
-        glm::vec4 value;
+        return dither(diffusion_matrix::two_row_sierra, "dither_two_row_sierra");
+    }
+
+    processor &processor::dither_sierra_lite() {
+        if (defer("dither_sierra_lite", [](processor& p) { (void) p.dither_sierra_lite(); })) {
+            return *this;
+        }
+
+        return dither(diffusion_matrix::sierra_lite, "dither_sierra_lite");
+    }
 
-        // Floyd-Steinberg dithering matrix:
-        //           X    7/16      <- next pixel error
-        //    3/16  5/16  1/16      <- next row error (accumulated)
-        float next = 7.0f / 16.0f;
-        float row1 = 3.0f / 16.0f;
-        float row2 = 5.0f / 16.0f;
-        float row3 = 1.0f / 16.0f;
 
-        for (int y = 0; y < height - 1; ++y) {
-            // Ensure valid bounds.
-            for (int x = 1; x < width - 1; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
+    processor &processor::dither_bayer(int matrix_width, int matrix_height) {
+        return apply(bayer_operation(matrix_width, matrix_height));
+    }
 
-                // Apply error from previous pixel in current row and diffused error from the above row.
-                value += (pixel_error + row_error[x]);
+    bitmap processor::dither_to_bitmap(diffusion_matrix matrix) const {
+        execute();
 
-                glm::vec4 unscaled_error = skew_direction(value);
-                dithered[index] = value;
+        IMG_TRACE_SCOPE("processor::dither_to_bitmap");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-                // Error calculations.
-                pixel_error = next * unscaled_error;
-                next_row_error[x - 1] += row1 * unscaled_error;
-                next_row_error[x + 0] += row2 * unscaled_error;
-                next_row_error[x + 1] += row3 * unscaled_error;
-            }
+        const image& source = im;
+        int width = source.width;
+        int height = source.height;
+        int channels = source.channels;
+        const unsigned char* data = source.get_data();
 
-            // Discard next pixel error after processing one line.
-            pixel_error = glm::vec4(0.0f);
+        bitmap result(get_output_directory() + "/" + source.file.name + "_dither_" + to_string(matrix) + ".png", width, height);
 
-            // Update next row error to apply to the next row.
-            row_error = next_row_error;
-            for (int i = 0; i < width; ++i) {
-                next_row_error[i] = glm::vec4(0.0f);
-            }
-        }
+        error_diffuser diffuser(matrix, width, height);
+        std::vector<unsigned char> row(static_cast<std::size_t>(width) * 4);
 
-        // Write resulting colors back to image.
         for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
-            }
+            unpack_rgba(data + static_cast<std::size_t>(y) * width * channels, channels, row.data(), width);
+            diffuser.dither_row(y, row.data());
+            result.pack_row(y, row.data(), 4);
         }
 
-        // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_floyd_steinberg" + '.' + im.file.extension;
-        im.file = file_data(filename);
-
-        return *this;
+        return result;
     }
 
-    processor &processor::dither_false_floyd_steinberg() {
-        int height = im.height;
-        int width = im.width;
+    bitmap processor::dither_bayer_to_bitmap(int matrix_width, int matrix_height) const {
+        execute();
+
+        IMG_TRACE_SCOPE("processor::dither_bayer_to_bitmap");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
+        const image& source = im;
+        int width = source.width;
+        int channels = source.channels;
+        const unsigned char* data = source.get_data();
 
-        glm::vec4 pixel_error = glm::vec4(0.0f);
+        point_operation operation = bayer_operation(matrix_width, matrix_height);
+        bitmap result(get_output_directory() + "/" + source.file.name + operation.suffix + ".png", width, source.height);
 
-        // Floyd-Steinberg requires storage for the error values being applied on the next row.
-        std::vector<glm::vec4> row_error;
-        row_error.resize(width, glm::vec4(0.0f));
+        parallel_for_rows(source.height, [&](int first, int last) {
+            std::vector<unsigned char> row(static_cast<std::size_t>(width) * 4);
 
-        std::vector<glm::vec4> next_row_error;
-        next_row_error.resize(width, glm::vec4(0.0f));
+            for (int y = first; y < last; ++y) {
+                unpack_rgba(data + static_cast<std::size_t>(y) * width * channels, channels, row.data(), width);
+                operation.function(row.data(), width, 0, y);
+                result.pack_row(y, row.data(), 4);
+            }
+        });
 
-        glm::vec4 value;
+        return result;
+    }
 
-        // Floyd-Steinberg dithering matrix:
-        //   X   3/8      <- next pixel error
-        //  3/8  2/8      <- next row error (accumulated)
-        float next = 3.0f / 8.0f;
-        float row1 = 3.0f / 8.0f;
-        float row2 = 2.0f / 8.0f;
+    bitmap processor::to_bitmap() const {
+        execute();
 
-        for (int y = 0; y < height - 1; ++y) {
-            // Ensure valid bounds.
-            for (int x = 0; x < width - 1; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
+        IMG_TRACE_SCOPE("processor::to_bitmap");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-                // Apply error from previous pixel in current row and diffused error from the above row.
-                value += (pixel_error + row_error[x]);
+        const image& source = im;
+        int width = source.width;
+        int channels = source.channels;
+        const unsigned char* data = source.get_data();
 
-                glm::vec4 unscaled_error = skew_direction(value);
-                dithered[index] = value;
+        bitmap result(get_output_directory() + "/" + source.file.name + ".png", width, source.height);
 
-                // Error calculations.
-                pixel_error = next * unscaled_error;
-                next_row_error[x + 0] += row1 * unscaled_error;
-                next_row_error[x + 1] += row2 * unscaled_error;
+        parallel_for_rows(source.height, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                result.pack_row(y, data + static_cast<std::size_t>(y) * width * channels, channels);
             }
+        });
 
-            // Discard next pixel error after processing one line.
-            pixel_error = glm::vec4(0.0f);
+        return result;
+    }
 
-            // Update next row error to apply to the next row.
-            row_error = next_row_error;
-            for (int i = 0; i < width; ++i) {
-                next_row_error[i] = glm::vec4(0.0f);
-            }
+    processor &processor::voronoi(int num_regions) {
+        if (defer(get_random_key("voronoi", std::to_string(num_regions)), [num_regions](processor& p) { (void) p.voronoi(num_regions); })) {
+            return *this;
         }
 
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
-            }
+        IMG_TRACE_SCOPE("processor::voronoi");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
+
+        // Invalid region count.
+        if (num_regions <= 0) {
+            std::cerr << "Invalid number of regions passed to voronoi()." << std::endl;
+            return *this;
+        }
+
+        int height = im.height;
+        int width = im.width;
+
+        voronoi_diagram diagram(im);
+
+        for (int i = 0; i < num_regions; ++i) {
+            diagram.add_region(uniform_distribution(glm::vec2(0, 0), glm::vec2(width, height)));
         }
 
+        // Apply average color for each region to output image.
+        diagram.apply(im);
+
         // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_false_floyd_steinberg" + '.' + im.file.extension;
-        im.file = file_data(filename);
+        im.file = file_data(get_voronoi_filename(num_regions));
 
         return *this;
     }
 
-    processor &processor::dither_jarvis_judice_ninke() {
+    std::vector<image> processor::voronoi_sweep(const std::vector<int>& region_counts) const {
+        execute();
+
+        IMG_TRACE_SCOPE("processor::voronoi_sweep");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
+
+        for (int num_regions : region_counts) {
+            // Invalid region count.
+            if (num_regions <= 0) {
+                std::cerr << "Invalid number of regions passed to voronoi_sweep()." << std::endl;
+                return { };
+            }
+        }
+
         int height = im.height;
         int width = im.width;
 
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
-
-        // Algorithm requires storage for the error values being applied on the two next rows.
-        std::vector<glm::vec4> error;
-        error.resize(width * height, glm::vec4(0.0f));
-
-        // Jarvis-Judice-Ninke dithering matrix:
-        //               X    7/48  5/48
-        //  3/48  5/48  7/48  5/48  3/48
-        //  1/48  3/48  5/48  3/48  1/48
-        float error1 = 1.0f / 48.0f;
-        float error3 = 3.0f / 48.0f;
-        float error5 = 5.0f / 48.0f;
-        float error7 = 7.0f / 48.0f;
-
-        glm::vec4 value;
-
-        for (int y = 0; y < height - 2; ++y) {
-            // Ensure valid bounds.
-            for (int x = 2; x < width - 2; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
-                value += error[index];
-
-                glm::vec4 unscaled_error = skew_direction(value);
-
-                // Propagate error to neighboring cells based on error propagation matrix.
-                error[(x + 1) + width * (y + 0)] += error7 * unscaled_error;
-                error[(x + 2) + width * (y + 0)] += error5 * unscaled_error;
-
-                error[(x - 2) + width * (y + 1)] += error3 * unscaled_error;
-                error[(x - 1) + width * (y + 1)] += error5 * unscaled_error;
-                error[(x - 0) + width * (y + 1)] += error7 * unscaled_error;
-                error[(x + 1) + width * (y + 1)] += error5 * unscaled_error;
-                error[(x + 2) + width * (y + 1)] += error3 * unscaled_error;
-
-                error[(x - 2) + width * (y + 2)] += error1 * unscaled_error;
-                error[(x - 1) + width * (y + 2)] += error3 * unscaled_error;
-                error[(x - 0) + width * (y + 2)] += error5 * unscaled_error;
-                error[(x + 1) + width * (y + 2)] += error3 * unscaled_error;
-                error[(x + 2) + width * (y + 2)] += error1 * unscaled_error;
-
-                dithered[index] = value;
+        // Visit requested diagrams from smallest to largest so that each one only adds regions to the previous one.
+        std::vector<std::size_t> order(region_counts.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&region_counts](std::size_t first, std::size_t second) {
+            return region_counts[first] < region_counts[second];
+        });
+
+        std::vector<image> diagrams(region_counts.size(), im);
+        voronoi_diagram diagram(im);
+
+        for (std::size_t index : order) {
+            int num_regions = region_counts[index];
+
+            while (static_cast<int>(diagram.centers.size()) < num_regions) {
+                diagram.add_region(uniform_distribution(glm::vec2(0, 0), glm::vec2(width, height)));
             }
+
+            image& output = diagrams[index];
+            diagram.apply(output);
+            output.file = file_data(get_voronoi_filename(num_regions));
         }
 
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
-            }
+        return diagrams;
+    }
+
+    processor &processor::gaussian_blur(float sigma, border_mode border) {
+        if (defer("gaussian_blur(" + std::to_string(sigma) + ',' + std::to_string(static_cast<int>(border)) + ')', [sigma, border](processor& p) { (void) p.gaussian_blur(sigma, border); })) {
+            return *this;
         }
 
+        IMG_TRACE_SCOPE("processor::gaussian_blur");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
+
+        // Invalid standard deviation.
+        if (sigma <= 0.0f) {
+            std::cerr << "Invalid sigma passed to gaussian_blur()." << std::endl;
+            return *this;
+        }
+
+        std::vector<float> weights = get_gaussian_kernel(sigma);
+        convolver blur(weights, weights, border);
+
+        image result(im.file.path, im.width, im.height, im.channels);
+        blur.convolve(im.data, result.data, im.width, im.height, im.channels);
+        im = std::move(result);
+
         // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_jarvis_judice_ninke" + '.' + im.file.extension;
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "gaussian_blur" + '_' + to_compact_string(sigma) + '.' + im.file.extension;
         im.file = file_data(filename);
 
         return *this;
     }
 
-    processor &processor::dither_stucki() {
-        int height = im.height;
-        int width = im.width;
-
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
-
-        // Algorithm requires storage for the error values being applied on the two next rows.
-        std::vector<glm::vec4> error;
-        error.resize(width * height, glm::vec4(0.0f));
-
-        // Stucki dithering matrix:
-        //               X    8/42  4/42
-        //  2/42  4/42  8/42  4/42  2/42
-        //  1/42  2/42  4/42  2/42  1/42
-        float error1 = 1.0f / 42.0f;
-        float error2 = 2.0f / 42.0f;
-        float error4 = 4.0f / 42.0f;
-        float error8 = 8.0f / 42.0f;
-
-        glm::vec4 value;
-
-        for (int y = 0; y < height - 2; ++y) {
-            // Ensure valid bounds.
-            for (int x = 2; x < width - 2; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
-                value += error[index];
-
-                glm::vec4 unscaled_error = skew_direction(value);
-
-                // Propagate error to neighboring cells based on error propagation matrix.
-                error[(x + 1) + width * (y + 0)] += error8 * unscaled_error;
-                error[(x + 2) + width * (y + 0)] += error4 * unscaled_error;
-
-                error[(x - 2) + width * (y + 1)] += error2 * unscaled_error;
-                error[(x - 1) + width * (y + 1)] += error4 * unscaled_error;
-                error[(x - 0) + width * (y + 1)] += error8 * unscaled_error;
-                error[(x + 1) + width * (y + 1)] += error4 * unscaled_error;
-                error[(x + 2) + width * (y + 1)] += error2 * unscaled_error;
-
-                error[(x - 2) + width * (y + 2)] += error1 * unscaled_error;
-                error[(x - 1) + width * (y + 2)] += error2 * unscaled_error;
-                error[(x - 0) + width * (y + 2)] += error4 * unscaled_error;
-                error[(x + 1) + width * (y + 2)] += error2 * unscaled_error;
-                error[(x + 2) + width * (y + 2)] += error1 * unscaled_error;
-
-                dithered[index] = value;
-            }
+    processor &processor::box_blur(int radius, border_mode border) {
+        if (defer("box_blur(" + std::to_string(radius) + ',' + std::to_string(static_cast<int>(border)) + ')', [radius, border](processor& p) { (void) p.box_blur(radius, border); })) {
+            return *this;
         }
 
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
-            }
+        IMG_TRACE_SCOPE("processor::box_blur");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
+
+        // Invalid radius.
+        if (radius <= 0) {
+            std::cerr << "Invalid radius passed to box_blur()." << std::endl;
+            return *this;
         }
 
+        image result(im.file.path, im.width, im.height, im.channels);
+        img::box_blur(im.data, result.data, im.width, im.height, im.channels, radius, border);
+        im = std::move(result);
+
         // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_stucki" + '.' + im.file.extension;
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "box_blur" + '_' + std::to_string(radius) + '.' + im.file.extension;
         im.file = file_data(filename);
 
         return *this;
     }
 
-    processor &processor::dither_atkinson() {
-        int height = im.height;
-        int width = im.width;
-
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
-
-        // Algorithm requires storage for the error values being applied on the two next rows.
-        std::vector<glm::vec4> error;
-        error.resize(width * height, glm::vec4(0.0f));
+    processor &processor::unsharp_mask(float sigma, float amount, int threshold, border_mode border) {
+        if (defer("unsharp_mask(" + std::to_string(sigma) + ',' + std::to_string(amount) + ',' + std::to_string(threshold) + ',' + std::to_string(static_cast<int>(border)) + ')', [sigma, amount, threshold, border](processor& p) { (void) p.unsharp_mask(sigma, amount, threshold, border); })) {
+            return *this;
+        }
 
-        // Stucki dithering matrix:
-        //        X   1/8  1/8
-        //  1/8  1/8  1/8
-        //       1/8
-        float error1 = 1.0f / 8.0f;
+        IMG_TRACE_SCOPE("processor::unsharp_mask");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-        glm::vec4 value;
+        // Invalid parameters.
+        if (sigma <= 0.0f || amount < 0.0f || threshold < 0) {
+            std::cerr << "Invalid parameters passed to unsharp_mask()." << std::endl;
+            return *this;
+        }
 
-        for (int y = 0; y < height - 2; ++y) {
-            // Ensure valid bounds.
-            for (int x = 2; x < width - 2; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
-                value += error[index];
+        int width = im.width;
+        int channels = im.channels;
+        int color_channels = channels == 2 || channels == 4 ? channels - 1 : channels;
 
-                glm::vec4 unscaled_error = skew_direction(value);
+        std::vector<float> weights = get_gaussian_kernel(sigma);
+        convolver blur(weights, weights, border);
 
-                // Propagate error to neighboring cells based on error propagation matrix.
-                error[(x + 1) + width * (y + 0)] += error1 * unscaled_error;
-                error[(x + 2) + width * (y + 0)] += error1 * unscaled_error;
+        image blurred(im.file.path, width, im.height, channels);
+        blur.convolve(im.data, blurred.data, width, im.height, channels);
 
-                error[(x - 1) + width * (y + 1)] += error1 * unscaled_error;
-                error[(x - 0) + width * (y + 1)] += error1 * unscaled_error;
-                error[(x + 1) + width * (y + 1)] += error1 * unscaled_error;
+        // Sharpened in place, the blurred copy holds everything that is read.
+        unsigned char* data = im.get_data();
 
-                error[(x - 0) + width * (y + 2)] += error1 * unscaled_error;
+        parallel_for_rows(im.height, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                std::size_t offset = static_cast<std::size_t>(y) * width * channels;
 
-                dithered[index] = value;
-            }
-        }
-
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
+                for (int x = 0; x < width; ++x) {
+                    for (int c = 0; c < color_channels; ++c) {
+                        std::size_t index = offset + static_cast<std::size_t>(x) * channels + c;
+                        int difference = data[index] - blurred.data[index];
+
+                        if (std::abs(difference) >= threshold) {
+                            float value = static_cast<float>(data[index]) + amount * static_cast<float>(difference);
+                            data[index] = static_cast<unsigned char>(std::clamp(std::nearbyint(value), 0.0f, 255.0f));
+                        }
+                    }
+                }
             }
-        }
+        });
 
         // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_atkinson" + '.' + im.file.extension;
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "unsharp_mask" + '_' + to_compact_string(sigma) + '_' + to_compact_string(amount) + '_' + std::to_string(threshold) + '.' + im.file.extension;
         im.file = file_data(filename);
 
         return *this;
     }
 
-    processor &processor::dither_burkes() {
-        int height = im.height;
-        int width = im.width;
-
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
-
-        // Algorithm requires storage for the error values being applied on the two next rows.
-        std::vector<glm::vec4> error;
-        error.resize(width * height, glm::vec4(0.0f));
+    processor &processor::detect_edges() {
+        if (defer("detect_edges", [](processor& p) { (void) p.detect_edges(); })) {
+            return *this;
+        }
 
-        // Burkes dithering matrix:
-        //               X    8/32  4/32
-        //  2/32  4/32  8/32  4/32  2/32
-        float error2 = 2.0f / 32.0f;
-        float error4 = 4.0f / 32.0f;
-        float error8 = 8.0f / 32.0f;
+        IMG_TRACE_SCOPE("processor::detect_edges");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-        glm::vec4 value;
+        int width = im.width;
+        int height = im.height;
+        int channels = im.channels;
+        std::size_t row_size = static_cast<std::size_t>(width) * channels;
 
-        for (int y = 0; y < height - 2; ++y) {
-            // Ensure valid bounds.
-            for (int x = 2; x < width - 2; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
-                value += error[index];
+        // Offset of the horizontal neighbors, the only pixel of one pixel wide rows is its own neighbor.
+        std::size_t step = width > 1 ? channels : 0;
 
-                glm::vec4 unscaled_error = skew_direction(value);
+        // Sobel operators, separable into a derivative along one axis and smoothing along the other. Both horizontal
+        // passes of row 'y' (clamped to the image): differences of the neighbors and their sum with the doubled pixel.
+        auto filter_row = [&](int y, int* differences, int* sums) {
+            const unsigned char* row = im.data + static_cast<std::size_t>(std::clamp(y, 0, height - 1)) * row_size;
 
-                // Propagate error to neighboring cells based on error propagation matrix.
-                error[(x + 1) + width * (y + 0)] += error8 * unscaled_error;
-                error[(x + 2) + width * (y + 0)] += error4 * unscaled_error;
+            auto filter = [&](std::size_t i, std::size_t left, std::size_t right) {
+                differences[i] = row[right] - row[left];
+                sums[i] = row[left] + 2 * row[i] + row[right];
+            };
 
-                error[(x - 2) + width * (y + 1)] += error2 * unscaled_error;
-                error[(x - 1) + width * (y + 1)] += error4 * unscaled_error;
-                error[(x - 0) + width * (y + 1)] += error8 * unscaled_error;
-                error[(x + 1) + width * (y + 1)] += error4 * unscaled_error;
-                error[(x + 2) + width * (y + 1)] += error2 * unscaled_error;
+            for (std::size_t i = 0; i < static_cast<std::size_t>(channels); ++i) {
+                filter(i, i, i + step);
+            }
 
-                dithered[index] = value;
+            for (std::size_t i = channels; i + channels < row_size; ++i) {
+                filter(i, i - channels, i + channels);
             }
-        }
 
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
+            for (std::size_t i = row_size - step; i < row_size; ++i) {
+                filter(i, i - step, i);
             }
-        }
+        };
+
+        image result(im.file.path, width, height, channels);
+
+        parallel_for_rows(height, [&](int first, int last) {
+            // Horizontal passes of the three rows around the current one, reused as the band moves down.
+            std::vector<int> differences(3 * row_size);
+            std::vector<int> sums(3 * row_size);
+
+            auto slot = [&](int y) {
+                return static_cast<std::size_t>((y - first + 1) % 3) * row_size;
+            };
+
+            filter_row(first - 1, differences.data() + slot(first - 1), sums.data() + slot(first - 1));
+            filter_row(first, differences.data() + slot(first), sums.data() + slot(first));
+
+            for (int y = first; y < last; ++y) {
+                filter_row(y + 1, differences.data() + slot(y + 1), sums.data() + slot(y + 1));
+
+                const int* above = differences.data() + slot(y - 1);
+                const int* center = differences.data() + slot(y);
+                const int* below = differences.data() + slot(y + 1);
+                const int* sums_above = sums.data() + slot(y - 1);
+                const int* sums_below = sums.data() + slot(y + 1);
+                unsigned char* output = result.data + static_cast<std::size_t>(y) * row_size;
+
+                for (std::size_t i = 0; i < row_size; ++i) {
+                    // Gradients are within [-1020, 1020], their squares are exact in single precision.
+                    auto x_gradient = static_cast<float>(above[i] + 2 * center[i] + below[i]);
+                    auto y_gradient = static_cast<float>(sums_below[i] - sums_above[i]);
+                    float magnitude = std::sqrt(x_gradient * x_gradient + y_gradient * y_gradient);
+                    output[i] = static_cast<unsigned char>(std::min(std::nearbyint(magnitude), 255.0f));
+                }
+            }
+        });
+
+        copy_alpha(im, result);
+        im = std::move(result);
 
         // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_burkes" + '.' + im.file.extension;
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "edges" + '.' + im.file.extension;
         im.file = file_data(filename);
 
         return *this;
     }
 
-    processor &processor::dither_sierra() {
-        int height = im.height;
-        int width = im.width;
+    processor &processor::convolve(const convolver &kernel, const std::string &name) {
+        if (defer("convolve(" + name + ',' + kernel.get_key() + ')', [kernel, name](processor& p) { (void) p.convolve(kernel, name); })) {
+            return *this;
+        }
 
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
+        IMG_TRACE_SCOPE("processor::convolve");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-        // Algorithm requires storage for the error values being applied on the two next rows.
-        std::vector<glm::vec4> error;
-        error.resize(width * height, glm::vec4(0.0f));
+        image result(im.file.path, im.width, im.height, im.channels);
+        kernel.convolve(im.data, result.data, im.width, im.height, im.channels);
+        im = std::move(result);
 
-        // Sierra dithering matrix:
-        //               X    5/32  3/32
-        //  2/32  4/32  5/32  4/32  2/32
-        //        2/32  3/32  2/32
-        float error2 = 2.0f / 32.0f;
-        float error3 = 3.0f / 32.0f;
-        float error4 = 4.0f / 32.0f;
-        float error5 = 5.0f / 32.0f;
+        // Update naming.
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + name + '.' + im.file.extension;
+        im.file = file_data(filename);
+
+        return *this;
+    }
+
+    processor &processor::apply(point_operation operation) {
+        if (mode == execution::deferred) {
+            std::string key = operation.key;
+            pending.push_back({ std::move(operation), { }, std::move(key) });
+        }
+        else {
+            execute({ std::move(operation) });
+        }
 
-        glm::vec4 value;
+        return *this;
+    }
 
-        for (int y = 0; y < height - 2; ++y) {
-            // Ensure valid bounds.
-            for (int x = 2; x < width - 2; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
-                value += error[index];
+    bool processor::defer(std::string key, std::function<void(processor&)> run) {
+        if (mode != execution::deferred) {
+            return false;
+        }
 
-                glm::vec4 unscaled_error = skew_direction(value);
+        pending.push_back({ std::nullopt, std::move(run), std::move(key) });
+        return true;
+    }
 
-                // Propagate error to neighboring cells based on error propagation matrix.
-                error[(x + 1) + width * (y + 0)] += error5 * unscaled_error;
-                error[(x + 2) + width * (y + 0)] += error3 * unscaled_error;
+    void processor::execute() const {
+        if (pending.empty()) {
+            return;
+        }
 
-                error[(x - 2) + width * (y + 1)] += error2 * unscaled_error;
-                error[(x - 1) + width * (y + 1)] += error4 * unscaled_error;
-                error[(x - 0) + width * (y + 1)] += error5 * unscaled_error;
-                error[(x + 1) + width * (y + 1)] += error4 * unscaled_error;
-                error[(x + 2) + width * (y + 1)] += error2 * unscaled_error;
+        std::vector<operation> operations = std::move(pending);
+        pending.clear();
 
-                error[(x - 1) + width * (y + 2)] += error2 * unscaled_error;
-                error[(x - 0) + width * (y + 2)] += error3 * unscaled_error;
-                error[(x + 1) + width * (y + 2)] += error2 * unscaled_error;
+        IMG_TRACE_SCOPE("processor::execute");
 
-                dithered[index] = value;
-            }
+        std::shared_ptr<result_cache> cache = get_result_cache();
+        if (!cache) {
+            run(operations);
+            return;
         }
 
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
+        std::string chain;
+        bool runs_k_means = false;
+
+        for (const operation& op : operations) {
+            // Results that cannot be reproduced are not cached.
+            if (op.key.empty()) {
+                run(operations);
+                return;
             }
+
+            chain += op.key + ';';
+            runs_k_means = runs_k_means || op.key.compare(0, 8, "k_means(") == 0;
         }
 
-        // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_sierra" + '.' + im.file.extension;
-        im.file = file_data(filename);
+        std::uint64_t key = result_cache::make_key(im, chain);
 
-        return *this;
-    }
+        // Names of results are the source name followed by a suffix per operation, only the suffixes are cached.
+        std::string name = im.file.name;
+        std::string extension = im.file.extension;
 
-    processor &processor::dither_two_row_sierra() {
-        int height = im.height;
-        int width = im.width;
+        if (std::optional<result_cache::entry> hit = cache->find(key)) {
+            im = std::move(hit->result);
+            im.file = file_data(get_output_directory() + "/" + name + hit->label + '.' + extension);
 
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
+            // k_means() did not run, statistics of an earlier run don't describe the loaded result.
+            if (runs_k_means) {
+                k_means_statistics.reset();
+            }
 
-        // Algorithm requires storage for the error values being applied on the two next rows.
-        std::vector<glm::vec4> error;
-        error.resize(width * height, glm::vec4(0.0f));
+            return;
+        }
 
-        // Two-Row Sierra dithering matrix:
-        //               X    4/16  3/16
-        //  1/16  2/16  3/16  2/16  1/16
-        float error1 = 1.0f / 16.0f;
-        float error2 = 2.0f / 16.0f;
-        float error3 = 3.0f / 16.0f;
-        float error4 = 4.0f / 16.0f;
+        run(operations);
 
-        glm::vec4 value;
+        if (im.file.name.compare(0, name.size(), name) == 0) {
+            cache->store(key, im, im.file.name.substr(name.size()));
+        }
+    }
 
-        for (int y = 0; y < height - 2; ++y) {
-            // Ensure valid bounds.
-            for (int x = 2; x < width - 2; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
-                value += error[index];
+    void processor::run(std::vector<operation>& operations) const {
+        // Recorded operations call back into the processor, and need to run right away. State is mutable, so it is
+        // safe to run them through a non-const reference.
+        execution previous = mode;
+        mode = execution::eager;
+        processor& self = const_cast<processor&>(*this);
 
-                glm::vec4 unscaled_error = skew_direction(value);
+        std::vector<point_operation> fused;
+        std::size_t remaining = 0; // First operation that has not started running.
 
-                // Propagate error to neighboring cells based on error propagation matrix.
-                error[(x + 1) + width * (y + 0)] += error4 * unscaled_error;
-                error[(x + 2) + width * (y + 0)] += error3 * unscaled_error;
+        try {
+            for (std::size_t i = 0; i < operations.size(); ++i) {
+                operation& op = operations[i];
 
-                error[(x - 2) + width * (y + 1)] += error1 * unscaled_error;
-                error[(x - 1) + width * (y + 1)] += error2 * unscaled_error;
-                error[(x - 0) + width * (y + 1)] += error3 * unscaled_error;
-                error[(x + 1) + width * (y + 1)] += error2 * unscaled_error;
-                error[(x + 2) + width * (y + 1)] += error1 * unscaled_error;
+                if (op.point) {
+                    fused.emplace_back(std::move(*op.point));
+                    continue;
+                }
+
+                if (!fused.empty()) {
+                    remaining = i;
+                    execute(fused);
+                    fused.clear();
+                }
 
-                dithered[index] = value;
+                remaining = i + 1;
+                op.run(self);
             }
-        }
 
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
+            remaining = operations.size();
+
+            if (!fused.empty()) {
+                execute(fused);
             }
         }
+        catch (...) {
+            // Operations after the one that failed stay recorded.
+            pending.insert(pending.begin(), std::make_move_iterator(operations.begin() + static_cast<std::ptrdiff_t>(remaining)), std::make_move_iterator(operations.end()));
+            mode = previous;
+            throw;
+        }
 
-        // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_two_row_sierra" + '.' + im.file.extension;
-        im.file = file_data(filename);
-
-        return *this;
+        mode = previous;
     }
 
-    processor &processor::dither_sierra_lite() {
-        int height = im.height;
-        int width = im.width;
+    void processor::execute(const std::vector<point_operation> &operations) const {
+        IMG_TRACE_SCOPE("processor::point_operations");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-        std::vector<glm::vec4> dithered;
-        dithered.resize(width * height, glm::vec4(0.0f));
+        int width = im.width;
+        int height = im.height;
+        int channels = im.channels;
 
-        // Algorithm requires storage for the error values being applied on the two next rows.
-        std::vector<glm::vec4> error;
-        error.resize(width * height, glm::vec4(0.0f));
+        int result_channels = channels;
+        for (const point_operation& operation : operations) {
+            if (operation.channels > 0) {
+                result_channels = operation.channels;
+            }
+        }
 
-        // Sierra-Lite dithering matrix:
-        //               X   2/4
-        //        1/4   1/4
-        float error1 = 1.0f / 4.0f;
-        float error2 = 2.0f / 4.0f;
+        // Operations that change the channel count write to a new image, others work in place.
+        std::optional<image> result;
+        if (result_channels != channels) {
+            result.emplace(im.file.path, width, height, result_channels);
+        }
 
-        glm::vec4 value;
+        const unsigned char* source = im.data;
+        unsigned char* destination = result ? result->data : im.get_data();
 
-        for (int y = 0; y < height - 2; ++y) {
-            // Ensure valid bounds.
-            for (int x = 2; x < width - 2; ++x) {
-                int index = x + width * y;
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
-                value += error[index];
+        // Every tile is loaded once, run through all operations while it is in cache, and written back.
+        parallel_for_rows(height, [&](int first, int last) {
+            unsigned char tile[point_operation::max_count * 4];
 
-                glm::vec4 unscaled_error = skew_direction(value);
+            for (int y = first; y < last; ++y) {
+                for (int x = 0; x < width; x += point_operation::max_count) {
+                    int count = std::min(point_operation::max_count, width - x);
+                    std::size_t offset = static_cast<std::size_t>(y) * width + x;
 
-                // Propagate error to neighboring cells based on error propagation matrix.
-                error[(x + 1) + width * (y + 0)] += error2 * unscaled_error;
+                    unpack_rgba(source + offset * channels, channels, tile, count);
 
-                error[(x - 1) + width * (y + 1)] += error1 * unscaled_error;
-                error[(x - 0) + width * (y + 1)] += error1 * unscaled_error;
+                    for (const point_operation& operation : operations) {
+                        operation.function(tile, count, x, y);
+                    }
 
-                dithered[index] = value;
+                    pack_rgba(tile, destination + offset * result_channels, result_channels, count);
+                }
             }
-        }
+        });
 
-        // Write resulting colors back to image.
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = x + width * y;
-                im.set_pixel(x, y, glm::vec4(glm::vec3(dithered[index]), 255.0f));
-            }
+        if (result) {
+            im = std::move(*result);
         }
 
         // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_sierra_lite" + '.' + im.file.extension;
-        im.file = file_data(filename);
-
-        return *this;
+        for (const point_operation& operation : operations) {
+            std::string filename = get_output_directory() + "/" + im.file.name + operation.suffix + '.' + im.file.extension;
+            im.file = file_data(filename);
+        }
     }
 
-    processor &processor::dither_bayer(int matrix_width, int matrix_height) {
-        // Get Bayer Matrix that encompasses the desired matrix dimension.
-        int max = matrix_height >= matrix_width ? matrix_height : matrix_width;
-
-        int bayer_matrix_level = next_power_of(2, max) - 1; // Zero-based.
-
-        std::vector<float> bayer_matrix = get_bayer_matrix(bayer_matrix_level);
-        int dimension = get_bayer_matrix_dimension(bayer_matrix_level);
+    processor &processor::dither(diffusion_matrix matrix, const std::string &name) {
+        IMG_TRACE_SCOPE("processor::dither");
+        IMG_TRACE_COUNTER("pixels_processed", static_cast<std::uint64_t>(im.width) * im.height);
 
-        int height = im.height;
         int width = im.width;
+        int height = im.height;
+        int channels = im.channels;
+        unsigned char* data = im.get_data();
 
-        glm::vec4 value;
+        // Rows are dithered in place, as they are streamed through the diffuser.
+        error_diffuser diffuser(matrix, width, height);
+        std::vector<unsigned char> row(static_cast<std::size_t>(width) * 4);
 
         for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                value = glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f); // Ignore alpha channel.
+            unsigned char* pixels = data + static_cast<std::size_t>(y) * width * channels;
 
-                // Helpful resource for this part: https://github.com/ShadowfaxRodeo/dither-me-this
-                float bayer_element = bayer_matrix[(y % matrix_height) * dimension + (x % matrix_width)];
-
-                // Bayer Matrix is in the domain [0, 1].
-                value /= glm::vec4(255.0f);
-
-                value = (value.r + value.g + value.b) / 3.0f > bayer_element ? glm::vec4(255.0f) : glm::vec4(0.0f);
-                im.set_pixel(x, y, value);
-            }
+            unpack_rgba(pixels, channels, row.data(), width);
+            diffuser.dither_row(y, row.data());
+            pack_rgba(row.data(), pixels, channels, width);
         }
 
         // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "dither_bayer_" + std::to_string(matrix_width) + 'x' + std::to_string(matrix_height) + '.' + im.file.extension;
+        std::string filename = get_output_directory() + "/" + im.file.name + '_' + name + '.' + im.file.extension;
         im.file = file_data(filename);
 
         return *this;
     }
 
-    processor &processor::voronoi(int num_regions) {
-        std::vector<voronoi_region> regions;
-        regions.reserve(num_regions);
+    float processor::euclidian_distance(const glm::vec3& first, const glm::vec3& second) const { // NOLINT(readability-convert-member-functions-to-static)
+        return glm::length2(second - first); // Magnitude squared.
+    }
 
+    std::vector<glm::vec3> processor::seed_centroids(int k) const {
         int height = im.height;
         int width = im.width;
 
-        for (int i = 0; i < num_regions; ++i) {
-            regions.emplace_back(uniform_distribution(glm::vec2(0, 0), glm::vec2(width, height)));
-        }
-
-        // Classify pixels.
-        glm::vec2 pixel;
-
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                pixel = glm::vec2(x, y);
+        // Unique colors, one bit per 24-bit color.
+        std::vector<std::atomic<std::uint64_t>> seen(1 << 18);
 
-                float smallest_distance = std::numeric_limits<float>::max();
-                int index = -1;
+        parallel_for_rows(height, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    pixel pix = im.get_pixel(x, y);
+                    std::uint32_t color = (static_cast<std::uint32_t>(pix.r) << 16) | (static_cast<std::uint32_t>(pix.g) << 8) | pix.b;
 
-                // Get the closest region to this pixel.
-                for (int i = 0; i < num_regions; ++i) {
-                    voronoi_region& region = regions[i];
-                    float distance = glm::distance(region.center, pixel);
+                    std::atomic<std::uint64_t>& word = seen[color >> 6];
+                    std::uint64_t bit = std::uint64_t(1) << (color & 63);
 
-                    if (distance < smallest_distance) {
-                        smallest_distance = distance;
-                        index = i;
+                    // Most colors repeat, only write bits that are not set yet.
+                    if (!(word.load(std::memory_order_relaxed) & bit)) {
+                        word.fetch_or(bit, std::memory_order_relaxed);
                     }
                 }
-
-                // Append this pixel to this region's pixel list.
-                voronoi_region& region = regions[index];
-                region.add_influence(pixel, glm::vec4(glm::vec3(im.get_pixel(x, y)), 255.0f));
             }
+        });
+
+        std::size_t unique = 0;
+        for (const std::atomic<std::uint64_t>& word : seen) {
+            unique += std::bitset<64>(word.load(std::memory_order_relaxed)).count();
         }
 
-        // Apply average color for each region to output image.
-        glm::vec4 average_color;
+        // Seeding visits every candidate once per centroid, images with more unique colors are sampled evenly.
+        const std::size_t max_candidates = 1 << 16;
+        std::size_t stride = (unique + max_candidates - 1) / max_candidates;
+        auto offset = static_cast<std::size_t>(uniform_distribution(0, static_cast<int>(stride) - 1));
+
+        std::vector<glm::vec3> candidates;
+        candidates.reserve(std::min(unique, max_candidates));
 
-        for (const voronoi_region& region : regions) {
-            average_color = region.get_average_color();
+        std::size_t index = 0;
+        for (std::size_t i = 0; i < seen.size(); ++i) {
+            std::uint64_t word = seen[i].load(std::memory_order_relaxed);
 
-            for (const glm::ivec2& p : region.pixels) {
-                im.set_pixel(p.x, p.y, average_color);
+            for (int bit = 0; word != 0; ++bit, word >>= 1) {
+                if ((word & 1) && index++ % stride == offset) {
+                    auto color = static_cast<std::uint32_t>(i << 6) | static_cast<std::uint32_t>(bit);
+                    candidates.emplace_back(static_cast<float>(color >> 16), static_cast<float>((color >> 8) & 255), static_cast<float>(color & 255));
+                }
             }
         }
 
-        // Update naming.
-        std::string filename = get_output_directory() + "/" + im.file.name + '_' + "voronoi" + '_' + std::to_string(num_regions) + '.' + im.file.extension;
-        im.file = file_data(filename);
+        std::vector<glm::vec3> centroids;
+        if (candidates.empty()) {
+            return centroids;
+        }
 
-        return *this;
-    }
+        // k-means++: the first centroid is a random candidate, every next one is drawn with probability proportional
+        // to the squared distance of a candidate to its nearest centroid. Candidates that are centroids already are
+        // never drawn again, images with fewer than 'k' colors get one centroid per color.
+        centroids.emplace_back(candidates[uniform_distribution(0, static_cast<int>(candidates.size()) - 1)]);
 
-    std::string processor::get_output_directory() const { // NOLINT(readability-convert-member-functions-to-static)
-        static std::string output_directory = convert_to_native_separators("assets/generated/" + im.file.name);
-        return output_directory; // Copy.
-    }
+        std::vector<float> distances(candidates.size(), std::numeric_limits<float>::infinity());
+
+        while (static_cast<int>(centroids.size()) < k) {
+            double total = 0.0;
+
+            for (std::size_t i = 0; i < candidates.size(); ++i) {
+                distances[i] = std::min(distances[i], euclidian_distance(candidates[i], centroids.back()));
+                total += distances[i];
+            }
+
+            if (total <= 0.0) {
+                break;
+            }
 
-    glm::vec4 processor::get_average_color(int x, int y, int x_resolution, int y_resolution) const {
-        glm::vec4 data(0.0f);
+            double target = uniform_distribution(0.0, total);
+            double cumulative = 0.0;
+            std::size_t chosen = 0;
 
-        // Average values in one "pixel".
-        for (int j = 0; j < y_resolution; ++j) {
-            for (int i = 0; i < x_resolution; ++i) {
-                data += im.get_pixel(x + i, y + j);
+            for (std::size_t i = 0; i < candidates.size(); ++i) {
+                if (distances[i] > 0.0f) {
+                    chosen = i;
+                    cumulative += distances[i];
+
+                    if (cumulative >= target) {
+                        break;
+                    }
+                }
             }
+
+            centroids.emplace_back(candidates[chosen]);
         }
-        data /= (float) (x_resolution * y_resolution);
 
-        return data;
+        return centroids;
     }
 
-    float processor::euclidian_distance(const glm::vec3& first, const glm::vec3& second) const { // NOLINT(readability-convert-member-functions-to-static)
-        return glm::length2(second - first); // Magnitude squared.
-    }
+    std::uint64_t processor::assign_cluster_ids(const std::vector<glm::vec3>& centroids, std::vector<int>& cluster_ids, double& inertia) const {
+        IMG_TRACE_SCOPE("k_means::classify");
 
-    bool processor::assign_cluster_ids(const std::vector<glm::vec3>& centroids, std::vector<int>& cluster_ids) const {
         int height = im.height;
         int width = im.width;
-        bool needs_updating = false;
+        std::atomic<std::uint64_t> reassignments(0);
 
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                glm::vec3 data = glm::vec3(im.get_pixel(x, y));
+        // Summed per row, then in row order, so the inertia does not depend on how the rows are split between threads.
+        std::vector<double> row_inertia(height, 0.0);
 
-                int index = x + width * y;
-                int cluster_id = -1;
-                float smallest_distance = std::numeric_limits<float>::infinity();
+        parallel_for_rows(height, [&](int first, int last) {
+            std::uint64_t changed = 0;
 
-                // Get the closest centroid to this pixel.
-                for (int i = 0; i < centroids.size(); ++i) {
-                    float current_distance = euclidian_distance(data, centroids[i]);
+            for (int y = first; y < last; ++y) {
+                double distances = 0.0;
 
-                    if (current_distance < smallest_distance) {
-                        // Found closer centroid.
-                        smallest_distance = current_distance;
-                        cluster_id = i; // Update cluster index.
+                for (int x = 0; x < width; ++x) {
+                    glm::vec3 data = glm::vec3(im.get_pixel(x, y));
+
+                    int index = x + width * y;
+                    int cluster_id = -1;
+                    float smallest_distance = std::numeric_limits<float>::infinity();
+
+                    // Get the closest centroid to this pixel.
+                    for (int i = 0; i < centroids.size(); ++i) {
+                        float current_distance = euclidian_distance(data, centroids[i]);
+
+                        if (current_distance < smallest_distance) {
+                            // Found closer centroid.
+                            smallest_distance = current_distance;
+                            cluster_id = i; // Update cluster index.
+                        }
                     }
-                }
 
-                if (cluster_id != cluster_ids[index]) {
-                    // Cluster changed, centroids need to be updated.
-                    cluster_ids[index] = cluster_id;
-                    needs_updating = true;
+                    distances += smallest_distance;
+
+                    if (cluster_id != cluster_ids[index]) {
+                        // Cluster changed, centroids need to be updated.
+                        cluster_ids[index] = cluster_id;
+                        ++changed;
+                    }
                 }
+
+                row_inertia[y] = distances;
             }
-        }
 
-        return needs_updating;
+            reassignments.fetch_add(changed, std::memory_order_relaxed);
+        });
+
+        inertia = std::accumulate(row_inertia.begin(), row_inertia.end(), 0.0);
+        return reassignments.load(std::memory_order_relaxed);
     }
 
     void processor::update_centroids(std::vector<glm::vec3>& centroids, const std::vector<int>& cluster_ids) const {
+        IMG_TRACE_SCOPE("k_means::update_centroids");
+
         int height = im.height;
         int width = im.width;
+        int k = static_cast<int>(centroids.size());
+
+        // Color totals and pixel counts per cluster, accumulated in a single pass over the image. Totals are whole
+        // numbers, so the result does not depend on how the rows are split between threads.
+        std::vector<std::uint64_t> sums(k * 3, 0);
+        std::vector<std::uint64_t> counts(k, 0);
+        std::mutex lock;
 
-        for (int i = 0; i < centroids.size(); ++i) {
-            glm::vec3 sum(0.0f);
-            int num_elements = 0;
+        parallel_for_rows(height, [&](int first, int last) {
+            std::vector<std::uint64_t> local_sums(k * 3, 0);
+            std::vector<std::uint64_t> local_counts(k, 0);
 
-            for (int y = 0; y < height; ++y) {
+            for (int y = first; y < last; ++y) {
                 for (int x = 0; x < width; ++x) {
-                    int index = x + width * y;
-                    if (cluster_ids[index] == i) {
-                        // Do not consider colors with opacity to be a different color.
-                        pixel pix = im.get_pixel(x, y);
-                        sum += glm::vec3(pix);
-                        ++num_elements;
-                    }
+                    int cluster_id = cluster_ids[x + width * y];
+
+                    // Do not consider colors with opacity to be a different color.
+                    pixel pix = im.get_pixel(x, y);
+                    local_sums[cluster_id * 3 + 0] += pix.r;
+                    local_sums[cluster_id * 3 + 1] += pix.g;
+                    local_sums[cluster_id * 3 + 2] += pix.b;
+                    ++local_counts[cluster_id];
                 }
             }
 
+            std::lock_guard<std::mutex> guard(lock);
+
+            for (int i = 0; i < k; ++i) {
+                sums[i * 3 + 0] += local_sums[i * 3 + 0];
+                sums[i * 3 + 1] += local_sums[i * 3 + 1];
+                sums[i * 3 + 2] += local_sums[i * 3 + 2];
+                counts[i] += local_counts[i];
+            }
+        });
+
+        for (int i = 0; i < k; ++i) {
             // Centroid needs updating.
-            if (num_elements > 0) {
-                centroids[i] = sum / static_cast<float>(num_elements);
+            if (counts[i] > 0) {
+                glm::vec3 sum(static_cast<float>(sums[i * 3 + 0]), static_cast<float>(sums[i * 3 + 1]), static_cast<float>(sums[i * 3 + 2]));
+                centroids[i] = sum / static_cast<float>(counts[i]);
             }
         }
-    }
-
-    glm::vec4 processor::skew_direction(glm::vec4& value) const {
-        static const glm::vec4 zero = glm::vec4(0.0f);
-        static const glm::vec4 one = glm::vec4(255.0f);
 
-        float distance_to_zero = euclidian_distance(value, zero);
-        float distance_to_one = euclidian_distance(value, one);
+        // Empty clusters restart at the pixel farthest from its centroid, one pixel per empty cluster.
+        std::vector<glm::vec3> reseeded;
 
-        // Set to zero or one depending on which one the given 'value' is closest to.
-        // Returns distance to the closest value.
-        glm::vec4 distance;
+        for (int i = 0; i < k; ++i) {
+            if (counts[i] > 0) {
+                continue;
+            }
 
-        if (distance_to_zero < distance_to_one) {
-            distance = value - zero;
-            value = zero;
-        }
-        else {
-            distance = value - one;
-            value = one;
-        }
+            // Farthest pixel per row, then in row order, so the choice does not depend on how the rows are split.
+            std::vector<std::pair<float, glm::vec3>> row_farthest(height, { 0.0f, glm::vec3(0.0f) });
 
-        return distance;
-    }
+            parallel_for_rows(height, [&](int first, int last) {
+                for (int y = first; y < last; ++y) {
+                    for (int x = 0; x < width; ++x) {
+                        glm::vec3 color = glm::vec3(im.get_pixel(x, y));
+                        float distance = euclidian_distance(color, centroids[cluster_ids[x + width * y]]);
 
-    std::vector<float> processor::get_bayer_matrix_helper(int n) const {
-        int dimension = integer_power(2, n + 1);
+                        bool taken = std::find(reseeded.begin(), reseeded.end(), color) != reseeded.end();
+                        if (distance > row_farthest[y].first && !taken) {
+                            row_farthest[y] = { distance, color };
+                        }
+                    }
+                }
+            });
 
-        std::vector<float> matrix{ };
-        matrix.resize(dimension * dimension);
+            auto farthest = std::max_element(row_farthest.begin(), row_farthest.end(), [](const auto& a, const auto& b) {
+                return a.first < b.first;
+            });
 
-        // Bayer(0) = [ 0  2 ]
-        //            [ 3  1 ]
-        //  ...
-        // Bayer(n) = [ 4 * Bayer(n - 1) + 0    4 * Bayer(n - 1) + 2 ]
-        //            [ 4 * Bayer(n - 1) + 3    4 * Bayer(n - 1) + 1 ]
+            // Every pixel already lies on a centroid.
+            if (farthest->first <= 0.0f) {
+                break;
+            }
 
-        if (n == 0) {
-            // Base case.
-            matrix[0] = 0;
-            matrix[1] = 2;
-            matrix[2] = 3;
-            matrix[3] = 1;
+            centroids[i] = farthest->second;
+            reseeded.emplace_back(farthest->second);
         }
-        else {
-            std::vector<float> previous = get_bayer_matrix_helper(n - 1);
-            int previous_dimension = integer_power(2, n);
+    }
 
-            int index = 0;
+    processor::voronoi_diagram::voronoi_diagram(const image &source) : source(source),
+                                                                       centers(),
+                                                                       labels(source.width * source.height, -1),
+                                                                       distances(source.width * source.height, std::numeric_limits<float>::infinity()),
+                                                                       sums(),
+                                                                       counts(),
+                                                                       visited(source.width * source.height, -1),
+                                                                       stack()
+                                                                       {
+    }
 
-            // Copy over elements.
-            // Top two, row by row.
-            for (int y = 0; y < previous_dimension; ++y) {
-                // Copy row from first Bayer matrix.
-                for (int x = 0; x < previous_dimension; ++x) {
-                    matrix[index++] = 4.0f * previous[y * previous_dimension + x] + 0.0f;
-                }
+    void processor::voronoi_diagram::add_region(const glm::vec2 &center) {
+        int width = source.width;
+        int height = source.height;
+        int region = static_cast<int>(centers.size());
+
+        centers.emplace_back(center);
+        sums.resize(sums.size() + 3, 0);
+        counts.emplace_back(0);
+
+        // The pixels closer to the new center than to their current one form a convex area around the center. Only
+        // the pixels inside that area are relabeled, but the flood fill also walks through pixels that come within two
+        // pixels of qualifying: on a pixel grid a thin convex area does not have to be connected, and the slack keeps
+        // every pixel of the area reachable from the center.
+        static const float slack = 2.0f;
+
+        glm::ivec2 start = glm::clamp(glm::ivec2(glm::round(center)), glm::ivec2(0), glm::ivec2(width - 1, height - 1));
+        stack.clear();
+        stack.emplace_back(start.x + width * start.y);
+        visited[start.x + width * start.y] = region;
+
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+
+            int x = index % width;
+            int y = index / width;
+
+            float distance = glm::length2(center - glm::vec2(x, y));
+            if (glm::sqrt(distance) >= glm::sqrt(distances[index]) + slack) {
+                // Pixel is too far from the area to lead to any pixels inside of it.
+                continue;
+            }
+
+            for (int j = -1; j < 2; ++j) {
+                for (int i = -1; i < 2; ++i) {
+                    int neighbor_x = x + i;
+                    int neighbor_y = y + j;
 
-                // Copy row from second Bayer matrix.
-                for (int x = 0; x < previous_dimension; ++x) {
-                    matrix[index++] = 4.0f * previous[y * previous_dimension + x] + 2.0f;
+                    // Validate pixel bounds.
+                    if (neighbor_x < 0 || neighbor_x >= width || neighbor_y < 0 || neighbor_y >= height) {
+                        continue;
+                    }
+
+                    int neighbor = neighbor_x + width * neighbor_y;
+                    if (visited[neighbor] != region) {
+                        visited[neighbor] = region;
+                        stack.emplace_back(neighbor);
+                    }
                 }
             }
 
-            // Bottom two, row by row.
-            for (int y = 0; y < previous_dimension; ++y) {
-                // Copy row from first Bayer matrix.
-                for (int x = 0; x < previous_dimension; ++x) {
-                    matrix[index++] = 4.0f * previous[y * previous_dimension + x] + 3.0f;
-                }
+            if (distance >= distances[index]) {
+                // Pixel stays with its current region.
+                continue;
+            }
 
-                // Copy row from second Bayer matrix.
-                for (int x = 0; x < previous_dimension; ++x) {
-                    matrix[index++] = 4.0f * previous[y * previous_dimension + x] + 1.0f;
-                }
+            // Move this pixel's color from its previous region to the new one.
+            pixel value = source.get_pixel(x, y);
+            int previous = labels[index];
+            if (previous >= 0) {
+                sums[previous * 3 + 0] -= value.r;
+                sums[previous * 3 + 1] -= value.g;
+                sums[previous * 3 + 2] -= value.b;
+                --counts[previous];
             }
-        }
 
-        return matrix;
+            sums[region * 3 + 0] += value.r;
+            sums[region * 3 + 1] += value.g;
+            sums[region * 3 + 2] += value.b;
+            ++counts[region];
+
+            labels[index] = region;
+            distances[index] = distance;
+        }
     }
 
-    std::vector<float> processor::get_bayer_matrix(int n) const {
-        std::vector<float> bayer_matrix = get_bayer_matrix_helper(n);
+    void processor::voronoi_diagram::apply(image &output) const {
+        int width = source.width;
+        int height = source.height;
 
-        // Apply normalization (divide all elements by 2 ^ (2 * n + 2)
-        float divisor = static_cast<float>(integer_power(2, 2 * n + 2));
+        // Average color of each region.
+        std::vector<glm::vec4> colors(centers.size(), glm::vec4(0.0f));
 
-        for (float& value : bayer_matrix) {
-            value /= divisor;
+        for (std::size_t i = 0; i < centers.size(); ++i) {
+            if (counts[i] > 0) {
+                glm::vec3 total(sums[i * 3 + 0], sums[i * 3 + 1], sums[i * 3 + 2]);
+                colors[i] = glm::vec4(total / static_cast<float>(counts[i]), 255.0f);
+            }
         }
 
-        return bayer_matrix;
-    }
-
-    int processor::get_bayer_matrix_dimension(int n) const {
-        return integer_power(2, n + 1);
-    }
+        // Region colors, converted to the channels of the output once.
+        int channels = output.channels;
+        std::vector<unsigned char> converted(colors.size() * channels);
+        for (std::size_t i = 0; i < colors.size(); ++i) {
+            convert_color(colors[i], channels, converted.data() + i * channels);
+        }
 
-    processor::voronoi_region::voronoi_region(const glm::vec2 &point) : center(point),
-                                                                        pixels(),
-                                                                        color(0.0f)
-                                                                        {
-    }
+        // Detach from shared data once, pixels are then written from multiple threads through the raw pointer.
+        unsigned char* pixels = output.get_data();
 
-    void processor::voronoi_region::add_influence(const glm::vec2 &point, const glm::vec4 &value) {
-        pixels.emplace_back(point);
-        color += value;
+        parallel_for_rows(height, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    std::size_t index = static_cast<std::size_t>(x) + static_cast<std::size_t>(width) * y;
+                    std::memcpy(pixels + index * channels, converted.data() + static_cast<std::size_t>(labels[index]) * channels, channels);
+                }
+            }
+        });
     }
 
-    glm::vec4 processor::voronoi_region::get_average_color() const {
-        return color / static_cast<float>(pixels.size());
+    std::string processor::get_voronoi_filename(int num_regions) const {
+        return get_output_directory() + "/" + im.file.name + '_' + "voronoi" + '_' + std::to_string(num_regions) + '.' + im.file.extension;
     }
 }
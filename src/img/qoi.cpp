@@ -0,0 +1,258 @@
+
+#include "img/qoi.h"
+
+namespace img {
+
+    namespace {
+
+        // Chunk tags.
+        const unsigned char op_index = 0x00; // 00xxxxxx
+        const unsigned char op_diff = 0x40;  // 01xxxxxx
+        const unsigned char op_luma = 0x80;  // 10xxxxxx
+        const unsigned char op_run = 0xc0;   // 11xxxxxx
+        const unsigned char op_rgb = 0xfe;
+        const unsigned char op_rgba = 0xff;
+        const unsigned char mask = 0xc0;
+
+        const std::size_t header_size = 14;
+        const unsigned char end_marker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+        // Largest number of pixels the reference implementation accepts.
+        const std::uint64_t max_pixels = 400000000;
+
+        struct rgba {
+            unsigned char r, g, b, a;
+
+            bool operator==(const rgba& other) const {
+                return r == other.r && g == other.g && b == other.b && a == other.a;
+            }
+        };
+
+        int hash(const rgba& color) {
+            return (color.r * 3 + color.g * 5 + color.b * 7 + color.a * 11) % 64;
+        }
+
+        rgba read_pixel(const unsigned char* source, int channels) {
+            switch (channels) {
+                case 1:
+                    return { source[0], source[0], source[0], 0xff };
+                case 2:
+                    return { source[0], source[0], source[0], source[1] };
+                case 3:
+                    return { source[0], source[1], source[2], 0xff };
+                default:
+                    return { source[0], source[1], source[2], source[3] };
+            }
+        }
+
+        std::uint32_t read_big_endian(const unsigned char* source) {
+            return (std::uint32_t(source[0]) << 24) | (std::uint32_t(source[1]) << 16) | (std::uint32_t(source[2]) << 8) | std::uint32_t(source[3]);
+        }
+
+        void write_big_endian(unsigned char* destination, std::uint32_t value) {
+            destination[0] = static_cast<unsigned char>(value >> 24);
+            destination[1] = static_cast<unsigned char>(value >> 16);
+            destination[2] = static_cast<unsigned char>(value >> 8);
+            destination[3] = static_cast<unsigned char>(value);
+        }
+
+    }
+
+    std::vector<unsigned char> encode_qoi(const unsigned char *pixels, int width, int height, int channels) {
+        std::vector<unsigned char> qoi;
+
+        if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4 || std::uint64_t(width) * height > max_pixels) {
+            std::cerr << "Invalid image passed to encode_qoi()." << std::endl;
+            return qoi;
+        }
+
+        int output_channels = channels == 2 || channels == 4 ? 4 : 3;
+        std::size_t count = static_cast<std::size_t>(width) * height;
+
+        // Worst case: every pixel as a full RGB(A) chunk.
+        qoi.resize(header_size + count * (output_channels + 1) + sizeof(end_marker));
+        unsigned char* output = qoi.data();
+
+        output[0] = 'q';
+        output[1] = 'o';
+        output[2] = 'i';
+        output[3] = 'f';
+        write_big_endian(output + 4, static_cast<std::uint32_t>(width));
+        write_big_endian(output + 8, static_cast<std::uint32_t>(height));
+        output[12] = static_cast<unsigned char>(output_channels);
+        output[13] = 0; // sRGB with linear alpha.
+
+        std::size_t position = header_size;
+
+        rgba index[64] = { };
+        rgba previous = { 0, 0, 0, 0xff };
+        int run = 0;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            rgba current = read_pixel(pixels + i * channels, channels);
+
+            if (current == previous) {
+                ++run;
+
+                if (run == 62 || i + 1 == count) {
+                    output[position++] = static_cast<unsigned char>(op_run | (run - 1));
+                    run = 0;
+                }
+
+                continue;
+            }
+
+            if (run > 0) {
+                output[position++] = static_cast<unsigned char>(op_run | (run - 1));
+                run = 0;
+            }
+
+            int slot = hash(current);
+
+            if (index[slot] == current) {
+                output[position++] = static_cast<unsigned char>(op_index | slot);
+            }
+            else {
+                index[slot] = current;
+
+                if (current.a == previous.a) {
+                    // Differences wrap around, as the decoder adds them modulo 256.
+                    auto dr = static_cast<signed char>(current.r - previous.r);
+                    auto dg = static_cast<signed char>(current.g - previous.g);
+                    auto db = static_cast<signed char>(current.b - previous.b);
+
+                    auto dr_dg = static_cast<signed char>(dr - dg);
+                    auto db_dg = static_cast<signed char>(db - dg);
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        output[position++] = static_cast<unsigned char>(op_diff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+                    }
+                    else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                        output[position++] = static_cast<unsigned char>(op_luma | (dg + 32));
+                        output[position++] = static_cast<unsigned char>(((dr_dg + 8) << 4) | (db_dg + 8));
+                    }
+                    else {
+                        output[position++] = op_rgb;
+                        output[position++] = current.r;
+                        output[position++] = current.g;
+                        output[position++] = current.b;
+                    }
+                }
+                else {
+                    output[position++] = op_rgba;
+                    output[position++] = current.r;
+                    output[position++] = current.g;
+                    output[position++] = current.b;
+                    output[position++] = current.a;
+                }
+            }
+
+            previous = current;
+        }
+
+        std::copy(std::begin(end_marker), std::end(end_marker), output + position);
+        position += sizeof(end_marker);
+
+        qoi.resize(position);
+        return qoi;
+    }
+
+    bool read_qoi_header(const unsigned char *buffer, std::size_t size, int *width, int *height, int *channels) {
+        if (!buffer || size < header_size || buffer[0] != 'q' || buffer[1] != 'o' || buffer[2] != 'i' || buffer[3] != 'f') {
+            return false;
+        }
+
+        std::uint32_t w = read_big_endian(buffer + 4);
+        std::uint32_t h = read_big_endian(buffer + 8);
+        int c = buffer[12];
+
+        if (w == 0 || h == 0 || (c != 3 && c != 4) || std::uint64_t(w) * h > max_pixels || std::uint64_t(w) * h * c > static_cast<std::uint64_t>(std::numeric_limits<int>::max())) {
+            return false;
+        }
+
+        *width = static_cast<int>(w);
+        *height = static_cast<int>(h);
+        *channels = c;
+        return true;
+    }
+
+    unsigned char* decode_qoi(const unsigned char *buffer, std::size_t size, int *width, int *height, int *channels) {
+        int w, h, c;
+        if (!read_qoi_header(buffer, size, &w, &h, &c)) {
+            return nullptr;
+        }
+
+        std::size_t count = static_cast<std::size_t>(w) * h;
+        std::unique_ptr<unsigned char[]> pixels(new unsigned char[count * c]);
+
+        // Chunks never overlap the end marker, which also guarantees enough bytes for the longest chunk (5 bytes).
+        std::size_t end = size - sizeof(end_marker);
+        std::size_t position = header_size;
+
+        rgba index[64] = { };
+        rgba current = { 0, 0, 0, 0xff };
+        int run = 0;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            if (run > 0) {
+                --run;
+            }
+            else {
+                if (position >= end) {
+                    return nullptr;
+                }
+
+                unsigned char tag = buffer[position++];
+
+                if (tag == op_rgb) {
+                    current.r = buffer[position++];
+                    current.g = buffer[position++];
+                    current.b = buffer[position++];
+                }
+                else if (tag == op_rgba) {
+                    current.r = buffer[position++];
+                    current.g = buffer[position++];
+                    current.b = buffer[position++];
+                    current.a = buffer[position++];
+                }
+                else if ((tag & mask) == op_index) {
+                    current = index[tag];
+                }
+                else if ((tag & mask) == op_diff) {
+                    current.r += ((tag >> 4) & 0x03) - 2;
+                    current.g += ((tag >> 2) & 0x03) - 2;
+                    current.b += (tag & 0x03) - 2;
+                }
+                else if ((tag & mask) == op_luma) {
+                    unsigned char next = buffer[position++];
+                    int dg = (tag & 0x3f) - 32;
+
+                    current.r += dg - 8 + ((next >> 4) & 0x0f);
+                    current.g += dg;
+                    current.b += dg - 8 + (next & 0x0f);
+                }
+                else {
+                    // Run of the previous pixel, this pixel included.
+                    run = tag & 0x3f;
+                }
+
+                index[hash(current)] = current;
+            }
+
+            unsigned char* destination = pixels.get() + i * c;
+            destination[0] = current.r;
+            destination[1] = current.g;
+            destination[2] = current.b;
+
+            if (c == 4) {
+                destination[3] = current.a;
+            }
+        }
+
+        *width = w;
+        *height = h;
+        *channels = c;
+        return pixels.release();
+    }
+
+}
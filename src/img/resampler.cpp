@@ -0,0 +1,247 @@
+
+#include "img/resampler.h"
+#include "img/thread_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define IMG_SSE2
+    #include <emmintrin.h>
+#endif
+
+namespace img {
+
+    namespace {
+
+        float get_filter_radius(filter type) {
+            switch (type) {
+                case filter::box:
+                    return 0.5f;
+                case filter::bilinear:
+                    return 1.0f;
+                case filter::bicubic:
+                    return 2.0f;
+                case filter::lanczos3:
+                    return 3.0f;
+            }
+
+            return 1.0f;
+        }
+
+        float sinc(float x) {
+            static const float pi = 3.14159265358979f;
+
+            if (std::abs(x) < 1e-6f) {
+                return 1.0f;
+            }
+
+            x *= pi;
+            return std::sin(x) / x;
+        }
+
+        float evaluate_filter(filter type, float x) {
+            x = std::abs(x);
+
+            switch (type) {
+                case filter::box:
+                    return x <= 0.5f ? 1.0f : 0.0f;
+
+                case filter::bilinear:
+                    return x < 1.0f ? 1.0f - x : 0.0f;
+
+                case filter::bicubic: {
+                    // Catmull-Rom (Keys cubic with a = -0.5).
+                    static const float a = -0.5f;
+
+                    if (x < 1.0f) {
+                        return ((a + 2.0f) * x - (a + 3.0f)) * x * x + 1.0f;
+                    }
+                    if (x < 2.0f) {
+                        return ((a * x - 5.0f * a) * x + 8.0f * a) * x - 4.0f * a;
+                    }
+                    return 0.0f;
+                }
+
+                case filter::lanczos3:
+                    return x < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+            }
+
+            return 0.0f;
+        }
+
+    }
+
+    resampler::weight_table::weight_table(int source_size, int size, filter type) : taps(0),
+                                                                                   start(size, 0),
+                                                                                   weights()
+                                                                                   {
+        float scale = static_cast<float>(source_size) / static_cast<float>(size);
+
+        // When shrinking, the filter is stretched to cover every source pixel that maps onto an output pixel.
+        float filter_scale = std::max(scale, 1.0f);
+        float support = get_filter_radius(type) * filter_scale;
+
+        taps = std::min(static_cast<int>(std::ceil(support)) * 2 + 1, source_size);
+        weights.resize(static_cast<std::size_t>(size) * taps, 0.0f);
+
+        for (int i = 0; i < size; ++i) {
+            // Center of the output pixel, in source pixel coordinates.
+            float center = (static_cast<float>(i) + 0.5f) * scale - 0.5f;
+
+            int first = static_cast<int>(std::floor(center - support)) + 1;
+            int last = static_cast<int>(std::floor(center + support));
+
+            // Keep the window inside the source, pixels outside of it are not sampled.
+            first = std::max(first, 0);
+            last = std::min(last, source_size - 1);
+
+            // Shift the window left if it is wider than the tap count allows.
+            int window_start = std::clamp(first, 0, source_size - taps);
+            start[i] = window_start;
+
+            float* row = weights.data() + static_cast<std::size_t>(i) * taps;
+            float total = 0.0f;
+
+            for (int j = first; j <= last; ++j) {
+                float weight = evaluate_filter(type, (static_cast<float>(j) - center) / filter_scale);
+                row[j - window_start] = weight;
+                total += weight;
+            }
+
+            // Normalize so that flat areas keep their color.
+            if (total != 0.0f) {
+                for (int t = 0; t < taps; ++t) {
+                    row[t] /= total;
+                }
+            }
+            else {
+                // Filter missed every source pixel (box filter on large upscales), use the nearest one.
+                int nearest = std::clamp(static_cast<int>(std::round(center)), 0, source_size - 1);
+                row[nearest - window_start] = 1.0f;
+            }
+        }
+    }
+
+    resampler::resampler(int source_width, int source_height, int width, int height, filter type) : source_width(source_width),
+                                                                                                     source_height(source_height),
+                                                                                                     width(width),
+                                                                                                     height(height),
+                                                                                                     horizontal(source_width, width, type),
+                                                                                                     vertical(source_height, height, type)
+                                                                                                     {
+    }
+
+    resampler::~resampler() = default;
+
+    void resampler::resample(const unsigned char *source, unsigned char *destination, int channels) const {
+        // Intermediate image, width by source_height pixels.
+        std::vector<float> intermediate(static_cast<std::size_t>(width) * source_height * channels);
+
+        // Rows are independent within each pass.
+        parallel_for_rows(source_height, [&](int first, int last) {
+            resample_horizontal(source, intermediate.data(), channels, first, last);
+        });
+
+        parallel_for_rows(height, [&](int first, int last) {
+            resample_vertical(intermediate.data(), destination, channels, first, last);
+        });
+    }
+
+    void resampler::resample_horizontal(const unsigned char *source, float *destination, int channels, int first, int last) const {
+        int taps = horizontal.taps;
+
+        for (int y = first; y < last; ++y) {
+            const unsigned char* input = source + static_cast<std::size_t>(y) * source_width * channels;
+            float* output = destination + static_cast<std::size_t>(y) * width * channels;
+
+            for (int x = 0; x < width; ++x) {
+                const unsigned char* pixels = input + static_cast<std::size_t>(horizontal.start[x]) * channels;
+                const float* weights = horizontal.weights.data() + static_cast<std::size_t>(x) * taps;
+
+#ifdef IMG_SSE2
+                if (channels == 4) {
+                    // One pixel per register: widen 4 bytes to 4 floats and accumulate with the broadcast weight.
+                    __m128i zero = _mm_setzero_si128();
+                    __m128 sum = _mm_setzero_ps();
+
+                    for (int t = 0; t < taps; ++t) {
+                        int packed;
+                        memcpy(&packed, pixels + t * 4, sizeof(int));
+
+                        __m128i value = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(value), _mm_set1_ps(weights[t])));
+                    }
+
+                    _mm_storeu_ps(output + x * 4, sum);
+                    continue;
+                }
+#endif
+
+                float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+                for (int t = 0; t < taps; ++t) {
+                    for (int c = 0; c < channels; ++c) {
+                        sum[c] += weights[t] * static_cast<float>(pixels[t * channels + c]);
+                    }
+                }
+
+                for (int c = 0; c < channels; ++c) {
+                    output[x * channels + c] = sum[c];
+                }
+            }
+        }
+    }
+
+    void resampler::resample_vertical(const float *source, unsigned char *destination, int channels, int first, int last) const {
+        int taps = vertical.taps;
+        int row_size = width * channels;
+
+        std::vector<float> sum(row_size);
+
+        for (int y = first; y < last; ++y) {
+            const float* input = source + static_cast<std::size_t>(vertical.start[y]) * row_size;
+            const float* weights = vertical.weights.data() + static_cast<std::size_t>(y) * taps;
+            unsigned char* output = destination + static_cast<std::size_t>(y) * row_size;
+
+            // Accumulate whole rows at a time, the inner loop runs over contiguous data.
+            std::fill(sum.begin(), sum.end(), 0.0f);
+
+            for (int t = 0; t < taps; ++t) {
+                const float* row = input + static_cast<std::size_t>(t) * row_size;
+                float weight = weights[t];
+                int i = 0;
+
+#ifdef IMG_SSE2
+                __m128 w = _mm_set1_ps(weight);
+                for (; i + 4 <= row_size; i += 4) {
+                    __m128 value = _mm_mul_ps(_mm_loadu_ps(row + i), w);
+                    _mm_storeu_ps(sum.data() + i, _mm_add_ps(_mm_loadu_ps(sum.data() + i), value));
+                }
+#endif
+
+                for (; i < row_size; ++i) {
+                    sum[i] += weight * row[i];
+                }
+            }
+
+            // Round and clamp to the valid color range.
+            int i = 0;
+
+#ifdef IMG_SSE2
+            for (; i + 16 <= row_size; i += 16) {
+                __m128i a = _mm_cvtps_epi32(_mm_loadu_ps(sum.data() + i + 0));
+                __m128i b = _mm_cvtps_epi32(_mm_loadu_ps(sum.data() + i + 4));
+                __m128i c = _mm_cvtps_epi32(_mm_loadu_ps(sum.data() + i + 8));
+                __m128i d = _mm_cvtps_epi32(_mm_loadu_ps(sum.data() + i + 12));
+
+                // Saturating packs clamp to [0, 255].
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), packed);
+            }
+#endif
+
+            for (; i < row_size; ++i) {
+                output[i] = static_cast<unsigned char>(std::clamp(std::nearbyint(sum[i]), 0.0f, 255.0f));
+            }
+        }
+    }
+
+}
@@ -0,0 +1,227 @@
+
+#include "img/result_cache.h"
+#include "img/hash.h"
+#include "img/memory_mapped_file.h"
+
+namespace img {
+
+    namespace {
+
+        const std::string magic = "imgcache\n";
+        const std::string entry_extension = ".entry";
+        const std::string temporary_extension = ".tmp";
+
+        // Temporary files older than this were left behind by a process that did not finish writing them.
+        const std::chrono::hours stale_age(1);
+
+        std::mutex& get_result_cache_lock() {
+            static std::mutex lock;
+            return lock;
+        }
+
+        std::shared_ptr<result_cache>& get_result_cache_instance() {
+            static std::shared_ptr<result_cache> instance;
+            return instance;
+        }
+
+        bool ends_with(const std::string& text, const std::string& suffix) {
+            return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        // Unique among threads and processes writing to the same directory.
+        std::string get_temporary_suffix() {
+            static std::mutex lock;
+            static std::mt19937_64 generator(std::random_device{}() ^ static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+
+            std::lock_guard<std::mutex> guard(lock);
+            return '.' + to_hex(generator()) + temporary_extension;
+        }
+
+    }
+
+    result_cache::result_cache(const std::string &directory, std::uint64_t budget) : directory(directory),
+                                                                                     budget(budget),
+                                                                                     size(0),
+                                                                                     trim_lock()
+                                                                                     {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        trim();
+    }
+
+    result_cache::~result_cache() = default;
+
+    std::uint64_t result_cache::make_key(const image &source, const std::string &chain) {
+        const unsigned char* data = source.get_data();
+        std::size_t bytes = static_cast<std::size_t>(source.get_width()) * source.get_height() * source.get_channels();
+
+        std::stringstream key;
+        key << source.get_width() << 'x' << source.get_height() << 'x' << source.get_channels() << ':' << to_hex(hash_blocks(data, bytes)) << ':' << chain;
+
+        std::string text = key.str();
+        return xxhash64(text.data(), text.size());
+    }
+
+    std::optional<result_cache::entry> result_cache::find(std::uint64_t key) {
+        std::string path = get_entry_path(key);
+
+        try {
+            memory_mapped_file mapping(path);
+
+            const unsigned char* data = mapping.get_data();
+            std::size_t length = mapping.get_size();
+
+            if (length < magic.size() || !std::equal(magic.begin(), magic.end(), data)) {
+                return std::nullopt;
+            }
+
+            const unsigned char* label_begin = data + magic.size();
+            const unsigned char* label_end = std::find(label_begin, data + length, '\n');
+            if (label_end == data + length) {
+                return std::nullopt;
+            }
+
+            std::string label(label_begin, label_end);
+            std::size_t offset = (label_end - data) + 1;
+
+            entry hit { label, image(label, data + offset, length - offset) };
+
+            // Mark as recently used.
+            std::error_code error;
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+            return hit;
+        }
+        catch (const std::runtime_error&) {
+            // Missing (or removed by another process in the meantime) or corrupt entry.
+            return std::nullopt;
+        }
+    }
+
+    bool result_cache::store(std::uint64_t key, const image &result, const std::string &label) {
+        if (label.find('\n') != std::string::npos) {
+            std::cerr << "Invalid label passed to store()." << std::endl;
+            return false;
+        }
+
+        // QOI only stores 3 and 4 channels, PAM keeps the channel count of smaller images.
+        std::vector<unsigned char> encoded = result.encode(result.get_channels() >= 3 ? image_format::qoi : image_format::pam);
+        if (encoded.empty()) {
+            return false;
+        }
+
+        std::string path = get_entry_path(key);
+        std::string temporary = path + get_temporary_suffix();
+
+        {
+            std::ofstream output(temporary, std::ios::binary);
+            output << magic << label << '\n';
+            output.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+
+            if (!output) {
+                output.close();
+
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+
+        // Atomically replaces any existing entry, readers see either the old or the new file.
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+
+        std::uint64_t stored = magic.size() + label.size() + 1 + encoded.size();
+        if (size.fetch_add(stored) + stored > budget) {
+            trim();
+        }
+
+        return true;
+    }
+
+    void result_cache::trim() {
+        std::lock_guard<std::mutex> guard(trim_lock);
+
+        struct file {
+            std::filesystem::path path;
+            std::filesystem::file_time_type time;
+            std::uint64_t size;
+        };
+
+        std::vector<file> entries;
+        std::uint64_t total = 0;
+
+        std::error_code error;
+        auto now = std::filesystem::file_time_type::clock::now();
+
+        for (const std::filesystem::directory_entry& item : std::filesystem::directory_iterator(directory, error)) {
+            std::error_code item_error;
+            std::string name = item.path().filename().string();
+
+            std::filesystem::file_time_type time = item.last_write_time(item_error);
+            std::uint64_t length = item.file_size(item_error);
+
+            if (item_error) {
+                continue; // Removed by another process.
+            }
+
+            if (ends_with(name, temporary_extension)) {
+                if (now - time > stale_age) {
+                    std::filesystem::remove(item.path(), item_error);
+                }
+            }
+            else if (ends_with(name, entry_extension)) {
+                entries.push_back({ item.path(), time, length });
+                total += length;
+            }
+        }
+
+        if (total > budget) {
+            // Oldest first.
+            std::sort(entries.begin(), entries.end(), [](const file& a, const file& b) {
+                return a.time < b.time;
+            });
+
+            for (const file& entry : entries) {
+                if (total <= budget) {
+                    break;
+                }
+
+                // Entries another process removed first are gone either way.
+                std::filesystem::remove(entry.path, error);
+                total -= entry.size;
+            }
+        }
+
+        size = total;
+    }
+
+    const std::string &result_cache::get_directory() const {
+        return directory;
+    }
+
+    std::uint64_t result_cache::get_budget() const {
+        return budget;
+    }
+
+    std::string result_cache::get_entry_path(std::uint64_t key) const {
+        return directory + "/" + to_hex(key) + entry_extension;
+    }
+
+    void set_result_cache(std::shared_ptr<result_cache> cache) {
+        std::lock_guard<std::mutex> guard(get_result_cache_lock());
+        get_result_cache_instance() = std::move(cache);
+    }
+
+    std::shared_ptr<result_cache> get_result_cache() {
+        std::lock_guard<std::mutex> guard(get_result_cache_lock());
+        return get_result_cache_instance();
+    }
+
+}
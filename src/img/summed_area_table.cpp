@@ -0,0 +1,79 @@
+
+#include "img/summed_area_table.h"
+#include "img/image.h"
+
+namespace img {
+
+    summed_area_table::summed_area_table(const image &im) : width(im.get_width()),
+                                                            height(im.get_height()),
+                                                            channels(im.get_channels()),
+                                                            sums()
+                                                            {
+        int stride = (width + 1) * channels;
+        sums.resize(static_cast<std::size_t>(stride) * (height + 1), 0);
+
+        const unsigned char* data = im.get_data();
+
+        for (int y = 0; y < height; ++y) {
+            const unsigned char* row = data + static_cast<std::size_t>(y) * width * channels;
+            const std::uint64_t* above = sums.data() + static_cast<std::size_t>(y) * stride;
+            std::uint64_t* current = sums.data() + static_cast<std::size_t>(y + 1) * stride;
+
+            // Running total of the current row, per channel.
+            std::uint64_t running[4] = { 0, 0, 0, 0 };
+
+            for (int x = 0; x < width; ++x) {
+                for (int c = 0; c < channels; ++c) {
+                    running[c] += row[x * channels + c];
+                    current[(x + 1) * channels + c] = above[(x + 1) * channels + c] + running[c];
+                }
+            }
+        }
+    }
+
+    summed_area_table::~summed_area_table() = default;
+
+    glm::vec4 summed_area_table::mean(int x, int y, int w, int h) const {
+        // Clip area to image bounds.
+        int x0 = std::clamp(x, 0, width);
+        int y0 = std::clamp(y, 0, height);
+        int x1 = std::clamp(x + w, 0, width);
+        int y1 = std::clamp(y + h, 0, height);
+
+        if (x0 >= x1 || y0 >= y1) {
+            return glm::vec4(0.0f);
+        }
+
+        int stride = (width + 1) * channels;
+        const std::uint64_t* top = sums.data() + static_cast<std::size_t>(y0) * stride;
+        const std::uint64_t* bottom = sums.data() + static_cast<std::size_t>(y1) * stride;
+        double area = static_cast<double>(x1 - x0) * static_cast<double>(y1 - y0);
+
+        float values[4] = { 0.0f, 0.0f, 0.0f, 255.0f };
+
+        for (int c = 0; c < channels; ++c) {
+            std::uint64_t sum = bottom[x1 * channels + c] - bottom[x0 * channels + c] - top[x1 * channels + c] + top[x0 * channels + c];
+            values[c] = static_cast<float>(static_cast<double>(sum) / area);
+        }
+
+        if (channels < 3) {
+            // Grayscale, with optional alpha.
+            return { values[0], values[0], values[0], channels == 2 ? values[1] : 255.0f };
+        }
+
+        return { values[0], values[1], values[2], channels >= 4 ? values[3] : 255.0f };
+    }
+
+    int summed_area_table::get_height() const {
+        return height;
+    }
+
+    int summed_area_table::get_width() const {
+        return width;
+    }
+
+    int summed_area_table::get_channels() const {
+        return channels;
+    }
+
+}
@@ -0,0 +1,221 @@
+
+#include "img/terminal_renderer.h"
+
+namespace img {
+
+    namespace {
+
+        // Appends the decimal digits of non-negative 'value'.
+        void append_number(std::string& output, int value) {
+            char digits[10]; // Enough for any int.
+            int count = 0;
+
+            do {
+                digits[count++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value > 0);
+
+            while (count > 0) {
+                output += digits[--count];
+            }
+        }
+
+        // SGR sequence selecting a 24-bit foreground (38) or background (48) color.
+        void append_color(std::string& output, int target, const std::array<unsigned char, 3>& color) {
+            output += "\x1b[";
+            append_number(output, target);
+            output += ";2;";
+            append_number(output, color[0]);
+            output += ';';
+            append_number(output, color[1]);
+            output += ';';
+            append_number(output, color[2]);
+            output += 'm';
+        }
+
+        void append_cursor_position(std::string& output, int row, int column) {
+            output += "\x1b[";
+            append_number(output, row + 1);
+            output += ';';
+            append_number(output, column + 1);
+            output += 'H';
+        }
+
+    }
+
+    terminal_renderer::terminal_renderer(int resolution, bool half_block, int threshold, const std::string& ramp) : resolution(std::max(resolution, 1)),
+                                                                                                                  half_block(half_block),
+                                                                                                                  threshold(threshold),
+                                                                                                                  characters(resolution, ramp),
+                                                                                                                  rows(0),
+                                                                                                                  columns(0),
+                                                                                                                  displayed(),
+                                                                                                                  current(),
+                                                                                                                  buffer()
+                                                                                                                  {
+    }
+
+    terminal_renderer::~terminal_renderer() = default;
+
+    void terminal_renderer::render(const image &frame, std::string &output) {
+        int frame_rows = (frame.get_height() + 2 * resolution - 1) / (2 * resolution);
+        int frame_columns = (frame.get_width() + resolution - 1) / resolution;
+
+        bool redraw = displayed.empty() || frame_rows != rows || frame_columns != columns;
+        if (redraw) {
+            // Clear the screen, in case the previous frame was larger.
+            output += "\x1b[2J";
+
+            rows = frame_rows;
+            columns = frame_columns;
+            displayed.assign(static_cast<std::size_t>(rows) * columns, cell{ });
+        }
+
+        sample(frame, current);
+
+        // Colors and cursor position emitted so far, to skip redundant escape sequences.
+        const std::array<unsigned char, 3>* foreground = nullptr;
+        const std::array<unsigned char, 3>* background = nullptr;
+        int cursor_row = -1;
+        int cursor_column = -1;
+
+        for (int row = 0; row < rows; ++row) {
+            for (int column = 0; column < columns; ++column) {
+                std::size_t index = static_cast<std::size_t>(row) * columns + column;
+                const cell& value = current[index];
+
+                if (!redraw && is_unchanged(displayed[index], value)) {
+                    continue;
+                }
+
+                if (row != cursor_row || column != cursor_column) {
+                    append_cursor_position(output, row, column);
+                }
+
+                if (!foreground || *foreground != value.top) {
+                    append_color(output, 38, value.top);
+                    foreground = &value.top;
+                }
+
+                if (half_block) {
+                    if (!background || *background != value.bottom) {
+                        append_color(output, 48, value.bottom);
+                        background = &value.bottom;
+                    }
+
+                    output += "\xe2\x96\x80"; // Upper half block.
+                }
+                else {
+                    output += value.character;
+                }
+
+                displayed[index] = value;
+                cursor_row = row;
+                cursor_column = column + 1;
+            }
+        }
+
+        // Reset colors, so that other output is not affected.
+        if (foreground) {
+            output += "\x1b[0m";
+        }
+    }
+
+    void terminal_renderer::render(const image &frame, std::ostream &stream) {
+        buffer.clear();
+        render(frame, buffer);
+        stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        stream.flush();
+    }
+
+    void terminal_renderer::reset() {
+        displayed.clear();
+    }
+
+    void terminal_renderer::sample(const image &frame, std::vector<cell> &cells) const {
+        int width = frame.get_width();
+        int height = frame.get_height();
+        int channels = frame.get_channels();
+        const unsigned char* data = frame.get_data();
+
+        cells.resize(static_cast<std::size_t>(rows) * columns);
+
+        // Running color totals for the top and bottom half of each cell in the current row.
+        std::vector<std::uint32_t> sums(static_cast<std::size_t>(columns) * 6);
+        std::vector<std::uint32_t> counts(static_cast<std::size_t>(columns) * 2);
+
+        for (int row = 0; row < rows; ++row) {
+            std::fill(sums.begin(), sums.end(), 0);
+            std::fill(counts.begin(), counts.end(), 0);
+
+            int y0 = row * 2 * resolution;
+            int y1 = std::min(y0 + 2 * resolution, height);
+
+            for (int y = y0; y < y1; ++y) {
+                // Half the cell is the top half, the rest the bottom half. Without half blocks, both halves are
+                // averaged together.
+                int half = half_block && y >= y0 + resolution ? 1 : 0;
+                const unsigned char* pixels = data + static_cast<std::size_t>(y) * width * channels;
+
+                for (int x = 0; x < width; ++x) {
+                    const unsigned char* pixel = pixels + x * channels;
+                    std::size_t column = static_cast<std::size_t>(x / resolution);
+                    std::uint32_t* sum = sums.data() + (column * 2 + half) * 3;
+
+                    if (channels < 3) {
+                        sum[0] += pixel[0];
+                        sum[1] += pixel[0];
+                        sum[2] += pixel[0];
+                    }
+                    else {
+                        sum[0] += pixel[0];
+                        sum[1] += pixel[1];
+                        sum[2] += pixel[2];
+                    }
+
+                    ++counts[column * 2 + half];
+                }
+            }
+
+            for (int column = 0; column < columns; ++column) {
+                cell& value = cells[static_cast<std::size_t>(row) * columns + column];
+
+                for (int half = 0; half < 2; ++half) {
+                    std::array<unsigned char, 3>& color = half == 0 ? value.top : value.bottom;
+                    std::uint32_t count = counts[column * 2 + half];
+
+                    // Bottom half of the last row may be past the end of the image.
+                    if (count == 0) {
+                        color = { 0, 0, 0 };
+                        continue;
+                    }
+
+                    for (int c = 0; c < 3; ++c) {
+                        color[c] = static_cast<unsigned char>(sums[(column * 2 + half) * 3 + c] / count);
+                    }
+                }
+
+                value.character = half_block ? ' ' : characters.get_character(get_luma(value.top[0], value.top[1], value.top[2]));
+            }
+        }
+    }
+
+    bool terminal_renderer::is_unchanged(const cell &first, const cell &second) const {
+        if (first.character != second.character) {
+            return false;
+        }
+
+        for (int c = 0; c < 3; ++c) {
+            if (std::abs(first.top[c] - second.top[c]) > threshold) {
+                return false;
+            }
+
+            if (half_block && std::abs(first.bottom[c] - second.bottom[c]) > threshold) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,278 @@
+
+#include "img/thread_pool.h"
+
+namespace img {
+
+    namespace {
+
+        // Pool and worker queue the current thread belongs to, if any.
+        thread_local const void* current_pool = nullptr;
+        thread_local int current_index = -1;
+
+        std::mutex& get_thread_pool_lock() {
+            static std::mutex lock;
+            return lock;
+        }
+
+        std::once_flag& get_thread_pool_flag() {
+            static std::once_flag flag;
+            return flag;
+        }
+
+        std::unique_ptr<thread_pool>& get_thread_pool_instance() {
+            static std::unique_ptr<thread_pool> instance;
+            return instance;
+        }
+
+    }
+
+    thread_pool::thread_pool(int num_threads) : queues(),
+                                                workers(),
+                                                sleep_lock(),
+                                                wake(),
+                                                num_queued(0),
+                                                stopping(false)
+                                                {
+        if (num_threads <= 0) {
+            num_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+
+        int num_workers = num_threads - 1;
+
+        for (int i = 0; i < num_workers + 1; ++i) {
+            queues.emplace_back(std::make_unique<task_queue>());
+        }
+
+        workers.reserve(num_workers);
+        for (int i = 0; i < num_workers; ++i) {
+            workers.emplace_back(&thread_pool::work, this, i);
+        }
+    }
+
+    thread_pool::~thread_pool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void thread_pool::parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& function) {
+        int count = end - begin;
+        if (count <= 0) {
+            return;
+        }
+
+        grain = std::max(grain, 1);
+
+        // A few chunks per thread leave room for balancing uneven work.
+        int num_chunks = std::min((count + grain - 1) / grain, get_thread_count() * 4);
+
+        if (workers.empty() || num_chunks <= 1) {
+            function(begin, end);
+            return;
+        }
+
+        // Shared with the tasks, which may still be signaling completion after the last chunk is done.
+        std::shared_ptr<task_group> group = std::make_shared<task_group>(num_chunks - 1);
+
+        for (int i = 1; i < num_chunks; ++i) {
+            int first = begin + static_cast<int>(static_cast<long long>(count) * i / num_chunks);
+            int last = begin + static_cast<int>(static_cast<long long>(count) * (i + 1) / num_chunks);
+
+            push([&function, group, first, last]() {
+                try {
+                    function(first, last);
+                }
+                catch (...) {
+                    group->fail(std::current_exception());
+                }
+
+                group->finish();
+            });
+        }
+
+        // Run the first chunk here, then help out until no more tasks are queued, and wait for the rest.
+        try {
+            function(begin, begin + static_cast<int>(count / num_chunks));
+        }
+        catch (...) {
+            group->fail(std::current_exception());
+        }
+
+        while (!group->is_done()) {
+            if (!run_pending_task()) {
+                group->wait();
+            }
+        }
+
+        // Chunks that threw are rethrown here, once no task refers to 'function' anymore.
+        if (group->error) {
+            std::rethrow_exception(group->error);
+        }
+    }
+
+    thread_pool::task_group::task_group(int count) : lock(),
+                                                     done(),
+                                                     remaining(count),
+                                                     error()
+                                                     {
+    }
+
+    void thread_pool::task_group::fail(std::exception_ptr exception) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        // Only the first exception is kept.
+        if (!error) {
+            error = std::move(exception);
+        }
+    }
+
+    void thread_pool::task_group::finish() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> guard(lock);
+            done.notify_all();
+        }
+    }
+
+    bool thread_pool::task_group::is_done() const {
+        return remaining.load(std::memory_order_acquire) == 0;
+    }
+
+    void thread_pool::task_group::wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [this]() {
+            return is_done();
+        });
+    }
+
+    int thread_pool::get_thread_count() const {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    void thread_pool::push(task work) {
+        // Workers keep their own tasks, everyone else shares the last queue.
+        int index = current_pool == this ? current_index : static_cast<int>(queues.size()) - 1;
+
+        {
+            std::lock_guard<std::mutex> guard(queues[index]->lock);
+            queues[index]->tasks.emplace_back(std::move(work));
+        }
+
+        num_queued.fetch_add(1, std::memory_order_release);
+
+        {
+            // Ensures a worker about to sleep sees the new task.
+            std::lock_guard<std::mutex> guard(sleep_lock);
+        }
+
+        wake.notify_one();
+    }
+
+    bool thread_pool::run_pending_task() {
+        int num_queues = static_cast<int>(queues.size());
+        int own = current_pool == this ? current_index : -1;
+
+        task work;
+
+        if (own >= 0) {
+            // Newest own task first, its data is most likely still in cache.
+            std::lock_guard<std::mutex> guard(queues[own]->lock);
+
+            if (!queues[own]->tasks.empty()) {
+                work = std::move(queues[own]->tasks.back());
+                queues[own]->tasks.pop_back();
+            }
+        }
+
+        // Steal the oldest task of another queue, starting with the one after this thread's own.
+        for (int i = 1; !work && i <= num_queues; ++i) {
+            int victim = (std::max(own, 0) + i) % num_queues;
+            if (victim == own) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> guard(queues[victim]->lock);
+
+            if (!queues[victim]->tasks.empty()) {
+                work = std::move(queues[victim]->tasks.front());
+                queues[victim]->tasks.pop_front();
+            }
+        }
+
+        if (!work) {
+            return false;
+        }
+
+        num_queued.fetch_sub(1, std::memory_order_relaxed);
+        work();
+        return true;
+    }
+
+    void thread_pool::work(int index) {
+        current_pool = this;
+        current_index = index;
+
+        while (true) {
+            if (run_pending_task()) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            wake.wait(guard, [this]() {
+                return stopping || num_queued.load(std::memory_order_acquire) > 0;
+            });
+
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+    thread_pool& get_thread_pool() {
+        // Only the first call locks, unless set_thread_count() already created the pool.
+        std::call_once(get_thread_pool_flag(), []() {
+            std::lock_guard<std::mutex> guard(get_thread_pool_lock());
+
+            std::unique_ptr<thread_pool>& instance = get_thread_pool_instance();
+            if (!instance) {
+                instance = std::make_unique<thread_pool>();
+            }
+        });
+
+        return *get_thread_pool_instance();
+    }
+
+    void set_thread_count(int num_threads) {
+        std::lock_guard<std::mutex> guard(get_thread_pool_lock());
+        get_thread_pool_instance() = std::make_unique<thread_pool>(num_threads);
+    }
+
+    void parallel_for_rows(int height, const std::function<void(int, int)>& function, int grain) {
+        get_thread_pool().parallel_for(0, height, grain, function);
+    }
+
+    void parallel_for_tiles(int width, int height, int tile_size, const std::function<void(int, int, int, int)>& function) {
+        if (tile_size <= 0) {
+            std::cerr << "Invalid tile size passed to parallel_for_tiles()." << std::endl;
+            return;
+        }
+
+        int columns = (width + tile_size - 1) / tile_size;
+        int rows = (height + tile_size - 1) / tile_size;
+
+        get_thread_pool().parallel_for(0, columns * rows, 1, [&](int first, int last) {
+            for (int i = first; i < last; ++i) {
+                int x = (i % columns) * tile_size;
+                int y = (i / columns) * tile_size;
+                function(x, y, std::min(tile_size, width - x), std::min(tile_size, height - y));
+            }
+        });
+    }
+
+}
@@ -0,0 +1,373 @@
+
+#include "img/tiled_image.h"
+#include "img/probe.h"
+
+namespace img {
+
+    namespace {
+
+        // Unique path for the temporary file of a tiled image. Doesn't throw, the file fails to open instead.
+        std::string get_spill_path() {
+            static std::atomic<unsigned> counter(0);
+
+            std::stringstream name;
+            name << "img_tiles_" << std::chrono::steady_clock::now().time_since_epoch().count() << '_' << counter.fetch_add(1) << ".tmp";
+
+            std::error_code error;
+            std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+
+            return (error ? std::filesystem::path() : directory / name.str()).string();
+        }
+
+        // Bytes read for the header of streamed Netpbm files, enough for any PAM header without long comments.
+        const std::size_t header_size = 4096;
+
+        // Reads the header of the binary Netpbm file at 'filepath'.
+        netpbm_header read_header(const std::string& filepath) {
+            std::ifstream file(filepath, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error(filepath);
+            }
+
+            unsigned char header[header_size];
+            file.read(reinterpret_cast<char*>(header), header_size);
+
+            std::optional<netpbm_header> result = read_netpbm_header(header, static_cast<std::size_t>(file.gcount()));
+            if (!result) {
+                throw std::runtime_error(filepath + " (not a binary PBM, PGM, PPM or PAM file)");
+            }
+
+            return *result;
+        }
+
+    }
+
+    tiled_image::tiled_image(int width, int height, int channels, std::size_t memory_budget, int tile_size) : width(std::max(width, 0)),
+                                                                                                               height(std::max(height, 0)),
+                                                                                                               channels(std::clamp(channels, 1, 4)),
+                                                                                                               tile_size(std::max(tile_size, 1)),
+                                                                                                               columns(0),
+                                                                                                               rows(0),
+                                                                                                               tile_bytes(0),
+                                                                                                               memory_budget(memory_budget),
+                                                                                                               lock(),
+                                                                                                               changed(),
+                                                                                                               tiles(),
+                                                                                                               locks(),
+                                                                                                               recently_used(),
+                                                                                                               resident_bytes(0),
+                                                                                                               spill_lock(),
+                                                                                                               spill(),
+                                                                                                               spill_path()
+                                                                                                               {
+        if (width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+            std::cerr << "Invalid image dimensions passed to tiled_image." << std::endl;
+        }
+
+        columns = (this->width + this->tile_size - 1) / this->tile_size;
+        rows = (this->height + this->tile_size - 1) / this->tile_size;
+        tile_bytes = static_cast<std::size_t>(this->tile_size) * this->tile_size * this->channels;
+
+        tiles.resize(static_cast<std::size_t>(columns) * rows);
+        locks = std::make_unique<std::mutex[]>(tiles.size());
+    }
+
+    tiled_image::tiled_image(const image &im, std::size_t memory_budget, int tile_size) : tiled_image(im.get_width(), im.get_height(), im.get_channels(), memory_budget, tile_size) {
+        write(0, 0, width, height, im.get_data());
+    }
+
+    tiled_image::tiled_image(const std::string &filepath, std::size_t memory_budget, int tile_size) : tiled_image(read_header(filepath), memory_budget, tile_size) {
+        netpbm_header header = read_header(filepath);
+
+        std::ifstream file(filepath, std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(header.offset));
+
+        std::vector<unsigned char> row(static_cast<std::size_t>(width) * channels);
+        std::vector<unsigned char> bits(header.packed ? (static_cast<std::size_t>(width) + 7) / 8 : 0);
+
+        for (int y = 0; y < height; ++y) {
+            std::vector<unsigned char>& data = header.packed ? bits : row;
+
+            if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()))) {
+                throw std::runtime_error(filepath + " (truncated)");
+            }
+
+            if (header.packed) {
+                unpack_pbm_row(bits.data(), width, row.data());
+            }
+
+            write(0, y, width, 1, row.data());
+        }
+    }
+
+    tiled_image::tiled_image(const netpbm_header &header, std::size_t memory_budget, int tile_size) : tiled_image(header.width, header.height, header.channels, memory_budget, tile_size) {
+    }
+
+    tiled_image::~tiled_image() {
+        if (spill.is_open()) {
+            spill.close();
+
+            std::error_code error;
+            std::filesystem::remove(spill_path, error);
+        }
+    }
+
+    void tiled_image::read(int x, int y, int w, int h, unsigned char *pixels) const {
+        copy(x, y, w, h, pixels, false);
+    }
+
+    void tiled_image::write(int x, int y, int w, int h, const unsigned char *pixels) {
+        // Only read from when copying to the tiles.
+        copy(x, y, w, h, const_cast<unsigned char*>(pixels), true);
+    }
+
+    image tiled_image::to_image(const std::string &filepath) const {
+        image im(filepath, width, height, channels);
+        read(0, 0, width, height, im.get_data());
+        return im;
+    }
+
+    bool tiled_image::save(const std::string &filepath) const {
+        file_data target(filepath);
+
+        if (target.format != image_format::pnm && target.format != image_format::pam) {
+            std::cerr << "Invalid extension passed to tiled_image::save()." << std::endl;
+            return false;
+        }
+
+        // Create directory for file if it doesn't exist.
+        std::error_code error;
+        if (!target.directory.empty()) {
+            std::filesystem::create_directories(target.directory, error);
+        }
+
+        std::ofstream output(target.path, std::ios::binary);
+        if (!output) {
+            return false;
+        }
+
+        std::string header = get_netpbm_header(width, height, channels, target.format == image_format::pam);
+        output.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+        std::vector<unsigned char> row(static_cast<std::size_t>(width) * channels);
+
+        for (int y = 0; y < height && output; ++y) {
+            read(0, y, width, 1, row.data());
+            output.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+        }
+
+        return static_cast<bool>(output);
+    }
+
+    int tiled_image::get_width() const {
+        return width;
+    }
+
+    int tiled_image::get_height() const {
+        return height;
+    }
+
+    int tiled_image::get_channels() const {
+        return channels;
+    }
+
+    int tiled_image::get_tile_size() const {
+        return tile_size;
+    }
+
+    std::size_t tiled_image::get_memory_budget() const {
+        return memory_budget;
+    }
+
+    void tiled_image::copy(int x, int y, int w, int h, unsigned char *pixels, bool to_tiles) const {
+        if (x < 0 || y < 0 || w < 0 || h < 0 || x + w > width || y + h > height) {
+            std::cerr << "Invalid area passed to tiled_image." << std::endl;
+            return;
+        }
+
+        std::size_t stride = static_cast<std::size_t>(w) * channels;
+
+        for (int row = y / tile_size; row * tile_size < y + h; ++row) {
+            for (int column = x / tile_size; column * tile_size < x + w; ++column) {
+                // Overlap of the area with this tile, in image coordinates.
+                int x0 = std::max(x, column * tile_size);
+                int x1 = std::min(x + w, (column + 1) * tile_size);
+                int y0 = std::max(y, row * tile_size);
+                int y1 = std::min(y + h, (row + 1) * tile_size);
+                std::size_t size = static_cast<std::size_t>(x1 - x0) * channels;
+
+                int index = column + columns * row;
+                unsigned char* data;
+
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    data = acquire(index, guard);
+
+                    if (to_tiles) {
+                        tiles[index].dirty = true;
+                    }
+                }
+
+                {
+                    // Other tiles can be copied (and loaded or evicted) meanwhile.
+                    std::lock_guard<std::mutex> guard(locks[index]);
+
+                    for (int j = y0; j < y1; ++j) {
+                        unsigned char* tile_pixels = data + (static_cast<std::size_t>(j - row * tile_size) * tile_size + (x0 - column * tile_size)) * channels;
+                        unsigned char* area_pixels = pixels + static_cast<std::size_t>(j - y) * stride + static_cast<std::size_t>(x0 - x) * channels;
+
+                        if (to_tiles) {
+                            memcpy(tile_pixels, area_pixels, size);
+                        }
+                        else {
+                            memcpy(area_pixels, tile_pixels, size);
+                        }
+                    }
+                }
+
+                std::lock_guard<std::mutex> guard(lock);
+                --tiles[index].pins;
+            }
+        }
+    }
+
+    unsigned char *tiled_image::acquire(int index, std::unique_lock<std::mutex>& guard) const {
+        tile& t = tiles[index];
+
+        while (true) {
+            // Tiles are only ready once other threads finished writing or reading them.
+            changed.wait(guard, [&t] {
+                return !t.busy;
+            });
+
+            if (t.data) {
+                ++t.pins;
+
+                // Move to the front of the list.
+                recently_used.splice(recently_used.begin(), recently_used, t.position);
+                return t.data.get();
+            }
+
+            // Make room. The budget is exceeded while every tile in memory is being copied. Evicting releases the lock,
+            // so the tile is checked again.
+            if (resident_bytes + tile_bytes <= memory_budget || !evict(guard)) {
+                break;
+            }
+        }
+
+        auto data = std::make_unique<unsigned char[]>(tile_bytes); // Zero-initialized.
+        resident_bytes += tile_bytes;
+
+        if (t.spilled) {
+            t.busy = true;
+            guard.unlock();
+
+            bool loaded = read_spill(index, data.get());
+
+            guard.lock();
+            t.busy = false;
+            changed.notify_all();
+
+            if (!loaded) {
+                resident_bytes -= tile_bytes;
+                throw spill_error("failed to read tile");
+            }
+        }
+
+        t.data = std::move(data);
+        ++t.pins;
+
+        recently_used.push_front(index);
+        t.position = recently_used.begin();
+
+        return t.data.get();
+    }
+
+    bool tiled_image::evict(std::unique_lock<std::mutex>& guard) const {
+        auto victim = std::find_if(recently_used.rbegin(), recently_used.rend(), [this](int index) {
+            return tiles[index].pins == 0;
+        });
+
+        if (victim == recently_used.rend()) {
+            return false;
+        }
+
+        int index = *victim;
+        recently_used.erase(std::next(victim).base());
+
+        tile& t = tiles[index];
+
+        if (t.dirty) {
+            // Written without holding the lock, the tile counts against the budget until it is written.
+            t.busy = true;
+            guard.unlock();
+
+            bool written = write_spill(index, t.data.get());
+
+            guard.lock();
+            t.busy = false;
+            changed.notify_all();
+
+            if (!written) {
+                // Kept in memory, it holds the only copy of its pixels.
+                recently_used.push_back(index);
+                t.position = std::prev(recently_used.end());
+                throw spill_error("failed to write tile");
+            }
+
+            t.spilled = true;
+            t.dirty = false;
+        }
+
+        t.data.reset();
+        resident_bytes -= tile_bytes;
+        return true;
+    }
+
+    bool tiled_image::write_spill(int index, const unsigned char* data) const {
+        std::lock_guard<std::mutex> guard(spill_lock);
+
+        if (!spill.is_open()) {
+            spill_path = get_spill_path();
+            spill.open(spill_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+            if (!spill.is_open()) {
+                return false;
+            }
+        }
+
+        // Flushed right away, so that write errors show here rather than when a later tile is written.
+        spill.seekp(static_cast<std::streamoff>(index) * static_cast<std::streamoff>(tile_bytes));
+        spill.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(tile_bytes));
+        spill.flush();
+
+        if (!spill) {
+            spill.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool tiled_image::read_spill(int index, unsigned char* data) const {
+        std::lock_guard<std::mutex> guard(spill_lock);
+
+        spill.seekg(static_cast<std::streamoff>(index) * static_cast<std::streamoff>(tile_bytes));
+        spill.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(tile_bytes));
+
+        if (!spill) {
+            spill.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    std::runtime_error tiled_image::spill_error(const std::string& what) const {
+        std::lock_guard<std::mutex> guard(spill_lock);
+
+        // The path is empty if no temporary directory was found.
+        return std::runtime_error((spill_path.empty() ? std::string("temporary file") : spill_path) + " (" + what + ")");
+    }
+
+}
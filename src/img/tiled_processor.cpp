@@ -0,0 +1,160 @@
+
+#include "img/tiled_processor.h"
+#include "img/thread_pool.h"
+
+namespace img {
+
+    tiled_processor::tiled_processor(tiled_image &im) : im(im) {
+    }
+
+    tiled_processor::~tiled_processor() = default;
+
+    tiled_processor &tiled_processor::to_grayscale(luma_weights weights, bool linear_light) {
+        return apply({ grayscale_operation(weights, linear_light, false) });
+    }
+
+    tiled_processor &tiled_processor::threshold(unsigned char level, luma_weights weights) {
+        return apply({ threshold_operation(level, weights) });
+    }
+
+    tiled_processor &tiled_processor::apply_lut(const std::array<unsigned char, 256>& table) {
+        return apply({ lut_operation(table) });
+    }
+
+    tiled_processor &tiled_processor::dither_bayer(int matrix_width, int matrix_height) {
+        return apply({ bayer_operation(matrix_width, matrix_height) });
+    }
+
+    tiled_processor &tiled_processor::apply(const std::vector<point_operation> &operations) {
+        int width = im.get_width();
+        int height = im.get_height();
+        int channels = im.get_channels();
+
+        for (const point_operation& operation : operations) {
+            if (operation.channels > 0 && operation.channels != channels) {
+                std::cerr << "Operation changing the channel count passed to tiled_processor::apply()." << std::endl;
+                return *this;
+            }
+        }
+
+        // Tiles are read once, run through all operations, and written back.
+        parallel_for_tiles(width, height, im.get_tile_size(), [&](int x, int y, int w, int h) {
+            std::vector<unsigned char> pixels(static_cast<std::size_t>(w) * h * channels);
+            unsigned char rgba[point_operation::max_count * 4];
+
+            im.read(x, y, w, h, pixels.data());
+
+            for (int j = 0; j < h; ++j) {
+                for (int i = 0; i < w; i += point_operation::max_count) {
+                    int count = std::min(point_operation::max_count, w - i);
+                    unsigned char* row = pixels.data() + (static_cast<std::size_t>(j) * w + i) * channels;
+
+                    unpack_rgba(row, channels, rgba, count);
+
+                    for (const point_operation& operation : operations) {
+                        operation.function(rgba, count, x + i, y + j);
+                    }
+
+                    pack_rgba(rgba, row, channels, count);
+                }
+            }
+
+            im.write(x, y, w, h, pixels.data());
+        });
+
+        return *this;
+    }
+
+    tiled_processor &tiled_processor::to_lower_resolution(int x_resolution, int y_resolution) {
+        int width = im.get_width();
+        int height = im.get_height();
+        int channels = im.get_channels();
+
+        // Invalid dimensions.
+        if (x_resolution <= 0 || y_resolution <= 0) {
+            std::cerr << "Invalid image dimensions passed to to_lower_resolution()." << std::endl;
+            return *this;
+        }
+
+        // Rows of blocks are split into strips of whole blocks, about one tile wide. Only one row of a strip is in
+        // memory at a time, regardless of the block size.
+        int blocks_per_strip = std::max(1, im.get_tile_size() / x_resolution);
+        int strip_width = blocks_per_strip * x_resolution;
+        int num_strips = (width + strip_width - 1) / strip_width;
+
+        for (int y = 0; y < height; y += y_resolution) {
+            // Blocks along the bottom and right side are smaller when the resolution doesn't divide evenly.
+            int block_height = std::min(y_resolution, height - y);
+
+            parallel_for_rows(num_strips, [&](int first, int last) {
+                std::vector<unsigned char> row;
+                std::vector<std::uint64_t> sums;
+
+                for (int strip = first; strip < last; ++strip) {
+                    int x = strip * strip_width;
+                    int w = std::min(strip_width, width - x);
+                    int num_blocks = (w + x_resolution - 1) / x_resolution;
+
+                    row.resize(static_cast<std::size_t>(w) * channels);
+                    sums.assign(static_cast<std::size_t>(num_blocks) * channels, 0);
+
+                    for (int j = 0; j < block_height; ++j) {
+                        im.read(x, y + j, w, 1, row.data());
+
+                        for (int i = 0; i < w; ++i) {
+                            int block = i / x_resolution;
+
+                            for (int c = 0; c < channels; ++c) {
+                                sums[block * channels + c] += row[i * channels + c];
+                            }
+                        }
+                    }
+
+                    // Fill each block with its average color.
+                    for (int block = 0; block < num_blocks; ++block) {
+                        int x0 = block * x_resolution;
+                        int x1 = std::min(x0 + x_resolution, w);
+                        double area = static_cast<double>(x1 - x0) * block_height;
+
+                        for (int c = 0; c < channels; ++c) {
+                            auto value = static_cast<unsigned char>(static_cast<float>(static_cast<double>(sums[block * channels + c]) / area));
+
+                            for (int i = x0; i < x1; ++i) {
+                                row[i * channels + c] = value;
+                            }
+                        }
+                    }
+
+                    for (int j = 0; j < block_height; ++j) {
+                        im.write(x, y + j, w, 1, row.data());
+                    }
+                }
+            }, 1);
+        }
+
+        return *this;
+    }
+
+    tiled_processor &tiled_processor::dither(diffusion_matrix matrix) {
+        int width = im.get_width();
+        int height = im.get_height();
+        int channels = im.get_channels();
+
+        error_diffuser diffuser(matrix, width, height);
+        std::vector<unsigned char> row(static_cast<std::size_t>(width) * channels);
+        std::vector<unsigned char> rgba(static_cast<std::size_t>(width) * 4);
+
+        for (int y = 0; y < height; ++y) {
+            im.read(0, y, width, 1, row.data());
+
+            unpack_rgba(row.data(), channels, rgba.data(), width);
+            diffuser.dither_row(y, rgba.data());
+            pack_rgba(rgba.data(), row.data(), channels, width);
+
+            im.write(0, y, width, 1, row.data());
+        }
+
+        return *this;
+    }
+
+}
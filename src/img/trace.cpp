@@ -0,0 +1,270 @@
+
+#include "img/trace.h"
+
+namespace img {
+
+    namespace {
+
+        // Complete event (a scope), or a counter value when 'duration' is negative.
+        struct event {
+            const char* name;
+            int thread;
+            std::int64_t timestamp; // Microseconds since the first event.
+            std::int64_t duration;  // Microseconds.
+            std::uint64_t value;
+        };
+
+        struct scope_totals {
+            std::uint64_t count = 0;
+            std::chrono::nanoseconds total { 0 };
+            std::chrono::nanoseconds max { 0 };
+        };
+
+        // Events kept per thread, older ones are overwritten once a thread recorded this many.
+        const std::size_t max_thread_events = 1 << 16;
+
+        // Everything one thread recorded. Only the owning thread writes to it, so its lock is uncontended except while
+        // the trace is read or cleared. Scopes and counters are keyed by the address of their name, which allocates
+        // only the first time a thread records a name; names are merged by value when read.
+        struct thread_buffer {
+            explicit thread_buffer(int thread) : thread(thread)
+                                                 {
+            }
+
+            std::mutex lock;
+            int thread;
+            std::vector<event> events;
+            std::size_t next = 0; // Oldest event, once 'events' is full.
+            std::unordered_map<const char*, scope_totals> scopes;
+            std::unordered_map<const char*, std::uint64_t> counters;
+
+            void record(const event& e) {
+                if (events.size() < max_thread_events) {
+                    events.push_back(e);
+                    return;
+                }
+
+                events[next] = e;
+                next = (next + 1) % max_thread_events;
+            }
+        };
+
+        struct trace_state {
+            std::atomic<bool> enabled { false };
+            std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+            // Buffers outlive their threads (thread pool threads are replaced by set_thread_count()), until cleared.
+            std::mutex lock;
+            std::vector<std::shared_ptr<thread_buffer>> buffers;
+            int next_thread = 0;
+        };
+
+        trace_state& get_state() {
+            static trace_state state;
+            return state;
+        }
+
+        std::shared_ptr<thread_buffer> register_buffer() {
+            trace_state& state = get_state();
+            std::lock_guard<std::mutex> guard(state.lock);
+
+            // Small sequential thread IDs read better in trace viewers than hashed std::thread::id values.
+            state.buffers.push_back(std::make_shared<thread_buffer>(state.next_thread++));
+            return state.buffers.back();
+        }
+
+        thread_buffer& get_buffer() {
+            thread_local std::shared_ptr<thread_buffer> buffer = register_buffer();
+            return *buffer;
+        }
+
+        // Events of all threads, ordered by time.
+        std::vector<event> merge_events(trace_state& state) {
+            std::vector<event> events;
+
+            for (const std::shared_ptr<thread_buffer>& buffer : state.buffers) {
+                std::lock_guard<std::mutex> guard(buffer->lock);
+                events.insert(events.end(), buffer->events.begin(), buffer->events.end());
+            }
+
+            std::stable_sort(events.begin(), events.end(), [](const event& a, const event& b) {
+                return a.timestamp < b.timestamp;
+            });
+
+            return events;
+        }
+
+        std::int64_t to_microseconds(std::chrono::steady_clock::duration duration) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        }
+
+        // Names are identifiers chosen in the library, only quotes and backslashes need escaping.
+        std::string escape(const std::string& text) {
+            std::string escaped;
+
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    escaped += '\\';
+                }
+
+                escaped += c;
+            }
+
+            return escaped;
+        }
+
+    }
+
+    void set_tracing(bool enabled) {
+        get_state().enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool get_tracing() {
+        return get_state().enabled.load(std::memory_order_relaxed);
+    }
+
+    void clear_trace() {
+        trace_state& state = get_state();
+        std::lock_guard<std::mutex> guard(state.lock);
+
+        for (const std::shared_ptr<thread_buffer>& buffer : state.buffers) {
+            std::lock_guard<std::mutex> buffer_guard(buffer->lock);
+
+            buffer->events.clear();
+            buffer->next = 0;
+            buffer->scopes.clear();
+            buffer->counters.clear();
+        }
+
+        // Buffers of threads that have exited are only referenced here.
+        state.buffers.erase(std::remove_if(state.buffers.begin(), state.buffers.end(), [](const std::shared_ptr<thread_buffer>& buffer) {
+            return buffer.use_count() == 1;
+        }), state.buffers.end());
+    }
+
+    void write_chrome_trace(std::ostream &output) {
+        trace_state& state = get_state();
+        std::lock_guard<std::mutex> guard(state.lock);
+
+        std::vector<event> events = merge_events(state);
+
+        // Counter events carry the running total of their thread, the trace shows the total of all threads.
+        std::map<std::string, std::map<int, std::uint64_t>> thread_totals;
+        std::map<std::string, std::uint64_t> totals;
+
+        output << "{\"traceEvents\":[\n";
+
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            const event& e = events[i];
+            std::string name = escape(e.name);
+
+            if (e.duration >= 0) {
+                output << "{\"name\":\"" << name << "\",\"cat\":\"img\",\"ph\":\"X\",\"ts\":" << e.timestamp << ",\"dur\":" << e.duration << ",\"pid\":1,\"tid\":" << e.thread << '}';
+            }
+            else {
+                std::uint64_t& previous = thread_totals[e.name][e.thread];
+                std::uint64_t& total = totals[e.name];
+                total += e.value - previous;
+                previous = e.value;
+
+                output << "{\"name\":\"" << name << "\",\"cat\":\"img\",\"ph\":\"C\",\"ts\":" << e.timestamp << ",\"pid\":1,\"tid\":" << e.thread << ",\"args\":{\"value\":" << total << "}}";
+            }
+
+            output << (i + 1 < events.size() ? ",\n" : "\n");
+        }
+
+        output << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    }
+
+    metrics_snapshot get_metrics() {
+        trace_state& state = get_state();
+        std::lock_guard<std::mutex> guard(state.lock);
+
+        std::map<std::string, scope_totals> scopes;
+        std::map<std::string, std::uint64_t> counters;
+
+        for (const std::shared_ptr<thread_buffer>& buffer : state.buffers) {
+            std::lock_guard<std::mutex> buffer_guard(buffer->lock);
+
+            for (const auto& [name, thread_totals] : buffer->scopes) {
+                scope_totals& totals = scopes[name];
+                totals.count += thread_totals.count;
+                totals.total += thread_totals.total;
+                totals.max = std::max(totals.max, thread_totals.max);
+            }
+
+            for (const auto& [name, value] : buffer->counters) {
+                counters[name] += value;
+            }
+        }
+
+        metrics_snapshot snapshot;
+
+        for (const auto& [name, totals] : scopes) {
+            snapshot.scopes.push_back({ name, totals.count, std::chrono::duration<double, std::milli>(totals.total).count(), std::chrono::duration<double, std::milli>(totals.max).count() });
+        }
+
+        snapshot.counters.assign(counters.begin(), counters.end());
+        return snapshot;
+    }
+
+    void write_metrics(std::ostream &output) {
+        metrics_snapshot snapshot = get_metrics();
+
+        for (const scope_metrics& scope : snapshot.scopes) {
+            output << scope.name << ".count " << scope.count << '\n';
+            output << scope.name << ".total_ms " << scope.total << '\n';
+            output << scope.name << ".max_ms " << scope.max << '\n';
+        }
+
+        for (const auto& [name, value] : snapshot.counters) {
+            output << name << ' ' << value << '\n';
+        }
+
+        output << std::flush;
+    }
+
+    trace_scope::trace_scope(const char *name) : name(name),
+                                                 start(),
+                                                 active(get_tracing())
+                                                 {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    trace_scope::~trace_scope() {
+        if (!active) {
+            return;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        auto duration = end - start;
+
+        thread_buffer& buffer = get_buffer();
+        std::lock_guard<std::mutex> guard(buffer.lock);
+        buffer.record({ name, buffer.thread, to_microseconds(start - get_state().epoch), to_microseconds(duration), 0 });
+
+        scope_totals& totals = buffer.scopes[name];
+        ++totals.count;
+        totals.total += duration;
+        totals.max = std::max<std::chrono::nanoseconds>(totals.max, duration);
+    }
+
+    void add_trace_counter(const char *name, std::uint64_t value) {
+        if (!get_tracing()) {
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        thread_buffer& buffer = get_buffer();
+        std::lock_guard<std::mutex> guard(buffer.lock);
+        std::uint64_t& total = buffer.counters[name];
+        total += value;
+
+        // Counter events carry the running total of the thread, see write_chrome_trace().
+        buffer.record({ name, buffer.thread, to_microseconds(now - get_state().epoch), -1, total });
+    }
+
+}
@@ -3,6 +3,76 @@
 
 namespace img {
 
+    namespace {
+
+        std::atomic<bool>& get_logging_flag() {
+            static std::atomic<bool> enabled(true);
+            return enabled;
+        }
+
+        std::atomic<std::uint32_t>& get_seed() {
+            static std::atomic<std::uint32_t> seed(std::random_device{}());
+            return seed;
+        }
+
+        // Incremented whenever the seed is set, tells generators to restart.
+        std::atomic<unsigned>& get_seed_generation() {
+            static std::atomic<unsigned> generation(0);
+            return generation;
+        }
+
+    }
+
+    void set_logging(bool enabled) {
+        get_logging_flag().store(enabled, std::memory_order_relaxed);
+    }
+
+    bool get_logging() {
+        return get_logging_flag().load(std::memory_order_relaxed);
+    }
+
+    void set_random_seed(std::uint32_t seed) {
+        get_seed().store(seed);
+        ++get_seed_generation();
+    }
+
+    std::optional<std::uint32_t> get_random_seed() {
+        if (get_seed_generation().load() == 0) {
+            return std::nullopt;
+        }
+
+        return get_seed().load();
+    }
+
+    std::mt19937& get_random_generator() {
+        thread_local std::mt19937 generator;
+        thread_local std::optional<unsigned> generation;
+
+        unsigned current = get_seed_generation().load();
+        if (generation != current) {
+            if (current == 0) {
+                // Never seeded, every thread mixes its own index into the random seed so threads draw different numbers.
+                static std::atomic<std::uint32_t> next_thread(0);
+                std::seed_seq sequence { get_seed().load(), next_thread++ };
+                generator.seed(sequence);
+            }
+            else {
+                generator.seed(get_seed().load());
+            }
+
+            generation = current;
+        }
+
+        return generator;
+    }
+
+    glm::vec2 uniform_distribution(const glm::vec2 &min, const glm::vec2 &max) {
+        // Separate statements, the order in which arguments are evaluated is unspecified.
+        float x = uniform_distribution(min.x, max.x);
+        float y = uniform_distribution(min.y, max.y);
+        return { x, y };
+    }
+
     char get_separator() {
         #ifdef _WIN32
             return '/';
@@ -16,29 +16,30 @@ int main(int argc, char* argv[]) {
         image.process().k_means(k).save();
     }
 
-    image.process().dither_error_diffusion().save();
-    image.process().dither_floyd_steinberg().save();
-    image.process().dither_false_floyd_steinberg().save();
-    image.process().dither_jarvis_judice_ninke().save();
-    image.process().dither_stucki().save();
-    image.process().dither_atkinson().save();
-    image.process().dither_burkes().save();
-    image.process().dither_sierra().save();
-    image.process().dither_two_row_sierra().save();
-    image.process().dither_sierra_lite().save();
-    image.process().dither_bayer(2, 2).save();
-    image.process().dither_bayer(4, 4).save();
-    image.process().dither_bayer(8, 8).save();
-    image.process().dither_bayer(4, 6).save();
-
-    image.process().voronoi(50).save();
-    image.process().voronoi(100).save();
-    image.process().voronoi(200).save();
-    image.process().voronoi(500).save();
-    image.process().voronoi(1000).save();
-    image.process().voronoi(2000).save();
-    image.process().voronoi(5000).save();
-    image.process().voronoi(10000).save();
+    // Encoding overlaps with processing of the following images.
+    std::vector<std::future<bool>> saves;
+    saves.emplace_back(image.process().dither_error_diffusion().save_async());
+    saves.emplace_back(image.process().dither_floyd_steinberg().save_async());
+    saves.emplace_back(image.process().dither_false_floyd_steinberg().save_async());
+    saves.emplace_back(image.process().dither_jarvis_judice_ninke().save_async());
+    saves.emplace_back(image.process().dither_stucki().save_async());
+    saves.emplace_back(image.process().dither_atkinson().save_async());
+    saves.emplace_back(image.process().dither_burkes().save_async());
+    saves.emplace_back(image.process().dither_sierra().save_async());
+    saves.emplace_back(image.process().dither_two_row_sierra().save_async());
+    saves.emplace_back(image.process().dither_sierra_lite().save_async());
+    saves.emplace_back(image.process().dither_bayer(2, 2).save_async());
+    saves.emplace_back(image.process().dither_bayer(4, 4).save_async());
+    saves.emplace_back(image.process().dither_bayer(8, 8).save_async());
+    saves.emplace_back(image.process().dither_bayer(4, 6).save_async());
+
+    for (const img::image& diagram : image.process().voronoi_sweep({ 50, 100, 200, 500, 1000, 2000, 5000, 10000 })) {
+        diagram.save();
+    }
+
+    for (std::future<bool>& save : saves) {
+        save.wait();
+    }
 
     return 0;
 }
\ No newline at end of file